@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/interaction.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the arbitrary output variables (AOVs) a film can
+    store next to the beauty image. The set of enabled AOVs is fixed
+    when the film is created and an AOVLayout packs exactly those into
+    a block of floats per pixel, so a disabled AOV takes no memory and
+    a film without AOVs has no AOV buffers at all.
+
+    Samples are accumulated by a function picked from a table of
+    instantiations, one per combination of AOVs, in which the tests for
+    disabled AOVs are compiled out. A disabled AOV is never stored, and
+    the SurfaceInteraction fields only it needs are never read, which
+    for normals means the shading frame is never derived.
+
+    AOVs are not filtered. Each sample goes to the pixel it lies in:
+    depth, normal and albedo average over the samples that hit
+    something, light contributions over all samples, and the object ID
+    is that of the first hit in the pixel, or -1 where nothing was hit.
+    Object IDs are stored as float values, exact for instance indices
+    below 2^24; larger indices may share an ID with their neighbours.
+ * =================================================================== */
+
+/// Linear RGB radiance
+typedef Vec3f RGB;
+
+/// AOVs a film can store, combined as bits
+static const uint32_t AOVDepth = 1 << 0;           /// Distance along the camera ray to the first hit
+static const uint32_t AOVNormal = 1 << 1;          /// Shading normal at the first hit
+static const uint32_t AOVAlbedo = 1 << 2;          /// Surface albedo reported by the integrator
+static const uint32_t AOVObjectID = 1 << 3;        /// Scene instance of the first hit
+static const uint32_t AOVLights = 1 << 4;          /// Radiance from each light, reported by the integrator
+static const uint32_t AOVAll = (1 << 5) - 1;
+
+class AOVLayout;
+
+/**
+ * \brief AOV values of one camera sample, filled in by the radiance
+ * function and handed to the film afterwards
+ */
+
+struct AOVSample {
+    /// AOVSample public data
+    const AOVLayout& layout;
+    bool hit = false;
+    float depth = 0.0f;
+    Normal3f n;
+    int instanceID = -1;
+    RGB albedo;                             /// Set by the integrator if the layout has albedo
+    std::vector<RGB> lightContributions;    /// Added to by the integrator, one per light of the layout
+
+    /// AOVSample public methods
+    explicit AOVSample(const AOVLayout& layout);
+
+    /// Clear the values of the previous sample
+    void Reset();
+
+    /// Record the first hit along the camera ray, reading only the
+    /// interaction fields the enabled AOVs need
+    void SetHit(const Ray& ray, const SurfaceInteraction& isect);
+};
+
+/**
+ * \brief Packing of the enabled AOVs into the floats of a pixel
+ */
+
+class AOVLayout {
+  public:
+    /// AOVLayout public data
+    const uint32_t aovs;
+    const int nLights;
+    int nFloats;        /// Floats stored per pixel, zero without AOVs
+    int nChannels;      /// Values per pixel of a resolved image
+
+    /// AOVLayout public methods
+    explicit AOVLayout(uint32_t aovs = 0, int nLights = 0);
+
+    bool Enabled(uint32_t aov) const {
+        return (aovs & aov) != 0;
+    }
+
+    /// Channel names of a resolved image, in the EXR naming style
+    std::vector<std::string> ChannelNames() const;
+
+    /// Add a sample to the floats of the pixel it lies in
+    void Accumulate(float* pixel, const AOVSample& sample) const {
+        accumulate(*this, pixel, sample);
+    }
+
+    /// Add the floats of src, gathered from other samples of the same
+    /// pixel, to dst
+    void Merge(float* dst, const float* src) const;
+
+    /// Final values of a pixel, nChannels of them
+    void Resolve(const float* pixel, float* values) const;
+
+  private:
+    typedef void (*AccumulateFunction)(const AOVLayout& layout, float* pixel, const AOVSample& sample);
+
+    /// AOVLayout private data
+    int depthOffset, normalOffset, albedoOffset, objectIDOffset, lightsOffset;
+    AccumulateFunction accumulate;
+
+    /// AOVLayout private methods
+    template <uint32_t Aovs>
+    static void AccumulateAOVs(const AOVLayout& layout, float* pixel, const AOVSample& sample);
+};
+
+HEIMDALL_NAMESPACE_END
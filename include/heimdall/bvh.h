@@ -0,0 +1,421 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/shape.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the bounding volume hierarchy shared by every
+    acceleration structure in heimdall. The BVH itself only knows
+    about primitive bounds and indices, so the same flattened tree is
+    used for bottom-level hierarchies over shapes and for top-level
+    hierarchies over instances.
+ * =================================================================== */
+
+/// Partitioning strategies available to the BVH builder. SBVH also
+/// considers spatial splits, duplicating references that straddle the
+/// split plane, and trades build time for traversal speed.
+enum class SplitMethod { SAH, Middle, EqualCounts, SBVH };
+
+/// Bounds of the part of a primitive inside a clip box, used by SBVH builds
+typedef std::function<Bounds3f(size_t primitiveNumber, const Bounds3f& clip)> ClipFunction;
+
+/// What BVH::Update ended up doing to keep the tree valid
+enum class BVHUpdate { Refit, PartialRebuild, FullRebuild };
+
+/**
+ * \brief Per-primitive information used while building a BVH
+ */
+
+struct BVHPrimitiveInfo {
+    /// BVHPrimitiveInfo public data
+    size_t primitiveNumber;
+    Bounds3f bounds;
+    Point3f centroid;
+
+    /// BVHPrimitiveInfo public methods
+    BVHPrimitiveInfo() : primitiveNumber(0) {}
+
+    BVHPrimitiveInfo(size_t primitiveNumber, const Bounds3f& bounds)
+        : primitiveNumber(primitiveNumber), bounds(bounds),
+          centroid(bounds.pMin * 0.5f + bounds.pMax * 0.5f) {}
+};
+
+/**
+ * \brief Flattened BVH node, laid out depth first so the first child
+ * of an interior node always directly follows it in memory
+ */
+
+struct LinearBVHNode {
+    Bounds3f bounds;
+    union {
+        int primitivesOffset;   /// Leaf
+        int secondChildOffset;  /// Interior
+    };
+    uint16_t nPrimitives;       /// Zero for interior nodes
+    uint8_t axis;               /// Interior node split axis
+    uint8_t pad[1];             /// Ensure 32 byte total size
+};
+
+/**
+ * \brief Bounding volume hierarchy over indexed primitives
+ */
+
+class BVH {
+  public:
+    /// BVH public methods
+    BVH() : maxPrimsInNode(1), splitMethod(SplitMethod::SAH) {}
+    BVH(std::vector<BVHPrimitiveInfo> primitiveInfo, int maxPrimsInNode = 1,
+        SplitMethod splitMethod = SplitMethod::SAH, ClipFunction clipPrimitive = nullptr);
+
+    Bounds3f WorldBound() const;
+
+    bool Empty() const {
+        return NodeCount() == 0;
+    }
+
+    const LinearBVHNode* Nodes() const {
+        return mapping ? mappedNodes : nodes.data();
+    }
+
+    int NodeCount() const {
+        return mapping ? nMappedNodes : int(nodes.size());
+    }
+
+    const int* PrimitiveIndices() const {
+        return mapping ? mappedIndices : primitiveIndices.data();
+    }
+
+    int PrimitiveIndexCount() const {
+        return mapping ? nMappedIndices : int(primitiveIndices.size());
+    }
+
+    /// SAH cost of the tree relative to the surface area of its root
+    float SAHCost() const;
+
+    /// Bytes held by the nodes, primitive indices and build costs
+    size_t MemoryBytes() const;
+
+    /// Recompute node bounds bottom up from new per-primitive bounds,
+    /// leaving the topology untouched
+    void Refit(const std::vector<Bounds3f>& primitiveBounds);
+
+    /// Refit, then rebuild the most degraded subtree (or the whole tree)
+    /// once its SAH cost exceeds rebuildThreshold times its build cost
+    BVHUpdate Update(const std::vector<Bounds3f>& primitiveBounds, float rebuildThreshold = 1.5f);
+
+    /// Turn every subtree with at most maxPrims primitives into one leaf,
+    /// for accels whose leaf cost hardly grows up to a fixed width
+    void CollapseSubtrees(int maxPrims);
+
+    /// Closest hit traversal, intersectPrimitive(index) returns true on a
+    /// hit and is responsible for shrinking ray.tMax
+    template <typename F>
+    bool Intersect(const Ray& ray, F intersectPrimitive) const;
+
+    /// Any hit traversal, returns as soon as intersectPrimitive(index) does.
+    /// Children are visited in memory order since any hit will do.
+    template <typename F>
+    bool IntersectP(const Ray& ray, F intersectPrimitive) const;
+
+    /// Leaf level variants of the two traversals above, for accels that
+    /// store leaf contents themselves. intersectLeaf(primitivesOffset,
+    /// nPrimitives) is called once per leaf the ray reaches.
+    template <typename F>
+    bool IntersectLeaves(const Ray& ray, F intersectLeaf) const;
+    template <typename F>
+    bool IntersectPLeaves(const Ray& ray, F intersectLeaf) const;
+
+    /// Closest hit traversal of independent rays, each advanced as a state
+    /// machine in a group of lanes. After a lane steps it prefetches its
+    /// next node and yields to the next lane, so node fetches overlap.
+    /// intersectPrimitive(rayIndex, index) must shrink that ray's tMax on a hit.
+    template <typename F>
+    void IntersectInterleaved(const Ray* rays, int nRays, F intersectPrimitive) const;
+
+    friend bool WriteBVHCache(const std::string& filename, const BVH& bvh, uint64_t key);
+    friend bool LoadBVHCache(const std::string& filename, uint64_t key, BVH* bvh);
+
+  private:
+    /// BVH private data
+    int maxPrimsInNode;
+    SplitMethod splitMethod;
+    ClipFunction clipPrimitive;
+    std::vector<LinearBVHNode> nodes;
+    std::vector<int> primitiveIndices;
+    std::vector<float> buildCost;
+
+    /// Set while the tree is served straight from a memory-mapped cache
+    /// file, the vectors above stay empty until the tree is modified
+    std::shared_ptr<const void> mapping;
+    const LinearBVHNode* mappedNodes;
+    const int* mappedIndices;
+    const float* mappedCost;
+    int nMappedNodes, nMappedIndices;
+
+    /// BVH private methods
+    void Detach();
+    int RecursiveBuild(std::vector<BVHPrimitiveInfo>& primitiveInfo, int start, int end);
+    int RecursiveBuildSpatial(std::vector<BVHPrimitiveInfo>& references, float rootArea,
+        int* duplicationBudget, int depth);
+    Bounds3f ClipReference(const BVHPrimitiveInfo& reference, const Bounds3f& clip) const;
+    int CreateLeaf(const std::vector<BVHPrimitiveInfo>& primitiveInfo, int start, int end,
+        const Bounds3f& bounds);
+    int SubtreeEnd(int nodeIndex) const;
+    void RefitNode(int nodeIndex, const std::vector<Bounds3f>& primitiveBounds);
+    std::vector<float> SubtreeCosts() const;
+    void RebuildSubtree(int nodeIndex, const std::vector<Bounds3f>& primitiveBounds);
+    int CollapseNode(int nodeIndex, int maxPrims, std::vector<LinearBVHNode>* collapsed) const;
+};
+
+/**
+ * \brief Last occluder of shadow rays towards each light. Consecutive
+ * shadow rays are mostly blocked by the same primitive, so testing it
+ * first often skips traversal entirely. Each thread owns its own cache.
+ */
+
+struct OcclusionCache {
+    /// OcclusionCache public data
+    std::vector<int> primID;        /// Last occluding primitive per light, -1 if none
+    std::vector<int> instanceID;    /// Instance of that primitive for top-level accels
+
+    /// OcclusionCache public methods
+    explicit OcclusionCache(int nLights) : primID(nLights, -1), instanceID(nLights, -1) {}
+};
+
+/**
+ * \brief Bottom-level acceleration structure over a set of shapes
+ */
+
+class BVHAccel {
+  public:
+    /// BVHAccel public methods
+    /// A non-empty cacheFilename reuses the tree stored there when the
+    /// shapes and build parameters match, and stores a fresh build otherwise
+    BVHAccel(std::vector<std::shared_ptr<Shape>> shapes, int maxPrimsInNode = 1,
+             SplitMethod splitMethod = SplitMethod::SAH, const std::string& cacheFilename = std::string());
+
+    Bounds3f WorldBound() const;
+    bool Intersect(const Ray& r, SurfaceInteraction* isect) const;
+    bool IntersectP(const Ray& r) const;
+
+    /// Shadow ray towards light, testing the light's last occluder first
+    bool IntersectP(const Ray& r, OcclusionCache* cache, int light) const;
+
+    /// Closest hit as a compact record, the interaction is deferred to
+    /// ComputeSurfaceInteraction so overwritten candidates cost nothing
+    bool Intersect(const Ray& r, HitRecord* hit) const;
+    void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const;
+
+    /// Compact closest hits of a batch of rays with interleaved traversal,
+    /// missed rays keep a primID of -1
+    void Intersect(const Ray* rays, int nRays, HitRecord* hits) const;
+
+    /// Refresh the hierarchy after the shapes moved in place
+    BVHUpdate Update(float rebuildThreshold = 1.5f);
+
+  private:
+    /// BVHAccel private data
+    std::vector<std::shared_ptr<Shape>> shapes;
+    BVH bvh;
+};
+
+/**
+ * \brief BVH template methods
+ */
+
+template <typename F>
+inline bool BVH::Intersect(const Ray& ray, F intersectPrimitive) const {
+    const int* indices = PrimitiveIndices();
+    return IntersectLeaves(ray, [&](int primitivesOffset, int nPrimitives) {
+        /// Intersect ray with primitives in leaf node
+        bool hit = false;
+        for (int i = 0; i < nPrimitives; ++i) {
+            if (intersectPrimitive(indices[primitivesOffset + i])) {
+                hit = true;
+            }
+        }
+        return hit;
+    });
+}
+
+template <typename F>
+inline bool BVH::IntersectP(const Ray& ray, F intersectPrimitive) const {
+    const int* indices = PrimitiveIndices();
+    return IntersectPLeaves(ray, [&](int primitivesOffset, int nPrimitives) {
+        for (int i = 0; i < nPrimitives; ++i) {
+            if (intersectPrimitive(indices[primitivesOffset + i])) {
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+template <typename F>
+inline bool BVH::IntersectLeaves(const Ray& ray, F intersectLeaf) const {
+    if (Empty()) {
+        return false;
+    }
+    const LinearBVHNode* linearNodes = Nodes();
+    bool hit = false;
+    Vec3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+    int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+
+    /// Follow ray through BVH nodes to find primitive intersections
+    int toVisitOffset = 0, currentNodeIndex = 0;
+    int nodesToVisit[64];
+    while (true) {
+        const LinearBVHNode* node = &linearNodes[currentNodeIndex];
+        if (node->bounds.IntersectP(ray, invDir, dirIsNeg)) {
+            if (node->nPrimitives > 0) {
+                if (intersectLeaf(node->primitivesOffset, int(node->nPrimitives))) {
+                    hit = true;
+                }
+                if (toVisitOffset == 0) {
+                    break;
+                }
+                currentNodeIndex = nodesToVisit[--toVisitOffset];
+            } else {
+                /// Put far node on the stack, advance to near node
+                if (dirIsNeg[node->axis]) {
+                    nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
+                    currentNodeIndex = node->secondChildOffset;
+                } else {
+                    nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+                    currentNodeIndex = currentNodeIndex + 1;
+                }
+            }
+        } else {
+            if (toVisitOffset == 0) {
+                break;
+            }
+            currentNodeIndex = nodesToVisit[--toVisitOffset];
+        }
+    }
+    return hit;
+}
+
+template <typename F>
+inline bool BVH::IntersectPLeaves(const Ray& ray, F intersectLeaf) const {
+    if (Empty()) {
+        return false;
+    }
+    const LinearBVHNode* linearNodes = Nodes();
+    Vec3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+    int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+
+    int toVisitOffset = 0, currentNodeIndex = 0;
+    int nodesToVisit[64];
+    while (true) {
+        const LinearBVHNode* node = &linearNodes[currentNodeIndex];
+        if (node->bounds.IntersectP(ray, invDir, dirIsNeg)) {
+            if (node->nPrimitives > 0) {
+                if (intersectLeaf(node->primitivesOffset, int(node->nPrimitives))) {
+                    return true;
+                }
+                if (toVisitOffset == 0) {
+                    break;
+                }
+                currentNodeIndex = nodesToVisit[--toVisitOffset];
+            } else {
+                /// The first child directly follows, so it is the cheapest to fetch
+                nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+                currentNodeIndex = currentNodeIndex + 1;
+            }
+        } else {
+            if (toVisitOffset == 0) {
+                break;
+            }
+            currentNodeIndex = nodesToVisit[--toVisitOffset];
+        }
+    }
+    return false;
+}
+
+template <typename F>
+inline void BVH::IntersectInterleaved(const Ray* rays, int nRays, F intersectPrimitive) const {
+    if (Empty()) {
+        return;
+    }
+    const LinearBVHNode* linearNodes = Nodes();
+    const int* indices = PrimitiveIndices();
+
+    /// Traversal state of one ray, exactly the locals of Intersect
+    struct Lane {
+        int ray;
+        Vec3f invDir;
+        int dirIsNeg[3];
+        int toVisitOffset, currentNodeIndex;
+        int nodesToVisit[64];
+    };
+    const int nLanes = 8;
+    Lane lanes[nLanes];
+    int nextRay = 0;
+    auto startRay = [&](Lane& lane) {
+        if (nextRay == nRays) {
+            lane.ray = -1;
+            return false;
+        }
+        lane.ray = nextRay++;
+        const Ray& ray = rays[lane.ray];
+        lane.invDir = Vec3f(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+        lane.dirIsNeg[0] = lane.invDir.x < 0;
+        lane.dirIsNeg[1] = lane.invDir.y < 0;
+        lane.dirIsNeg[2] = lane.invDir.z < 0;
+        lane.toVisitOffset = 0;
+        lane.currentNodeIndex = 0;
+        return true;
+    };
+    int nActive = 0;
+    for (int l = 0; l < nLanes; ++l) {
+        nActive += startRay(lanes[l]);
+    }
+
+    while (nActive > 0) {
+        for (int l = 0; l < nLanes; ++l) {
+            Lane& lane = lanes[l];
+            if (lane.ray < 0) {
+                continue;
+            }
+
+            /// Visit one node, its fetch was issued when the lane last ran
+            const Ray& ray = rays[lane.ray];
+            const LinearBVHNode* node = &linearNodes[lane.currentNodeIndex];
+            bool popNode = true;
+            if (node->bounds.IntersectP(ray, lane.invDir, lane.dirIsNeg)) {
+                if (node->nPrimitives > 0) {
+                    for (int i = 0; i < node->nPrimitives; ++i) {
+                        intersectPrimitive(lane.ray, indices[node->primitivesOffset + i]);
+                    }
+                } else {
+                    popNode = false;
+                    if (lane.dirIsNeg[node->axis]) {
+                        lane.nodesToVisit[lane.toVisitOffset++] = lane.currentNodeIndex + 1;
+                        lane.currentNodeIndex = node->secondChildOffset;
+                    } else {
+                        lane.nodesToVisit[lane.toVisitOffset++] = node->secondChildOffset;
+                        lane.currentNodeIndex = lane.currentNodeIndex + 1;
+                    }
+                }
+            }
+            if (popNode) {
+                if (lane.toVisitOffset > 0) {
+                    lane.currentNodeIndex = lane.nodesToVisit[--lane.toVisitOffset];
+                } else if (!startRay(lane)) {
+                    --nActive;
+                    continue;
+                }
+            }
+            HEIMDALL_PREFETCH(&linearNodes[lane.currentNodeIndex]);
+        }
+    }
+}
+
+HEIMDALL_NAMESPACE_END
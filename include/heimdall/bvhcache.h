@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "heimdall/common.h"
+#include "heimdall/bvh.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the on-disk cache for built BVHs. A cache file
+    is a fixed header followed by the flattened nodes, the reordered
+    primitive indices and the per-node build costs, laid out exactly
+    as they are in memory. Loading maps the file read-only and points
+    the BVH straight at it, so a cached tree is usable without any
+    copying or parsing. Files are keyed by a hash of the build input
+    and rejected on any mismatch of key, format version or layout.
+ * =================================================================== */
+
+/// Bumped whenever the file layout or LinearBVHNode changes
+static const uint32_t bvhCacheVersion = 1;
+
+/// 64-bit FNV-1a hash, pass a previous result as seed to chain buffers
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+/// Cache key of a build, covers the primitive bounds and build parameters
+uint64_t BVHCacheKey(const std::vector<BVHPrimitiveInfo>& primitiveInfo, int maxPrimsInNode,
+    SplitMethod splitMethod);
+
+/// Store a built tree, written to a temporary file and renamed into
+/// place so concurrent readers never see a partial file
+bool WriteBVHCache(const std::string& filename, const BVH& bvh, uint64_t key);
+
+/// Map a stored tree into bvh, returns false and leaves bvh untouched if
+/// the file is missing or does not match key. A mapped tree has no clip
+/// function and is copied into memory the first time it is refit.
+bool LoadBVHCache(const std::string& filename, uint64_t key, BVH* bvh);
+
+HEIMDALL_NAMESPACE_END
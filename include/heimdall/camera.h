@@ -0,0 +1,123 @@
+#pragma once
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/transform.h"
+#include "heimdall/film.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the cameras that turn film samples into primary
+    rays. Raster space maps onto the near plane of a projective camera
+    affinely, so every camera precomputes where raster (0, 0) lands and
+    how far one pixel step moves it, in camera and in world space. A
+    primary ray is then a couple of multiply adds per component plus
+    the normalization, with no matrix transforms at all.
+
+    Rays are generated in batches, typically all samples of a film
+    tile, behind one virtual call. Cameras that move during the shutter
+    interval fall back to transforming each ray at its own time.
+ * =================================================================== */
+
+/**
+ * \brief Position on the film and shutter time of a camera ray
+ */
+
+struct CameraSample {
+    Point2f pFilm;      /// Continuous raster position
+    float time;         /// Shutter sample in [0, 1), mapped to the shutter interval
+};
+
+/**
+ * \brief Camera base class
+ */
+
+class Camera {
+  public:
+    /// Camera public data
+    const AnimatedTransform CameraToWorld;
+    const float shutterOpen, shutterClose;
+    Film* film;
+
+    /// Camera public methods
+    Camera(const AnimatedTransform& CameraToWorld, float shutterOpen, float shutterClose, Film* film);
+    virtual ~Camera();
+
+    /// Generate the rays with differentials one pixel over in x and in
+    /// y for n samples, rays[i] for samples[i]
+    virtual void GenerateRayDifferentials(const CameraSample* samples, int n, RayDifferential* rays) const = 0;
+
+    /// Single ray convenience, returns the ray weight
+    float GenerateRayDifferential(const CameraSample& sample, RayDifferential* ray) const;
+
+    /// Shutter time of a sample
+    float SampleTime(float u) const {
+        return Lerp(u, shutterOpen, shutterClose);
+    }
+};
+
+/**
+ * \brief Camera with a projective matrix from camera to screen space
+ */
+
+class ProjectiveCamera : public Camera {
+  public:
+    /// ProjectiveCamera public methods
+    ProjectiveCamera(const AnimatedTransform& CameraToWorld, const Transform& CameraToScreen,
+                     const Bounds2f& screenWindow, float shutterOpen, float shutterClose, Film* film);
+
+  protected:
+    /// ProjectiveCamera protected data
+    Transform CameraToScreen, RasterToCamera;
+    Transform ScreenToRaster, RasterToScreen;
+
+    /// Raster (0, 0) on the near plane and one pixel step along x and y
+    Point3f pCamera0;
+    Vec3f dxCamera, dyCamera;
+
+    /// Camera to world at shutter open, exact for static cameras
+    Transform CameraToWorld0;
+};
+
+/**
+ * \brief Orthographic camera, parallel rays along the viewing direction
+ */
+
+class OrthographicCamera final : public ProjectiveCamera {
+  public:
+    /// OrthographicCamera public methods
+    OrthographicCamera(const AnimatedTransform& CameraToWorld, const Bounds2f& screenWindow,
+                       float shutterOpen, float shutterClose, Film* film);
+
+    void GenerateRayDifferentials(const CameraSample* samples, int n, RayDifferential* rays) const;
+
+  private:
+    /// OrthographicCamera private data
+    Point3f pWorld0;
+    Vec3f dxWorld, dyWorld, dirWorld;
+};
+
+/**
+ * \brief Pinhole camera with a field of view along the short image axis
+ */
+
+class PerspectiveCamera final : public ProjectiveCamera {
+  public:
+    /// PerspectiveCamera public methods
+    PerspectiveCamera(const AnimatedTransform& CameraToWorld, const Bounds2f& screenWindow,
+                      float shutterOpen, float shutterClose, float fov, Film* film);
+
+    void GenerateRayDifferentials(const CameraSample* samples, int n, RayDifferential* rays) const;
+
+  private:
+    /// PerspectiveCamera private data
+    Point3f oWorld;
+    Vec3f dWorld0, dxWorld, dyWorld;
+};
+
+/// Screen window [-1, 1] along the short axis of an image with the
+/// aspect ratio of resolution
+Bounds2f DefaultScreenWindow(const Point2i& resolution);
+
+HEIMDALL_NAMESPACE_END
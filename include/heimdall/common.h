@@ -13,9 +13,19 @@
 #define HEIMDALL_NAMESPACE_BEGIN namespace heimdall {
 #define HEIMDALL_NAMESPACE_END }
 
+/// Hint that the cache line at addr will be read soon
+#if defined(__GNUC__) || defined(__clang__)
+#define HEIMDALL_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define HEIMDALL_PREFETCH(addr)
+#endif
+
 /// Error epsilon for ray-surface interaction
 #define Epsilon (std::numeric_limits<float>::epsilon() * 0.5)
 
+/// Largest float below one, keeps samples in [0, 1)
+#define OneMinusEpsilon 0.99999994f
+
 /// Useful constants
 #undef M_PI
 
@@ -43,6 +53,7 @@ class Transform;
 class Quaternion;
 class Interaction;
 class SurfaceInteraction;
+struct HitRecord;
 class Material;
 class Medium;
 class Shape;
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/transform.h"
+#include "heimdall/interaction.h"
+#include "heimdall/shape.h"
+#include "heimdall/triangle.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains a compressed alternative to TriangleMesh for
+    very large scenes. Positions are quantized to 16 bits per axis
+    against the mesh bounds, shading normals are octahedral encoded
+    in two 16 bit values and uvs are stored as half floats. Indices
+    are grouped in blocks of triangles that store one base index and
+    16 bit offsets from it. Nothing is decompressed up front: the
+    intersection and shading kernels decode the three vertices they
+    touch, so the memory saved is also bandwidth saved per ray.
+
+    Shared vertices decode to identical positions, so the quantized
+    mesh stays watertight.
+ * =================================================================== */
+
+/// Octahedral encoding of a unit normal as two 16 bit snorm values
+uint32_t EncodeOctahedral(const Normal3f& n);
+inline Normal3f DecodeOctahedral(uint32_t code);
+
+/// IEEE 754 half precision conversion, rounding to nearest
+uint16_t FloatToHalf(float f);
+inline float HalfToFloat(uint16_t h);
+
+/**
+ * \brief Quantized triangle mesh, stored in world space
+ */
+
+struct CompressedTriangleMesh {
+    /// Triangles per index block
+    static const int blockSize = 16;
+
+    /// One base vertex per block of triangles. Blocks whose vertices
+    /// span more than 16 bits keep full indices at wideOffset instead.
+    struct IndexBlock {
+        uint32_t base;
+        int32_t wideOffset;
+    };
+
+    /// CompressedTriangleMesh public data
+    const int nTriangles, nVertices;
+    Bounds3f bounds;
+    Vec3f scale;                        /// Extent of one quantization step
+    std::vector<uint16_t> p;            /// Three quantized coordinates per vertex
+    std::vector<uint32_t> n;            /// Optional octahedral shading normals
+    std::vector<uint16_t> uv;           /// Optional half precision uvs
+    std::vector<IndexBlock> blocks;
+    std::vector<uint16_t> indexOffsets;
+    std::vector<int> wideIndices;
+
+    /// CompressedTriangleMesh public methods
+    CompressedTriangleMesh(const Transform& ObjectToWorld, int nTriangles, const int* vertexIndices,
+                           int nVertices, const Point3f* P, const Normal3f* N, const Point2f* UV);
+
+    /// Bytes held by the compressed buffers
+    size_t MemoryBytes() const;
+
+    inline void Indices(int triNumber, int v[3]) const;
+    inline Point3f P(int vertex) const;
+    inline Normal3f N(int vertex) const;
+    inline Point2f UV(int vertex) const;
+};
+
+struct ShapeArrays;
+
+/**
+ * \brief Every triangle of a compressed mesh as one shape. Only
+ * ShapeArrays creates these, and its accel addresses single triangles
+ * by number, so nothing is stored per triangle beyond the compressed
+ * buffers themselves and the mesh never becomes a single BVH leaf.
+ */
+
+class CompressedMeshShape final : public Shape {
+  public:
+    /// CompressedMeshShape public data
+    std::shared_ptr<const CompressedTriangleMesh> mesh;
+
+    /// CompressedMeshShape public methods
+    CompressedMeshShape(CompressedMeshShape&&) = default;
+    CompressedMeshShape(const CompressedMeshShape&) = delete;
+    CompressedMeshShape& operator=(const CompressedMeshShape&) = delete;
+
+    /// Whole mesh, the intersections test every triangle in turn
+    Bounds3f ObjectBounds() const;
+    Bounds3f WorldBounds() const;
+    bool Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool testSurfaceAlpha = true) const;
+    bool IntersectTest(const Ray& r, bool testSurfaceAlpha = true) const;
+    float Area() const;
+    using Shape::IntersectHit;
+    using Shape::ComputeSurfaceInteraction;
+
+    /// Single triangle, uv holds the barycentrics of the second and third vertex
+    Bounds3f TriangleBounds(int triNumber) const;
+    inline bool IntersectHit(const Ray& r, int triNumber, HitRecord* hit) const;
+    void ComputeSurfaceInteraction(const Ray& r, int triNumber, const HitRecord& hit,
+                                   SurfaceInteraction* isect) const;
+
+  private:
+    friend struct ShapeArrays;
+
+    /// CompressedMeshShape private methods
+    CompressedMeshShape(const Transform* ObjectToWorld, const Transform* WorldToObject, bool reverseOrientation,
+                        std::shared_ptr<const CompressedTriangleMesh> mesh);
+};
+
+/**
+ * \brief Compressed mesh inline functions
+ */
+
+inline Normal3f DecodeOctahedral(uint32_t code) {
+    float x = std::max(float(int16_t(code & 0xffff)) / 32767.0f, -1.0f);
+    float y = std::max(float(int16_t(code >> 16)) / 32767.0f, -1.0f);
+    float z = 1.0f - std::abs(x) - std::abs(y);
+    if (z < 0.0f) {
+        /// Unfold the lower hemisphere
+        float fx = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    return Normalize(Normal3f(x, y, z));
+}
+
+inline float HalfToFloat(uint16_t h) {
+    uint32_t sign = uint32_t(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0x1f) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    } else if (mantissa != 0) {
+        /// Renormalize a subnormal half
+        exponent = 113;
+        while (!(mantissa & 0x400)) {
+            mantissa <<= 1;
+            --exponent;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    } else {
+        bits = sign;
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(float));
+    return f;
+}
+
+/**
+ * \brief CompressedTriangleMesh inline methods
+ */
+
+inline void CompressedTriangleMesh::Indices(int triNumber, int v[3]) const {
+    const IndexBlock& block = blocks[triNumber / blockSize];
+    if (block.wideOffset >= 0) {
+        const int* wide = &wideIndices[block.wideOffset + 3 * (triNumber % blockSize)];
+        v[0] = wide[0];
+        v[1] = wide[1];
+        v[2] = wide[2];
+        return;
+    }
+    const uint16_t* offsets = &indexOffsets[3 * triNumber];
+    v[0] = int(block.base + offsets[0]);
+    v[1] = int(block.base + offsets[1]);
+    v[2] = int(block.base + offsets[2]);
+}
+
+inline Point3f CompressedTriangleMesh::P(int vertex) const {
+    const uint16_t* q = &p[3 * vertex];
+    return Point3f(bounds.pMin.x + float(q[0]) * scale.x,
+                   bounds.pMin.y + float(q[1]) * scale.y,
+                   bounds.pMin.z + float(q[2]) * scale.z);
+}
+
+inline Normal3f CompressedTriangleMesh::N(int vertex) const {
+    return DecodeOctahedral(n[vertex]);
+}
+
+inline Point2f CompressedTriangleMesh::UV(int vertex) const {
+    return Point2f(HalfToFloat(uv[2 * vertex]), HalfToFloat(uv[2 * vertex + 1]));
+}
+
+/**
+ * \brief CompressedMeshShape inline methods
+ */
+
+inline bool CompressedMeshShape::IntersectHit(const Ray& r, int triNumber, HitRecord* hit) const {
+    /// Decode only the three vertices of this triangle
+    int v[3];
+    mesh->Indices(triNumber, v);
+    return IntersectTriangle(r, mesh->P(v[0]), mesh->P(v[1]), mesh->P(v[2]), hit);
+}
+
+HEIMDALL_NAMESPACE_END
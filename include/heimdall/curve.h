@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/transform.h"
+#include "heimdall/interaction.h"
+#include "heimdall/shape.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains a cubic Bezier curve shape for hair and fur.
+    Curves are intersected directly instead of being tessellated: the
+    control points are projected into a coordinate system whose z
+    axis is the ray, and the curve is split recursively until each
+    piece is close enough to a line segment to test against the
+    ray's position with its interpolated width.
+
+    Flat curves always face the ray, cylinder curves also face the
+    ray but bend their shading normal as if they were tubes, and
+    ribbon curves are oriented by normals given at both ends.
+ * =================================================================== */
+
+/// How the width of a curve is swept along it
+enum class CurveType { Flat, Cylinder, Ribbon };
+
+/**
+ * \brief Control points and widths shared by the segments of one curve
+ */
+
+struct CurveCommon {
+    /// CurveCommon public data
+    const CurveType type;
+    Point3f cpObj[4];
+    float width[2];
+    Normal3f n[2];              /// Ribbon orientation at both ends
+    float normalAngle, invSinNormalAngle;
+    bool orientedBounds;        /// Segments keep an oriented box to reject rays early
+
+    /// CurveCommon public methods
+    CurveCommon(const Point3f c[4], float width0, float width1, CurveType type, const Normal3f* norm,
+                bool orientedBounds = false);
+};
+
+/**
+ * \brief Parametric range [uMin, uMax] of a cubic Bezier curve
+ */
+
+class Curve final : public Shape {
+  public:
+    /// Curve public methods
+    Curve(const Transform* ObjectToWorld, const Transform* WorldToObject, bool reverseOrientation,
+          const std::shared_ptr<const CurveCommon>& common, float uMin, float uMax);
+
+    /// Bounds of the blossomed control points of this segment only
+    Bounds3f ObjectBounds() const;
+    Bounds3f WorldBounds() const;
+    bool Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool testSurfaceAlpha = true) const;
+    bool IntersectTest(const Ray& r, bool testSurfaceAlpha = true) const;
+    float Area() const;
+
+    /// uv holds the curve parameter and the position across its width
+    bool IntersectHit(const Ray& r, HitRecord* hit, bool testSurfaceAlpha = true) const;
+    void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const;
+
+  private:
+    /// Curve private data
+    std::shared_ptr<const CurveCommon> common;
+    float uMin, uMax;
+    Point3f cp[4];              /// Control points of [uMin, uMax] in object space
+
+    /// Object space box aligned with the segment chord, if enabled
+    Vec3f boxAxis[3];
+    Bounds3f box;
+
+    /// Curve private methods
+    bool Hit(const Ray& ray, float* tHit, Point2f* uv, bool anyHit) const;
+    bool RecursiveHit(const Ray& ray, float rayLength, const Point3f cp[4], float u0, float u1, int depth,
+                      float* zMax, Point2f* uv, bool anyHit) const;
+    bool InsideOrientedBounds(const Ray& ray) const;
+};
+
+/// Returns no segments for a curve without positive width, or a ribbon
+/// without normals, neither of which could ever be hit
+std::vector<std::shared_ptr<Shape>> CreateCurve(const Transform* ObjectToWorld, const Transform* WorldToObject,
+    bool reverseOrientation, const Point3f c[4], float width0, float width1, CurveType type,
+    const Normal3f* norm = nullptr, int nSegments = 1, bool orientedBounds = false);
+
+HEIMDALL_NAMESPACE_END
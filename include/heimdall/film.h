@@ -0,0 +1,197 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/filter.h"
+#include "heimdall/aov.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the image accumulation stage. Workers never
+    write to the film directly: each one takes a FilmTile covering the
+    pixels its samples can reach, padded by the filter radius, and
+    filters its samples into it privately. A finished tile is merged
+    back one row at a time under a striped row lock, so tiles only
+    wait on each other where their padding overlaps the same rows.
+
+    Tiles come from a pool owned by the film and sized up front, so
+    rendering a frame does not allocate per tile.
+
+    AOVs live in buffers of their own, sized by the film's AOVLayout,
+    so a film without AOVs allocates and touches nothing for them.
+ * =================================================================== */
+
+inline float Luminance(const RGB& rgb) {
+    return 0.2126f * rgb.x + 0.7152f * rgb.y + 0.0722f * rgb.z;
+}
+
+/**
+ * \brief Running mean and variance of the samples of one pixel
+ */
+
+struct VarianceEstimator {
+    int count = 0;
+    float mean = 0.0f;
+    float m2 = 0.0f;
+
+    /// Welford's update
+    void Add(float x) {
+        ++count;
+        float delta = x - mean;
+        mean += delta / count;
+        m2 += delta * (x - mean);
+    }
+
+    /// Combine the statistics of two disjoint sets of samples
+    void Merge(const VarianceEstimator& ve) {
+        if (ve.count == 0) {
+            return;
+        }
+        int n = count + ve.count;
+        float delta = ve.mean - mean;
+        mean += delta * ve.count / n;
+        m2 += ve.m2 + delta * delta * (float(count) * ve.count / n);
+        count = n;
+    }
+
+    float Variance() const {
+        return count > 1 ? m2 / (count - 1) : 0.0f;
+    }
+
+    /// Standard error of the mean relative to the mean, with a floor on
+    /// the mean so that dark pixels are judged on absolute error
+    float RelativeError(float minMean) const {
+        if (count < 2) {
+            return INFINITY;
+        }
+        return std::sqrt(Variance() / count) / std::max(std::abs(mean), minMean);
+    }
+};
+
+/**
+ * \brief Filtered sample sums of one pixel of a tile
+ */
+
+struct FilmTilePixel {
+    RGB contribSum;
+    float filterWeightSum = 0.0f;
+    VarianceEstimator variance;     /// Luminance of the samples inside the pixel
+};
+
+/**
+ * \brief Private accumulation buffer for a region of the film
+ */
+
+class FilmTile {
+  public:
+    /// FilmTile public methods
+    FilmTile(const Vec2f& filterRadius, const float* filterTable, int filterTableWidth, int pixelCapacity,
+             const AOVLayout* aovLayout);
+
+    /// Filter a radiance sample at continuous film position pFilm into
+    /// every tile pixel within the filter radius, and add its luminance
+    /// to the variance of the pixel it lies in
+    void AddSample(const Point2f& pFilm, const RGB& L, float sampleWeight = 1.0f);
+
+    /// Add the AOVs of a sample to the pixel it lies in, a no-op for
+    /// films without AOVs
+    void AddAOVSample(const Point2f& pFilm, const AOVSample& sample);
+
+    const FilmTilePixel& GetPixel(const Point2i& p) const;
+    Bounds2i GetPixelBounds() const;
+
+  private:
+    friend class Film;
+
+    /// FilmTile private data
+    Bounds2i pixelBounds;
+    const Vec2f filterRadius, invFilterRadius;
+    const float* filterTable;
+    const int filterTableWidth;
+    std::vector<FilmTilePixel> pixels;
+    const AOVLayout* aovLayout;
+    std::vector<float> aovPixels;       /// aovLayout->nFloats per pixel
+    std::vector<int> ifx, ify;          /// AddSample filter table offsets per column and row
+
+    /// FilmTile private methods
+    void Reset(const Bounds2i& pixelBounds);
+};
+
+/**
+ * \brief Image plane of the camera
+ */
+
+class Film {
+  public:
+    /// Film public data
+    const Point2i fullResolution;
+    const Bounds2i pixelBounds;
+    const AOVLayout aovLayout;
+
+    /// Film public methods
+    /// Tiles of up to maxTileSize samples on a side are pooled, nPooledTiles
+    /// of them up front, two per thread by default
+    Film(const Point2i& resolution, std::unique_ptr<Filter> filter, int maxTileSize = 16, int nPooledTiles = 0,
+         const AOVLayout& aovLayout = AOVLayout());
+
+    /// Continuous sample positions that contribute to some pixel
+    Bounds2i GetSampleBounds() const;
+    Vec2f GetFilterRadius() const;
+
+    /// Tile for the samples inside sampleBounds. It stays owned by the
+    /// film and must be handed back through MergeFilmTile.
+    FilmTile* GetFilmTile(const Bounds2i& sampleBounds);
+    void MergeFilmTile(FilmTile* tile);
+
+    /// Filtered pixel value, black where no sample landed
+    RGB GetPixel(const Point2i& p) const;
+
+    /// Luminance statistics of the samples taken inside a pixel, and the
+    /// largest and the mean relative error over the pixels of a region
+    const VarianceEstimator& GetPixelVariance(const Point2i& p) const;
+    float RegionError(const Bounds2i& region) const;
+    float MeanError(const Bounds2i& region) const;
+
+    /// Snapshot of the whole image, safe while tiles are being merged
+    std::vector<RGB> GetImage() const;
+
+    /// Pixel values of a region as interleaved RGB floats, rows top to
+    /// bottom, under the same row locks as GetImage
+    void GetRegion(const Bounds2i& region, float* rgb) const;
+
+    /// Resolved AOVs of a region, aovLayout.nChannels values per pixel
+    void GetAOVRegion(const Bounds2i& region, float* values) const;
+
+    /// Names of the RGB channels followed by those of the AOVs, and the
+    /// values of all of them for a region, interleaved per pixel
+    std::vector<std::string> GetChannelNames() const;
+    void GetChannelRegion(const Bounds2i& region, float* values) const;
+    void Clear();
+
+    int PooledTileCount() const;
+
+  private:
+    /// Pixel of the film, summed over every merged tile
+    struct Pixel {
+        float rgb[3] = {0.0f, 0.0f, 0.0f};
+        float filterWeightSum = 0.0f;
+        VarianceEstimator variance;
+    };
+
+    /// Film private data
+    std::unique_ptr<Filter> filter;
+    std::vector<Pixel> pixels;
+    std::vector<float> aovPixels;
+    std::vector<float> filterTable;
+    mutable std::vector<std::mutex> rowLocks;
+    int tileCapacity;
+    std::vector<std::unique_ptr<FilmTile>> tilePool;
+    std::vector<FilmTile*> freeTiles;
+    mutable std::mutex poolMutex;
+};
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief Pixel reconstruction filter centered at the origin
+ */
+
+class Filter {
+  public:
+    /// Filter public data
+    const Vec2f radius, invRadius;
+
+    /// Filter public methods
+    explicit Filter(const Vec2f& radius);
+    virtual ~Filter();
+
+    /// Filter weight at p, relative to the filter center
+    virtual float Evaluate(const Point2f& p) const = 0;
+};
+
+class BoxFilter final : public Filter {
+  public:
+    /// BoxFilter public methods
+    explicit BoxFilter(const Vec2f& radius);
+    float Evaluate(const Point2f& p) const;
+};
+
+class TriangleFilter final : public Filter {
+  public:
+    /// TriangleFilter public methods
+    explicit TriangleFilter(const Vec2f& radius);
+    float Evaluate(const Point2f& p) const;
+};
+
+class GaussianFilter final : public Filter {
+  public:
+    /// GaussianFilter public methods
+    GaussianFilter(const Vec2f& radius, float alpha);
+    float Evaluate(const Point2f& p) const;
+
+  private:
+    /// GaussianFilter private data
+    const float alpha;
+    const float expX, expY;
+
+    /// GaussianFilter private methods
+    float Gaussian(float d, float expv) const;
+};
+
+HEIMDALL_NAMESPACE_END
@@ -394,7 +394,7 @@ class Point3 {
     }
 
     Point3<T> operator-(const Vec3<T>& v) const {
-        return Point3<T>(x - v.x, y - v.y), z - v.z;
+        return Point3<T>(x - v.x, y - v.y, z - v.z);
     }
 
     Point3<T>& operator-=(const Vec3<T>& v) {
@@ -684,7 +684,7 @@ class Bounds2 {
         if (pMax.y > pMin.y) {
             o.y /= pMax.y - pMin.y;
         }
-        return o;
+        return Point2<T>(o.x, o.y);
     }
 };
 
@@ -702,8 +702,8 @@ class Bounds3 {
     Bounds3() {
         T minNum = std::numeric_limits<T>::lowest();
         T maxNum = std::numeric_limits<T>::max();
-        pMin = Point3<T>(maxNum, maxNum);
-        pMax = Point3<T>(minNum, minNum);
+        pMin = Point3<T>(maxNum, maxNum, maxNum);
+        pMax = Point3<T>(minNum, minNum, minNum);
     }
 
     Bounds3(const Point3<T>& p) {
@@ -772,7 +772,7 @@ class Bounds3 {
         if (pMax.z > pMin.z) {
             o.z /= pMax.z - pMin.z;
         }
-        return o;
+        return Point3<T>(o.x, o.y, o.z);
     }
 
     void BoudingSphere(Point3<T>* center, float* radius) {
@@ -835,9 +835,9 @@ class Bounds3 {
         }
 
         float tzMin = (bounds[    dirIsNeg[2]].z - r.o.z) * invDir.z;
-        float tzMax = (bounds[1 - dirIsNeg[2]].y - r.o.z) * invDir.z;
+        float tzMax = (bounds[1 - dirIsNeg[2]].z - r.o.z) * invDir.z;
 
-        if (tMin > tyMax or tzMin > tMax) {
+        if (tMin > tzMax or tzMin > tMax) {
             return false;
         }
         if (tzMin > tMin) {
@@ -1094,6 +1094,16 @@ inline Vec3<T> Lerp(float dt, const Vec3<T>& v1, const Vec3<T>& v2) {
  * \brief Point inline functions
  */
 
+template <typename T, typename U>
+inline Point2<T> operator*(U s, const Point2<T>& p) {
+    return p * s;
+}
+
+template <typename T, typename U>
+inline Point3<T> operator*(U s, const Point3<T>& p) {
+    return p * s;
+}
+
 template <typename T>
 inline float Distance(const Point2<T>& p1, const Point2<T>& p2) {
     return (p1 - p2).Length();
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the image output. Finished regions of an image
+    are handed to a TiledImageWriter as they complete and written out
+    by a background I/O thread, so the image never has to be copied
+    out in full and written serially at the end.
+
+    Every piece of the output file has a fixed position known when it
+    is opened: uncompressed EXR tiles are laid out in tile order after
+    the header and offset table, and PFM scanlines are rows of fixed
+    width. Data can therefore be written the moment it is ready, in
+    any order. The queue between the callers and the I/O thread is
+    bounded in bytes and callers block when it is full, so a slow disk
+    throttles rendering instead of growing memory without limit.
+
+    Regions that only cover part of an EXR tile are held until the
+    rest of the tile arrives. Those partial tiles are outside the
+    queue bound, blocking on them could wait for a region the blocked
+    caller itself has yet to write, so callers that stream a large
+    image should write regions aligned to tileSize.
+ * =================================================================== */
+
+class Film;
+
+enum class ImageFormat { EXR, PFM };
+
+/// PFM for names ending in .pfm, tiled EXR otherwise
+ImageFormat ImageFormatFromFilename(const std::string& filename);
+
+/**
+ * \brief Streams regions of an image to disk on a background thread
+ */
+
+class TiledImageWriter {
+  public:
+    /// TiledImageWriter public data
+    const Point2i resolution;
+    const ImageFormat format;
+    const int nChannels;
+    const int tileSize;         /// Side of an EXR tile
+
+    /// TiledImageWriter public methods
+    /// Open filename for an image of the named channels, returns nullptr
+    /// if the file cannot be created. PFM holds one or three channels.
+    /// EXR tiles are tileSize pixels on a side.
+    static std::unique_ptr<TiledImageWriter> Create(const std::string& filename, const Point2i& resolution,
+                                                    const std::vector<std::string>& channelNames,
+                                                    int tileSize = 64, size_t maxQueuedBytes = 64 << 20);
+    ~TiledImageWriter();
+
+    /// Hand over the final values of region, nChannels floats per pixel
+    /// in the channel order given at creation, rows top to bottom. Any
+    /// thread may call this, with regions in any order, but every pixel
+    /// must be written at most once. Blocks while the queue is full.
+    void WriteRegion(const Bounds2i& region, const float* pixels);
+
+    /// Bytes of partly written EXR tiles held back from the queue
+    size_t PendingBytes() const;
+
+    /// Write whatever is still pending, with zeros for pixels never
+    /// written, and close the file. Returns false if any write failed.
+    bool Close();
+
+  private:
+    /// Bytes to be written at a fixed position of the file
+    struct Chunk {
+        uint64_t offset;
+        std::vector<char> bytes;
+    };
+
+    /// EXR tile waiting for the rest of its pixels
+    struct PendingTile {
+        std::vector<char> bytes;
+        int remainingPixels;
+    };
+
+    /// TiledImageWriter private data
+    int fd;
+    Point2i nTiles;
+    std::vector<int> channelOrder;      /// Input channel of each stored channel
+    std::vector<uint64_t> tileOffsets;
+    uint64_t pixelOffset;               /// Start of the PFM pixel data
+    size_t maxQueuedBytes;
+    std::map<int, PendingTile> pendingTiles;
+    std::vector<bool> tileDone;
+    mutable std::mutex pendingMutex;
+
+    std::deque<Chunk> queue;
+    size_t queuedBytes;
+    bool closing;
+    bool failed;
+    std::mutex queueMutex;
+    std::condition_variable chunkReady, spaceReady;
+    std::thread ioThread;
+
+    /// TiledImageWriter private methods
+    TiledImageWriter(int fd, const Point2i& resolution, ImageFormat format, int nChannels, int tileSize,
+                     size_t maxQueuedBytes);
+    Bounds2i TileBounds(int tileIndex) const;
+    PendingTile& GetPendingTile(int tileIndex);
+    void Enqueue(Chunk chunk);
+    void IOLoop();
+};
+
+/// Write the film's image to filename through a TiledImageWriter, a band
+/// of rows at a time. EXR files get the film's AOVs as extra channels.
+bool WriteImage(const Film& film, const std::string& filename);
+
+HEIMDALL_NAMESPACE_END
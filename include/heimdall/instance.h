@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/transform.h"
+#include "heimdall/bvh.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief Placement of a shared bottom-level BVH in the world. The
+ * geometry lives once in the BVHAccel, every instance only adds a
+ * pair of transforms.
+ */
+
+class Instance {
+  public:
+    /// Instance public data
+    std::shared_ptr<const BVHAccel> blas;
+    Transform InstanceToWorld, WorldToInstance;
+
+    /// Instance public methods
+    Instance(std::shared_ptr<const BVHAccel> blas, const Transform& InstanceToWorld);
+
+    Bounds3f WorldBound() const;
+    bool Intersect(const Ray& r, SurfaceInteraction* isect) const;
+    bool IntersectP(const Ray& r) const;
+    bool IntersectP(const Ray& r, OcclusionCache* cache, int light) const;
+    bool Intersect(const Ray& r, HitRecord* hit) const;
+    void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const;
+};
+
+/**
+ * \brief Top-level acceleration structure over a set of instances
+ */
+
+class InstanceAccel {
+  public:
+    /// InstanceAccel public methods
+    InstanceAccel(std::vector<Instance> instances, int maxPrimsInNode = 1,
+                  SplitMethod splitMethod = SplitMethod::SAH);
+
+    Bounds3f WorldBound() const;
+    bool Intersect(const Ray& r, SurfaceInteraction* isect) const;
+    bool IntersectP(const Ray& r) const;
+
+    /// Shadow ray towards light, testing the light's last occluder first
+    bool IntersectP(const Ray& r, OcclusionCache* cache, int light) const;
+
+    /// Compact closest hit, see BVHAccel::Intersect
+    bool Intersect(const Ray& r, HitRecord* hit) const;
+    void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const;
+
+    /// Compact closest hits of a batch of rays with interleaved traversal
+    void Intersect(const Ray* rays, int nRays, HitRecord* hits) const;
+
+    /// Move an instance, the hierarchy is refreshed by the next Update
+    void SetTransform(size_t index, const Transform& InstanceToWorld);
+
+    /// Refresh the hierarchy after instances moved or their BVHs were updated
+    BVHUpdate Update(float rebuildThreshold = 1.5f);
+
+  private:
+    /// InstanceAccel private data
+    std::vector<Instance> instances;
+    BVH bvh;
+};
+
+HEIMDALL_NAMESPACE_END
@@ -20,11 +20,29 @@ class Interaction {
     float time;   
 
     /// Interaction public methods
+    Interaction() : time(0.0f) {}
     Interaction(const Point3f& p, const Normal3f& n, const Vec3f& error, const Vec3f& wo, float time);
     
     bool isSurfaceInteraction() const;
 };
 
+/**
+ * \brief Compact record of a ray hit, cheap enough to overwrite for
+ * every candidate during traversal. The full SurfaceInteraction is
+ * only built from it once the closest hit is known.
+ */
+
+struct HitRecord {
+    /// HitRecord public data
+    float t;
+    int primID;       /// Shape index within its BVHAccel
+    int instanceID;   /// Instance index within the top-level accel, -1 if none
+    Point2f uv;       /// Shape specific surface coordinates
+
+    /// HitRecord public methods
+    HitRecord() : t(INFINITY), primID(-1), instanceID(-1) {}
+};
+
 /**
  * \brief SurfaceInteraction class declarations
  */
@@ -36,21 +54,35 @@ class SurfaceInteraction: public Interaction {
     Vec3f    dpdu, dpdv;
     Normal3f dndu, dndv;
     const Shape* shape = nullptr;
+    int instanceID = -1;    /// Scene instance that was hit, -1 if not reached through one
 
     /// Struct for shading geometry terms
-    struct {
+    struct ShadingGeometry {
         Normal3f n;
         Vec3f    dpdu, dpdv;
         Normal3f dndu, dndv;
-    } shading;
+    };
 
     /// SurfaceInteraction public methods
+    SurfaceInteraction() : hasShadingGeometry(false), shadingValid(false) {}
     SurfaceInteraction(const Point3f& p, const Vec3f& error, const Point2f& uv, const Vec3f& wo,
         const Vec3f& dpdu, const Vec3f& dpdv, const Normal3f& dndu, const Normal3f& dndv,
         float time, const Shape* shape);
 
     void SetShadingGeometry(const Vec3f& dpdus, const Vec3f& dpdvs, const Normal3f& dndus, const Normal3f& dndvs,
         bool orientationIsAuthoritative);
+
+    /// Shading geometry, derived and cached on first use so queries that
+    /// never shade do not pay for it
+    const ShadingGeometry& Shading() const;
+
+  private:
+    friend class Transform;
+
+    /// SurfaceInteraction private data
+    bool hasShadingGeometry;            /// Set by SetShadingGeometry, otherwise shading is the geometric frame
+    mutable bool shadingValid;          /// Cached terms below are up to date
+    mutable ShadingGeometry shading;
 };
 
 HEIMDALL_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the low discrepancy sequences behind the
+    samplers. Sobol generator matrices, Halton digit permutations and
+    the progressive multi-jittered (0, 2) point sets are all built once
+    on first use and shared by every sampler afterwards, so drawing a
+    sample is a table walk with no setup.
+
+    Sequences are randomized per pixel with hashed seeds: Owen
+    scrambling for Sobol, digit permutations for Halton and random
+    digit xors for the (0, 2) sets. All three keep the stratification
+    of the unscrambled points.
+ * =================================================================== */
+
+/// Dimensions with their own Sobol generator matrix, higher ones reuse
+/// them with different scrambles
+static const int nSobolDimensions = 16;
+
+/// Dimensions with their own Halton prime base
+static const int nHaltonDimensions = 64;
+
+/// Progressive multi-jittered (0, 2) point sets and points per set
+static const int nPMJ02Sets = 5;
+static const int pmj02SetSize = 4096;
+
+/**
+ * \brief Low discrepancy inline functions
+ */
+
+inline uint32_t ReverseBits32(uint32_t n) {
+    n = (n << 16) | (n >> 16);
+    n = ((n & 0x00ff00ff) << 8) | ((n & 0xff00ff00) >> 8);
+    n = ((n & 0x0f0f0f0f) << 4) | ((n & 0xf0f0f0f0) >> 4);
+    n = ((n & 0x33333333) << 2) | ((n & 0xcccccccc) >> 2);
+    n = ((n & 0x55555555) << 1) | ((n & 0xaaaaaaaa) >> 1);
+    return n;
+}
+
+/// 64 bit finalizer, every input bit affects every output bit
+inline uint64_t MixBits(uint64_t v) {
+    v ^= v >> 31;
+    v *= 0x7fb5d329728ea185ull;
+    v ^= v >> 27;
+    v *= 0x81dadef4bc2dd44dull;
+    v ^= v >> 33;
+    return v;
+}
+
+/// Seed of a pixel and dimension, for decorrelating pixels
+inline uint64_t HashPixel(const Point2i& p, int dimension, uint64_t seed) {
+    uint64_t pixel = (uint64_t(uint32_t(p.x)) << 32) | uint32_t(p.y);
+    return MixBits(pixel ^ MixBits((uint64_t(uint32_t(dimension)) << 32) ^ seed));
+}
+
+/// Nested uniform scramble of the bits of v. Each bit is flipped based
+/// only on the bits above it, so elementary intervals map to each other.
+inline uint32_t OwenScramble(uint32_t v, uint32_t seed) {
+    v = ReverseBits32(v);
+    v ^= v * 0x3d20adea;
+    v += seed;
+    v *= (seed >> 16) | 1;
+    v ^= v * 0x05526c56;
+    v ^= v * 0x53a22864;
+    return ReverseBits32(v);
+}
+
+/// Fixed point fraction in [0, 1)
+inline float BitsToFloat01(uint32_t v) {
+    return std::min(float(v) * 2.3283064365386963e-10f, OneMinusEpsilon);
+}
+
+/// 32 columns of the Sobol generator matrix of dimension, most
+/// significant bit first
+const uint32_t* SobolMatrix(int dimension);
+
+/// Unscrambled Sobol point index in dimension, as a 32 bit fraction
+inline uint32_t SobolBits(uint64_t index, int dimension) {
+    const uint32_t* matrix = SobolMatrix(dimension % nSobolDimensions);
+    uint32_t v = 0;
+    for (int i = 0; index != 0 and i < 32; index >>= 1, ++i) {
+        if (index & 1) {
+            v ^= matrix[i];
+        }
+    }
+    return v;
+}
+
+inline float SobolSample(uint64_t index, int dimension, uint32_t seed) {
+    return BitsToFloat01(OwenScramble(SobolBits(index, dimension), seed));
+}
+
+/// The baseIndex-th prime, from 2 up
+int Prime(int baseIndex);
+
+/// Digits of a in base Prime(baseIndex) mirrored around the radix point
+float RadicalInverse(int baseIndex, uint64_t a);
+
+/// Digit permutation of Prime(baseIndex) shared by every Halton sampler
+const uint16_t* RadicalInversePermutation(int baseIndex);
+
+/// RadicalInverse with every digit, the infinite trailing zeros
+/// included, replaced by its image under perm
+float ScrambledRadicalInverse(int baseIndex, uint64_t a, const uint16_t* perm);
+
+/// Point sampleIndex of a (0, 2) set as 32 bit fractions
+void PMJ02Bits(int setIndex, int sampleIndex, uint32_t* x, uint32_t* y);
+
+HEIMDALL_NAMESPACE_END
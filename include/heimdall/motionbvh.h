@@ -0,0 +1,233 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/transform.h"
+#include "heimdall/bvh.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the motion blur BVH. Every node stores its
+    bounds at the start and end of its time range; traversal linearly
+    interpolates them at Ray::time, so a moving primitive is only
+    tested against the space it occupies around that instant instead
+    of everything it sweeps over the whole shutter. Nodes may also
+    split the time range in two when motion is large compared to the
+    primitives themselves.
+ * =================================================================== */
+
+/**
+ * \brief Pair of bounds at the start and end of a time range, any
+ * linear interpolation between them contains the primitive
+ */
+
+struct LinearBounds3f {
+    /// LinearBounds3f public data
+    Bounds3f bounds0, bounds1;
+
+    /// LinearBounds3f public methods
+    LinearBounds3f() {}
+    LinearBounds3f(const Bounds3f& bounds0, const Bounds3f& bounds1) : bounds0(bounds0), bounds1(bounds1) {}
+
+    Bounds3f Interpolate(float t) const {
+        Bounds3f ret;
+        ret.pMin = Lerp(t, bounds0.pMin, bounds1.pMin);
+        ret.pMax = Lerp(t, bounds0.pMax, bounds1.pMax);
+        return ret;
+    }
+
+    /// Expected surface area over the time range
+    float ExpectedArea() const {
+        return 0.25f * bounds0.SurfaceArea() + 0.5f * Interpolate(0.5f).SurfaceArea() +
+               0.25f * bounds1.SurfaceArea();
+    }
+};
+
+LinearBounds3f Union(const LinearBounds3f& b1, const LinearBounds3f& b2);
+
+/// Conservative linear bounds of a box moved by an AnimatedTransform over [time0, time1]
+LinearBounds3f MotionBounds(const AnimatedTransform& transform, const Bounds3f& b, float time0, float time1);
+
+/// Linear bounds of a primitive over [time0, time1]
+typedef std::function<LinearBounds3f(size_t primitiveNumber, float time0, float time1)> MotionBoundsFunction;
+
+/**
+ * \brief Motion BVH node, 64 bytes so each node fills one cache line
+ */
+
+struct MotionBVHNode {
+    LinearBounds3f bounds;
+    float time0, time1;
+    union {
+        int primitivesOffset;   /// Leaf
+        int secondChildOffset;  /// Interior
+    };
+    uint16_t nPrimitives;       /// Zero for interior nodes
+    uint8_t axis;               /// Interior node split axis
+    uint8_t temporalSplit;      /// Children split the time range instead of space
+};
+
+struct MotionPrimitiveInfo;
+
+/**
+ * \brief Bounding volume hierarchy over moving primitives
+ */
+
+class MotionBVH {
+  public:
+    /// MotionBVH public methods
+    MotionBVH() {}
+    MotionBVH(size_t nPrimitives, float shutterOpen, float shutterClose, MotionBoundsFunction primitiveBounds,
+              int maxPrimsInNode = 1);
+
+    Bounds3f WorldBound() const;
+
+    const std::vector<MotionBVHNode>& Nodes() const {
+        return nodes;
+    }
+
+    /// Closest hit traversal, see BVH::Intersect
+    template <typename F>
+    bool Intersect(const Ray& ray, F intersectPrimitive) const;
+
+    /// Any hit traversal, see BVH::IntersectP
+    template <typename F>
+    bool IntersectP(const Ray& ray, F intersectPrimitive) const;
+
+  private:
+    /// MotionBVH private data
+    int maxPrimsInNode;
+    float minTemporalRange;
+    std::vector<MotionBVHNode> nodes;
+    std::vector<int> primitiveIndices;
+
+    /// MotionBVH private methods
+    int RecursiveBuild(std::vector<MotionPrimitiveInfo>& primitiveInfo, const MotionBoundsFunction& primitiveBounds,
+        float time0, float time1, int depth);
+    int CreateLeaf(const std::vector<MotionPrimitiveInfo>& primitiveInfo, const LinearBounds3f& bounds,
+        float time0, float time1);
+    template <typename F, bool AnyHit>
+    bool Traverse(const Ray& ray, F intersectPrimitive) const;
+};
+
+/**
+ * \brief Instance of a shared BVH placed by an AnimatedTransform
+ */
+
+class MotionInstance {
+  public:
+    /// MotionInstance public data
+    std::shared_ptr<const BVHAccel> blas;
+    const AnimatedTransform* InstanceToWorld;
+
+    /// MotionInstance public methods
+    MotionInstance(std::shared_ptr<const BVHAccel> blas, const AnimatedTransform* InstanceToWorld);
+
+    LinearBounds3f WorldBound(float time0, float time1) const;
+    bool Intersect(const Ray& r, SurfaceInteraction* isect) const;
+    bool IntersectP(const Ray& r) const;
+    bool Intersect(const Ray& r, HitRecord* hit) const;
+    void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const;
+};
+
+/**
+ * \brief Top-level motion blur acceleration structure over moving instances
+ */
+
+class MotionInstanceAccel {
+  public:
+    /// MotionInstanceAccel public methods
+    MotionInstanceAccel(std::vector<MotionInstance> instances, float shutterOpen, float shutterClose,
+                        int maxPrimsInNode = 1);
+
+    Bounds3f WorldBound() const;
+    bool Intersect(const Ray& r, SurfaceInteraction* isect) const;
+    bool IntersectP(const Ray& r) const;
+
+    /// Compact closest hit, see BVHAccel::Intersect
+    bool Intersect(const Ray& r, HitRecord* hit) const;
+    void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const;
+
+  private:
+    /// MotionInstanceAccel private data
+    std::vector<MotionInstance> instances;
+    MotionBVH bvh;
+};
+
+/**
+ * \brief MotionBVH template methods
+ */
+
+template <typename F>
+inline bool MotionBVH::Intersect(const Ray& ray, F intersectPrimitive) const {
+    return Traverse<F, false>(ray, intersectPrimitive);
+}
+
+template <typename F>
+inline bool MotionBVH::IntersectP(const Ray& ray, F intersectPrimitive) const {
+    return Traverse<F, true>(ray, intersectPrimitive);
+}
+
+template <typename F, bool AnyHit>
+inline bool MotionBVH::Traverse(const Ray& ray, F intersectPrimitive) const {
+    if (nodes.empty()) {
+        return false;
+    }
+    bool hit = false;
+    Vec3f invDir(1 / ray.d.x, 1 / ray.d.y, 1 / ray.d.z);
+    int dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+
+    int toVisitOffset = 0, currentNodeIndex = 0;
+    int nodesToVisit[64];
+    while (true) {
+        const MotionBVHNode* node = &nodes[currentNodeIndex];
+
+        /// Interpolate node bounds at the ray time within the node's time range
+        float t = node->time1 > node->time0 ?
+            Clamp((ray.time - node->time0) / (node->time1 - node->time0), 0.0f, 1.0f) : 0.0f;
+        if (node->bounds.Interpolate(t).IntersectP(ray, invDir, dirIsNeg)) {
+            if (node->nPrimitives > 0) {
+                for (int i = 0; i < node->nPrimitives; ++i) {
+                    if (intersectPrimitive(primitiveIndices[node->primitivesOffset + i])) {
+                        if (AnyHit) {
+                            return true;
+                        }
+                        hit = true;
+                    }
+                }
+                if (toVisitOffset == 0) {
+                    break;
+                }
+                currentNodeIndex = nodesToVisit[--toVisitOffset];
+            } else if (node->temporalSplit) {
+                /// Only the child covering the ray time needs to be visited
+                if (ray.time < nodes[currentNodeIndex + 1].time1) {
+                    currentNodeIndex = currentNodeIndex + 1;
+                } else {
+                    currentNodeIndex = node->secondChildOffset;
+                }
+            } else {
+                /// Any hit traversal skips front to back ordering
+                if (!AnyHit and dirIsNeg[node->axis]) {
+                    nodesToVisit[toVisitOffset++] = currentNodeIndex + 1;
+                    currentNodeIndex = node->secondChildOffset;
+                } else {
+                    nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+                    currentNodeIndex = currentNodeIndex + 1;
+                }
+            }
+        } else {
+            if (toVisitOffset == 0) {
+                break;
+            }
+            currentNodeIndex = nodesToVisit[--toVisitOffset];
+        }
+    }
+    return hit;
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/traversal.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the thread pool every parallel stage of heimdall
+    runs on. Each thread owns a deque of tasks: it pushes and pops new
+    work at the back, while idle threads steal the oldest work from the
+    front of someone else's deque. Older tasks are the bigger halves of
+    recursively split loops, so one steal moves a lot of work.
+
+    A thread waiting on a TaskGroup runs queued tasks until the group is
+    done instead of blocking, so groups may be nested freely.
+ * =================================================================== */
+
+class TaskGroup;
+
+/**
+ * \brief Pool of worker threads with per-thread work stealing deques
+ */
+
+class ThreadPool {
+  public:
+    /// ThreadPool public methods
+    /// nThreads counts the calling thread, which works while it waits,
+    /// so nThreads - 1 workers are started. Zero uses every core.
+    explicit ThreadPool(int nThreads = 0, bool pinThreads = false);
+    ~ThreadPool();
+
+    int Size() const;
+
+    /// Run one queued task on the calling thread, returns false if
+    /// there was nothing to run
+    bool RunOne();
+
+  private:
+    friend class TaskGroup;
+
+    struct Task {
+        std::function<void()> func;
+        TaskGroup* group;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task*> tasks;
+    };
+
+    /// ThreadPool private data
+    std::vector<std::unique_ptr<WorkQueue>> queues;     /// Queue 0 belongs to threads outside the pool
+    std::vector<std::thread> threads;
+    std::atomic<int> nQueued;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool shutdown;
+
+    /// ThreadPool private methods
+    void Submit(Task* task);
+    Task* Pop(int queueIndex);
+    void WorkerLoop(int queueIndex, bool pin);
+};
+
+/**
+ * \brief Set of tasks that can be waited on together
+ */
+
+class TaskGroup {
+  public:
+    /// TaskGroup public methods
+    /// A null pool uses the global pool, see ParallelInit
+    explicit TaskGroup(ThreadPool* pool = nullptr);
+    ~TaskGroup();
+
+    /// Fork func, it may run on any thread of the pool
+    void Run(std::function<void()> func);
+
+    /// Join every task run so far, working on queued tasks meanwhile
+    void Wait();
+
+  private:
+    friend class ThreadPool;
+
+    /// TaskGroup private data
+    ThreadPool* pool;
+    std::atomic<int> pending;
+};
+
+/// Create the global pool. Without a call it is created with one thread
+/// per core on first use. pinThreads binds worker i to core i where the
+/// platform allows it.
+void ParallelInit(int nThreads = 0, bool pinThreads = false);
+void ParallelCleanup();
+ThreadPool* GlobalThreadPool();
+
+int NumSystemCores();
+
+/// Threads that can run parallel work, the calling thread included
+int MaxThreadIndex();
+
+/// Index of the calling thread in [0, MaxThreadIndex()), for per thread
+/// scratch data. Threads outside the pool all report 0.
+int ThreadIndex();
+
+/// Call func(i) for i in [0, count). The range is split in half
+/// recursively down to chunkSize indices, so stolen tasks stay large.
+void ParallelFor(int64_t count, const std::function<void(int64_t)>& func, int64_t chunkSize = 1);
+
+/// Call func(i) for i in [0, count), started in increasing order: every
+/// thread takes the next index from a shared counter. Work cut short
+/// has then done a prefix of the range, up to the indices in flight.
+void ParallelForInOrder(int64_t count, const std::function<void(int64_t)>& func);
+
+/// Call func(tile) for every tileSize square tile of bounds, clipped
+/// to bounds. Tiles are handed out in tileOrder, see TraversalOrder.
+void ParallelFor2D(const Bounds2i& bounds, int tileSize, const std::function<void(const Bounds2i&)>& func,
+                   TraversalOrder tileOrder = TraversalOrder::RowMajor);
+
+HEIMDALL_NAMESPACE_END
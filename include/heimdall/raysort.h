@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/interaction.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the ray reordering stage for incoherent
+    secondary rays. Rays in flight are batched and sorted by a key
+    made of their direction octant and a Morton code of their origin
+    within the scene bounds, so rays that start close together and
+    travel the same general way are traced one after another and
+    share the BVH nodes they fetch.
+ * =================================================================== */
+
+/// Sort key of a ray: direction octant in bits 27-29, then a Morton
+/// code of the origin quantized to 9 bits per axis within bounds
+uint32_t RaySortKey(const Ray& r, const Bounds3f& bounds);
+
+/// Permutation of rays ordered by RaySortKey, stable for equal keys
+void SortRays(const Ray* rays, int nRays, const Bounds3f& bounds, std::vector<int>* order);
+
+/// Trace a batch of rays in sorted order. hits are indexed like rays,
+/// so the reordering is invisible to the caller. Missed rays keep a
+/// primID of -1.
+template <typename Accel>
+void IntersectSorted(const Accel& accel, const std::vector<Ray>& rays, std::vector<HitRecord>* hits) {
+    std::vector<int> order;
+    SortRays(rays.data(), int(rays.size()), accel.WorldBound(), &order);
+    hits->assign(rays.size(), HitRecord());
+    for (int index : order) {
+        accel.Intersect(rays[index], &(*hits)[index]);
+    }
+}
+
+HEIMDALL_NAMESPACE_END
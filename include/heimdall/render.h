@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include "heimdall/common.h"
+#include "heimdall/camera.h"
+#include "heimdall/film.h"
+#include "heimdall/imageio.h"
+#include "heimdall/sampler.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the render loops. They drive the camera, the
+    sampler and the film over tiles of the image and leave shading to
+    a radiance function, so they work with any integrator.
+
+    The adaptive loop gives every tile a minimum number of samples and
+    then works in passes. After each pass the film's per pixel variance
+    estimates give every tile an error. Tiles under the noise threshold
+    stop, and the sample budget of the next pass goes to the remaining
+    tiles with the highest error first. Tiles whose pixels can no
+    longer change are streamed to the output writer while the rest of
+    the image is still rendering.
+
+    The progressive loop refines the whole image instead. A coarse
+    preview with one ray per block of pixels comes first, then every
+    pass doubles the samples per pixel, until a deadline, a noise
+    target or the sampler's sample count is reached. Tiles are handed
+    out from the center outwards, so when time runs out mid pass the
+    center of the frame is the part that got the extra samples.
+ * =================================================================== */
+
+/// Radiance arriving along a camera ray. The sampler is positioned at
+/// the first dimension after the camera sample. aov is nullptr unless
+/// the film stores AOVs, then the function fills in what the film's
+/// layout enables.
+typedef std::function<RGB(const RayDifferential& ray, Sampler& sampler, AOVSample* aov)> RadianceFunction;
+
+/**
+ * \brief Parameters of the adaptive render loop
+ */
+
+struct AdaptiveSettings {
+    int tileSize = 16;
+    int64_t minSamples = 16;            /// Samples per pixel before any tile may stop
+    int64_t samplesPerPass = 16;        /// Samples per pixel added to a tile per pass
+    int64_t sampleBudget = 0;           /// Camera samples over the whole image, 0 for no limit
+    float noiseThreshold = 0.01f;       /// Relative standard error at which a tile stops
+
+    /// Receives the pixels of every tile as soon as no tile left to
+    /// render can reach them through the filter, nullptr for none. A
+    /// writer with more than three channels gets the AOVs too.
+    TiledImageWriter* output = nullptr;
+};
+
+/**
+ * \brief Work done by a render loop
+ */
+
+struct RenderStats {
+    int64_t totalSamples = 0;
+    int passes = 0;
+    int tiles = 0;
+    int convergedTiles = 0;
+    bool timedOut = false;
+};
+
+/**
+ * \brief Parameters of the progressive render loop
+ */
+
+struct ProgressiveSettings {
+    int tileSize = 16;
+    int previewScale = 8;               /// Preview pixels are blocks of previewScale x previewScale
+    int64_t firstPassSamples = 1;       /// Samples per pixel of the first full pass
+    double timeLimit = 0.0;             /// Seconds of wall clock time, 0 for no limit
+    float noiseTarget = 0.0f;           /// Mean relative error to stop at, 0 for none
+
+    /// Called after every completed pass with the samples per pixel
+    /// every pixel has reached
+    std::function<void(int pass, int64_t samplesPerPixel)> onPass;
+};
+
+/// Render camera.film with at most sampler.samplesPerPixel samples per
+/// pixel, fewer where tiles converge or the budget runs out
+RenderStats RenderAdaptive(const Camera& camera, const Sampler& sampler, const RadianceFunction& Li,
+                           const AdaptiveSettings& settings);
+
+/**
+ * \brief Renders in passes of increasing quality until time runs out
+ */
+
+class ProgressiveRenderer {
+  public:
+    /// ProgressiveRenderer public methods
+    /// The sampler is cloned, the camera and its film must outlive the renderer
+    ProgressiveRenderer(const Camera& camera, const Sampler& sampler, const RadianceFunction& Li,
+                        const ProgressiveSettings& settings);
+
+    /// Run passes until a stopping condition holds
+    RenderStats Render();
+
+    /// Best image so far, the upscaled preview until the first full pass
+    /// is done. Safe to call from any thread while Render runs.
+    std::vector<RGB> GetImage() const;
+
+    /// Samples per pixel every pixel has reached
+    int64_t CompletedSamplesPerPixel() const;
+
+  private:
+    /// ProgressiveRenderer private data
+    const Camera& camera;
+    std::unique_ptr<Sampler> sampler;
+    const RadianceFunction Li;
+    const ProgressiveSettings settings;
+    Point2i previewResolution;
+    std::vector<RGB> preview;
+    std::atomic<bool> previewReady;
+    std::atomic<int64_t> completedSamples;
+
+    /// ProgressiveRenderer private methods
+    void RenderPreview();
+};
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/lowdiscrepancy.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the random number generators. Nothing random in
+    heimdall depends on which thread or machine computes it: streams
+    are selected by pixel, sample index and dimension, never by thread
+    or by the order work happened to run in.
+
+    RNG is PCG32, a small sequential generator with 2^63 streams and
+    O(log n) skip ahead. CounterRNG has no state at all: value i of a
+    pixel sample is a hash of the sample and i, so any range of values
+    can be filled at once, one independent lane per value.
+ * =================================================================== */
+
+/// PCG32 parameters
+static const uint64_t pcg32DefaultState = 0x853c49e6748fea9bull;
+static const uint64_t pcg32DefaultStream = 0xda3e39cb94b95bdbull;
+static const uint64_t pcg32Mult = 0x5851f42d4c957f2dull;
+
+/**
+ * \brief PCG32 random number generator
+ */
+
+class RNG {
+  public:
+    /// RNG public methods
+    RNG() : state(pcg32DefaultState), inc(pcg32DefaultStream) {}
+
+    explicit RNG(uint64_t sequenceIndex) {
+        SetSequence(sequenceIndex);
+    }
+
+    /// Restart at the beginning of stream sequenceIndex
+    void SetSequence(uint64_t sequenceIndex) {
+        state = 0u;
+        inc = (sequenceIndex << 1u) | 1u;
+        UniformUInt32();
+        state += pcg32DefaultState;
+        UniformUInt32();
+    }
+
+    /// Stream of pixel p positioned at value dimension of sample
+    /// sampleIndex, 2^16 values apart per sample
+    void SetPixelSample(const Point2i& p, int64_t sampleIndex, int dimension, uint64_t seed = 0) {
+        SetSequence(HashPixel(p, 0, seed));
+        Advance(sampleIndex * 65536ll + dimension);
+    }
+
+    uint32_t UniformUInt32() {
+        uint64_t oldState = state;
+        state = oldState * pcg32Mult + inc;
+        uint32_t xorShifted = uint32_t(((oldState >> 18u) ^ oldState) >> 27u);
+        uint32_t rot = uint32_t(oldState >> 59u);
+        return (xorShifted >> rot) | (xorShifted << ((~rot + 1u) & 31));
+    }
+
+    /// Uniform in [0, b) without modulo bias
+    uint32_t UniformUInt32(uint32_t b) {
+        uint32_t threshold = (~b + 1u) % b;
+        while (true) {
+            uint32_t r = UniformUInt32();
+            if (r >= threshold) {
+                return r % b;
+            }
+        }
+    }
+
+    float UniformFloat() {
+        return BitsToFloat01(UniformUInt32());
+    }
+
+    /// Skip delta values ahead, or back for negative delta
+    void Advance(int64_t delta) {
+        uint64_t curMult = pcg32Mult, curPlus = inc, accMult = 1u, accPlus = 0u;
+        uint64_t d = uint64_t(delta);
+        while (d > 0) {
+            if (d & 1) {
+                accMult *= curMult;
+                accPlus = accPlus * curMult + curPlus;
+            }
+            curPlus = (curMult + 1) * curPlus;
+            curMult *= curMult;
+            d /= 2;
+        }
+        state = accMult * state + accPlus;
+    }
+
+  private:
+    /// RNG private data
+    uint64_t state, inc;
+};
+
+/**
+ * \brief Stateless generator, value i of a pixel sample is a hash of i
+ */
+
+class CounterRNG {
+  public:
+    /// CounterRNG public methods
+    CounterRNG() : key(0) {}
+
+    CounterRNG(const Point2i& p, int64_t sampleIndex, uint64_t seed = 0)
+        : key(MixBits(HashPixel(p, 0, seed) ^ MixBits(uint64_t(sampleIndex)))) {}
+
+    uint32_t UniformUInt32(uint64_t counter) const {
+        return uint32_t(MixBits(key + counter * 0x9e3779b97f4a7c15ull) >> 32);
+    }
+
+    float UniformFloat(uint64_t counter) const {
+        return BitsToFloat01(UniformUInt32(counter));
+    }
+
+    /// Values firstCounter up to firstCounter + n. Lanes do not depend on
+    /// each other, so the loop vectorizes.
+    void FillUniform(uint64_t firstCounter, int n, float* values) const {
+        for (int i = 0; i < n; ++i) {
+            values[i] = UniformFloat(firstCounter + uint64_t(i));
+        }
+    }
+
+  private:
+    /// CounterRNG private data
+    uint64_t key;
+};
+
+HEIMDALL_NAMESPACE_END
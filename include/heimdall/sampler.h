@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/camera.h"
+#include "heimdall/rng.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the samplers. A sampler is addressed by pixel,
+    sample index and dimension, so any sample of any pixel can be drawn
+    directly, in any order and on any thread, and comes out the same.
+    Each thread renders with its own Clone.
+
+    Dimensions 0 and 1 are the position on the film and dimension 2 is
+    the shutter time. The tile methods draw one sample of every pixel
+    of a tile at once, which is how the camera consumes them.
+ * =================================================================== */
+
+/**
+ * \brief Sampler base class
+ */
+
+class Sampler {
+  public:
+    /// Sampler public data
+    const int64_t samplesPerPixel;
+
+    /// Sampler public methods
+    explicit Sampler(int64_t samplesPerPixel);
+    virtual ~Sampler();
+    virtual std::unique_ptr<Sampler> Clone() const = 0;
+
+    /// Following Get1D and Get2D calls draw sample sampleIndex of pixel p,
+    /// starting at dimension
+    virtual void StartPixelSample(const Point2i& p, int64_t sampleIndex, int dimension = 0);
+    virtual float Get1D() = 0;
+    virtual Point2f Get2D() = 0;
+
+    /// Film position and shutter time of the current sample of pixel
+    CameraSample GetCameraSample(const Point2i& pPixel);
+
+    /// Dimension, or dimensions dimension and dimension + 1, of sample
+    /// sampleIndex of every pixel of tile, row major
+    virtual void Get1DTile(const Bounds2i& tile, int64_t sampleIndex, int dimension, float* samples);
+    virtual void Get2DTile(const Bounds2i& tile, int64_t sampleIndex, int dimension, Point2f* samples);
+
+    /// Camera samples of sample sampleIndex of every pixel of tile
+    void GetCameraSamples(const Bounds2i& tile, int64_t sampleIndex, CameraSample* samples);
+
+  protected:
+    /// Sampler protected data
+    Point2i pixel;
+    int64_t sampleIndex;
+    int dimension;
+
+  private:
+    /// Sampler private data
+    std::vector<Point2f> tileScratch;
+    std::vector<float> timeScratch;
+};
+
+/**
+ * \brief Uniform random samples, for reference and debugging
+ */
+
+class IndependentSampler final : public Sampler {
+  public:
+    /// IndependentSampler public methods
+    IndependentSampler(int64_t samplesPerPixel, uint64_t seed = 0);
+    std::unique_ptr<Sampler> Clone() const;
+
+    void StartPixelSample(const Point2i& p, int64_t sampleIndex, int dimension = 0);
+    float Get1D();
+    Point2f Get2D();
+
+    void Get1DTile(const Bounds2i& tile, int64_t sampleIndex, int dimension, float* samples);
+
+  private:
+    /// IndependentSampler private data
+    const uint64_t seed;
+    CounterRNG rng;
+};
+
+/**
+ * \brief Owen scrambled Sobol sequence, scrambled per pixel
+ */
+
+class SobolSampler final : public Sampler {
+  public:
+    /// SobolSampler public methods
+    SobolSampler(int64_t samplesPerPixel, uint64_t seed = 0);
+    std::unique_ptr<Sampler> Clone() const;
+
+    float Get1D();
+    Point2f Get2D();
+
+    void Get1DTile(const Bounds2i& tile, int64_t sampleIndex, int dimension, float* samples);
+    void Get2DTile(const Bounds2i& tile, int64_t sampleIndex, int dimension, Point2f* samples);
+
+  private:
+    /// SobolSampler private data
+    const uint64_t seed;
+};
+
+/**
+ * \brief Halton sequence over the whole image with permuted digits
+ */
+
+class HaltonSampler final : public Sampler {
+  public:
+    /// HaltonSampler public methods
+    /// The first two dimensions are spread over sampleBounds so that
+    /// every pixel gets its own subsequence of one global sequence
+    HaltonSampler(int64_t samplesPerPixel, const Bounds2i& sampleBounds);
+    std::unique_ptr<Sampler> Clone() const;
+
+    void StartPixelSample(const Point2i& p, int64_t sampleIndex, int dimension = 0);
+    float Get1D();
+    Point2f Get2D();
+
+  private:
+    /// HaltonSampler private data
+    Point2i baseScales, baseExponents;
+    int64_t sampleStride;
+    int64_t multInverse[2];
+    Point2i pixelForOffset;
+    int64_t offsetForCurrentPixel;
+    uint64_t haltonIndex;
+
+    /// HaltonSampler private methods
+    float SampleDimension(int dim) const;
+};
+
+/**
+ * \brief Progressive multi-jittered (0, 2) tables, randomized per pixel
+ */
+
+class PMJ02Sampler final : public Sampler {
+  public:
+    /// PMJ02Sampler public methods
+    PMJ02Sampler(int64_t samplesPerPixel, uint64_t seed = 0);
+    std::unique_ptr<Sampler> Clone() const;
+
+    float Get1D();
+    Point2f Get2D();
+
+    void Get2DTile(const Bounds2i& tile, int64_t sampleIndex, int dimension, Point2f* samples);
+
+  private:
+    /// PMJ02Sampler private data
+    const uint64_t seed;
+
+    /// PMJ02Sampler private methods
+    Point2f Sample(const Point2i& p, int64_t index, int dim) const;
+};
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <memory>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/transform.h"
+#include "heimdall/interaction.h"
+#include "heimdall/shape.h"
+#include "heimdall/bvh.h"
+#include "heimdall/instance.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the public intersection API of heimdall_core.
+    A Scene collects geometries (sets of shapes) and instances of
+    them, and Commit builds one bottom-level BVH per geometry and a
+    top-level BVH over the instances. A committed scene answers
+    closest hit and occlusion queries for single rays, fixed width
+    packets and ray streams of any length. Queries are const and may
+    run concurrently from any number of threads; adding geometry or
+    committing must not overlap with queries.
+ * =================================================================== */
+
+/// Per-stream hint about the rays in a stream
+enum class StreamFlags {
+    Incoherent,     /// Unrelated rays, sorted for coherence before traversal
+    Coherent        /// Rays already in a good order, e.g. camera rays by pixel
+};
+
+/**
+ * \brief Scene of instanced geometry with committed acceleration structures
+ */
+
+class Scene {
+  public:
+    /// Scene public methods
+    Scene();
+
+    /// Add a set of shapes as a geometry, returns its geomID
+    int AddGeometry(std::vector<std::shared_ptr<Shape>> shapes);
+
+    /// Place a geometry in the world, returns the instanceID reported by
+    /// hits or -1 for an unknown geomID
+    int AddInstance(int geomID, const Transform& InstanceToWorld = Transform());
+
+    /// Build acceleration structures for everything added so far
+    void Commit(int maxPrimsInNode = 4, SplitMethod splitMethod = SplitMethod::SAH);
+
+    bool Committed() const;
+    Bounds3f WorldBound() const;
+    int GeometryOf(int instanceID) const;
+
+    /// Single ray queries. Closest hit shrinks r.tMax, occlusion never
+    /// builds any interaction data.
+    bool Intersect1(const Ray& r, HitRecord* hit) const;
+    bool Occluded1(const Ray& r) const;
+
+    /// Fixed width packets, only rays with a nonzero valid entry are
+    /// traced. Missed rays keep a primID of -1.
+    void Intersect4(const int* valid, const Ray* rays, HitRecord* hits) const;
+    void Intersect8(const int* valid, const Ray* rays, HitRecord* hits) const;
+    void Intersect16(const int* valid, const Ray* rays, HitRecord* hits) const;
+    void Occluded4(const int* valid, const Ray* rays, bool* occluded) const;
+    void Occluded8(const int* valid, const Ray* rays, bool* occluded) const;
+    void Occluded16(const int* valid, const Ray* rays, bool* occluded) const;
+
+    /// Streams of any length, results are indexed like rays
+    void IntersectStream(const Ray* rays, int nRays, HitRecord* hits,
+                         StreamFlags flags = StreamFlags::Incoherent) const;
+    void OccludedStream(const Ray* rays, int nRays, bool* occluded,
+                        StreamFlags flags = StreamFlags::Incoherent) const;
+
+    /// Full interaction for a hit reported along r
+    void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const;
+
+  private:
+    /// Scene private data
+    std::vector<std::vector<std::shared_ptr<Shape>>> geometries;
+    std::vector<std::pair<int, Transform>> instanceDescs;
+    std::vector<int> instanceGeometry;
+    std::unique_ptr<InstanceAccel> accel;
+
+    /// Scene private methods
+    template <int N>
+    void IntersectPacket(const int* valid, const Ray* rays, HitRecord* hits) const;
+    template <int N>
+    void OccludedPacket(const int* valid, const Ray* rays, bool* occluded) const;
+};
+
+HEIMDALL_NAMESPACE_END
@@ -27,6 +27,13 @@ class Shape {
     
     virtual bool Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool testSurfaceAlpha = true) const = 0;
     virtual bool IntersectTest(const Ray& r, bool testSurfaceAlpha = true) const = 0;
+
+    /// Closest hit as a compact record, only t and uv are written and
+    /// only on a hit. The default falls back on Intersect.
+    virtual bool IntersectHit(const Ray& r, HitRecord* hit, bool testSurfaceAlpha = true) const;
+
+    /// Full interaction for a hit reported by IntersectHit along r
+    virtual void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const;
     virtual float Area() const = 0;
 };
 
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/bvh.h"
+#include "heimdall/sphere.h"
+#include "heimdall/triangle.h"
+#include "heimdall/compressedmesh.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains a devirtualized alternative to BVHAccel. Shapes
+    are stored by value in one contiguous array per type and numbered
+    type by type, so the type of a primitive follows from its index.
+    BVH leaves dispatch on that tag to the shape's inline kernel
+    instead of making a virtual call on a scattered heap object.
+
+    Compressed meshes are stored whole and every one of their triangles
+    is a primitive, found from its number by the first primitive of
+    each mesh, so large meshes cost no memory per triangle beyond their
+    compressed buffers and the BVH.
+ * =================================================================== */
+
+/// Shape types with a typed array, in primitive numbering order
+enum class ShapeType { Sphere, Triangle, CompressedTriangle };
+
+/**
+ * \brief Shapes grouped by concrete type
+ */
+
+struct ShapeArrays {
+    /// ShapeArrays public data
+    std::vector<Sphere> spheres;
+    std::vector<Triangle> triangles;
+    std::vector<CompressedMeshShape> compressedMeshes;
+
+    /// ShapeArrays public methods
+    /// Compress a triangle mesh and add every one of its triangles
+    void AddCompressedMesh(const Transform* ObjectToWorld, const Transform* WorldToObject,
+                           bool reverseOrientation, int nTriangles, const int* vertexIndices, int nVertices,
+                           const Point3f* P, const Normal3f* N = nullptr, const Point2f* UV = nullptr);
+
+    size_t size() const {
+        size_t n = spheres.size() + triangles.size();
+        for (const CompressedMeshShape& mesh : compressedMeshes) {
+            n += size_t(mesh.mesh->nTriangles);
+        }
+        return n;
+    }
+};
+
+/**
+ * \brief Bottom-level acceleration structure over typed shape arrays
+ */
+
+class ShapeArrayAccel {
+  public:
+    /// ShapeArrayAccel public methods
+    ShapeArrayAccel(ShapeArrays shapes, int maxPrimsInNode = 1, SplitMethod splitMethod = SplitMethod::SAH);
+
+    Bounds3f WorldBound() const;
+    bool Intersect(const Ray& r, SurfaceInteraction* isect) const;
+    bool IntersectP(const Ray& r) const;
+
+    /// Shadow ray towards light, testing the light's last occluder first
+    bool IntersectP(const Ray& r, OcclusionCache* cache, int light) const;
+
+    /// Compact closest hit, see BVHAccel::Intersect
+    bool Intersect(const Ray& r, HitRecord* hit) const;
+    void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const;
+
+    /// Shape behind a primitive number
+    const Shape* GetShape(int primID) const;
+
+    /// Refresh the hierarchy after the shapes moved in place
+    BVHUpdate Update(float rebuildThreshold = 1.5f);
+
+    /// Bytes held by the shapes, compressed buffers and BVH together. The
+    /// TriangleMesh buffers full precision triangles share are not counted.
+    size_t MemoryBytes() const;
+
+  private:
+    /// ShapeArrayAccel private data
+    ShapeArrays shapes;
+    int triangleOffset, compressedOffset;
+    int nPrimitives;
+    std::vector<int> meshOffsets;       /// First compressed primitive of each mesh
+    BVH bvh;
+
+    /// ShapeArrayAccel private methods
+    bool Occludes(const Ray& r, int primID) const;
+    Bounds3f PrimitiveBounds(int primID) const;
+
+    /// Mesh of a compressed primitive, and its triangle number in there
+    const CompressedMeshShape& CompressedMesh(int index, int* triNumber) const {
+        int mesh = int(std::upper_bound(meshOffsets.begin(), meshOffsets.end(), index) - meshOffsets.begin()) - 1;
+        *triNumber = index - meshOffsets[mesh];
+        return shapes.compressedMeshes[mesh];
+    }
+
+    /// Type of a primitive, index is its number among that type
+    ShapeType Tag(int primID, int* index) const {
+        if (primID < triangleOffset) {
+            *index = primID;
+            return ShapeType::Sphere;
+        }
+        if (primID < compressedOffset) {
+            *index = primID - triangleOffset;
+            return ShapeType::Triangle;
+        }
+        *index = primID - compressedOffset;
+        return ShapeType::CompressedTriangle;
+    }
+};
+
+HEIMDALL_NAMESPACE_END
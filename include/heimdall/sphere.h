@@ -0,0 +1,83 @@
+#pragma once
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/transform.h"
+#include "heimdall/interaction.h"
+#include "heimdall/shape.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief Full sphere centered at the object space origin
+ */
+
+class Sphere final : public Shape {
+  public:
+    /// Sphere public methods
+    Sphere(const Transform* ObjectToWorld, const Transform* WorldToObject, bool reverseOrientation,
+           float radius);
+
+    Bounds3f ObjectBounds() const;
+    bool Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool testSurfaceAlpha = true) const;
+    bool IntersectTest(const Ray& r, bool testSurfaceAlpha = true) const;
+    float Area() const;
+
+    /// uv is left unset, it is recovered from the hit point on demand
+    inline bool IntersectHit(const Ray& r, HitRecord* hit, bool testSurfaceAlpha = true) const;
+    void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const;
+
+  private:
+    /// Sphere private data
+    float radius;
+
+    /// Sphere private methods
+    inline bool Hit(const Ray& ray, float* t) const;
+};
+
+/**
+ * \brief Sphere inline methods
+ */
+
+inline bool Sphere::IntersectHit(const Ray& r, HitRecord* hit, bool) const {
+    float t;
+    if (!Hit((*WorldToObject)(r), &t)) {
+        return false;
+    }
+    hit->t = t;
+    return true;
+}
+
+inline bool Sphere::Hit(const Ray& ray, float* t) const {
+    /// Solve the quadratic in the numerically stable form
+    Vec3f o(ray.o);
+    float a = Dot(ray.d, ray.d);
+    float b = 2.0f * Dot(ray.d, o);
+    float c = Dot(o, o) - radius * radius;
+    float disc = b * b - 4.0f * a * c;
+    if (disc < 0.0f) {
+        return false;
+    }
+    float root = std::sqrt(disc);
+    float q = b < 0.0f ? -0.5f * (b - root) : -0.5f * (b + root);
+    float t0 = q / a;
+    float t1 = c / q;
+    if (t0 > t1) {
+        std::swap(t0, t1);
+    }
+
+    /// Take the nearest root in (0, tMax]
+    if (t0 > ray.tMax or t1 <= 0.0f) {
+        return false;
+    }
+    *t = t0;
+    if (*t <= 0.0f) {
+        *t = t1;
+        if (*t > ray.tMax) {
+            return false;
+        }
+    }
+    return true;
+}
+
+HEIMDALL_NAMESPACE_END
@@ -45,6 +45,8 @@ class Transform {
 
     inline Bounds3f operator()(const Bounds3f& b) const;
 
+    SurfaceInteraction operator()(const SurfaceInteraction& si) const;
+
   private:
   	/// Transform private data
   	Matrix m, mInv;
@@ -59,6 +61,8 @@ Transform RotateY(float theta);
 Transform RotateZ(float theta);
 Transform Rotate(float theta, const Vec3f& axis);
 Transform LookAt(const Point3f& pos, const Point3f& look, const Vec3f& up);
+Transform Orthographic(float zNear, float zFar);
+Transform Perspective(float fov, float zNear, float zFar);
 
 /**
  * \breif Animated Transform 
@@ -72,6 +76,7 @@ class AnimatedTransform {
 
     void Decompose(const Matrix& mSRT, Vec3f* T, Quaternion* R, Matrix* S);
     void Interpolate(float time, Transform* t) const;
+    bool IsAnimated() const;
 
     Ray operator()(const Ray& r) const;
     RayDifferential operator()(const RayDifferential& r) const;
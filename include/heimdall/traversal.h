@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains the orders in which the points of a Bounds2i,
+    tiles of an image or pixels of a tile, can be visited. Row major is
+    what Bounds2iIterator does. Morton and Hilbert orders keep
+    consecutive points close in both directions, so consecutive camera
+    rays share BVH nodes and texels. Spiral order starts at the center
+    and works outwards, so previews show the interesting part first.
+
+    Morton and Hilbert curves cover power of two squares. Bounds are cut
+    into squares along their long side, sized by the short side, and
+    the curve of each square skips points outside the bounds. A walk
+    over the whole bounds takes fewer than four curve steps per point
+    visited, so fewer than three are wasted, the worst case being
+    bounds just past a power of two on both sides. The spiral wastes
+    no steps.
+ * =================================================================== */
+
+enum class TraversalOrder {
+    RowMajor,
+    Morton,
+    Hilbert,
+    Spiral
+};
+
+/**
+ * \brief Iterator over the points of a Bounds2i in a TraversalOrder
+ */
+
+class TraversalIterator: public std::forward_iterator_tag {
+  public:
+    /// TraversalIterator public methods
+    /// Iterator at the nth point of b, n equal to the area of b is the end
+    TraversalIterator(const Bounds2i& b, TraversalOrder order, int64_t n);
+
+    TraversalIterator operator++() {
+        if (++n < count) {
+            Iterate();
+        }
+        return *this;
+    }
+
+    TraversalIterator operator++(int) {
+        TraversalIterator old = *this;
+        ++*this;
+        return old;
+    }
+
+    /// Only iterators of the same traversal are comparable
+    bool operator==(const TraversalIterator& ti) const {
+        return n == ti.n;
+    }
+
+    bool operator!=(const TraversalIterator& ti) const {
+        return n != ti.n;
+    }
+
+    Point2i operator*() const {
+        return p;
+    }
+
+  private:
+    /// TraversalIterator private data
+    Bounds2i b;
+    TraversalOrder order;
+    int64_t n, count;
+    Point2i p;
+
+    /// Morton and Hilbert state: current square and curve index in it
+    int side, block;
+    bool blocksAlongX;
+    uint64_t d;
+
+    /// Spiral state: ring around the center, side of the ring and the
+    /// step along that side, clipped to [step, stepEnd)
+    Point2i center, sideStart;
+    Vec2i sideDir;
+    int ring, ringSide, step, stepEnd;
+
+    /// TraversalIterator private methods
+    void Iterate();
+    Point2i CurvePoint() const;
+    void NextSpiralSide();
+};
+
+/**
+ * \brief Points of a Bounds2i in a TraversalOrder, for range based loops
+ */
+
+class Traversal {
+  public:
+    /// Traversal public data
+    const Bounds2i bounds;
+    const TraversalOrder order;
+
+    /// Traversal public methods
+    Traversal(const Bounds2i& bounds, TraversalOrder order) : bounds(bounds), order(order) {}
+
+    TraversalIterator begin() const {
+        return TraversalIterator(bounds, order, 0);
+    }
+
+    TraversalIterator end() const {
+        return TraversalIterator(bounds, order, Count());
+    }
+
+    int64_t Count() const {
+        Vec2i extent = bounds.Diagonal();
+        return extent.x > 0 and extent.y > 0 ? int64_t(extent.x) * extent.y : 0;
+    }
+};
+
+/**
+ * \brief Traversal inline functions
+ */
+
+/// Keep the even bits of x, packed into the low half
+inline uint32_t CompactBits1By1(uint64_t x) {
+    x &= 0x5555555555555555ull;
+    x = (x | (x >> 1)) & 0x3333333333333333ull;
+    x = (x | (x >> 2)) & 0x0f0f0f0f0f0f0f0full;
+    x = (x | (x >> 4)) & 0x00ff00ff00ff00ffull;
+    x = (x | (x >> 8)) & 0x0000ffff0000ffffull;
+    x = (x | (x >> 16)) & 0x00000000ffffffffull;
+    return uint32_t(x);
+}
+
+/// Point at Morton index d, x in the even bits and y in the odd bits
+inline Point2i DecodeMorton2(uint64_t d) {
+    return Point2i(int(CompactBits1By1(d)), int(CompactBits1By1(d >> 1)));
+}
+
+/// Point at index d of the Hilbert curve over a side x side square, side
+/// a power of two. The curve starts at (0, 0) and ends at (side - 1, 0).
+inline Point2i DecodeHilbert2(int side, uint64_t d) {
+    int x = 0, y = 0;
+    for (int s = 1; s < side; s *= 2) {
+        int rx = int(1 & (d / 2));
+        int ry = int(1 & (d ^ rx));
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+        x += s * rx;
+        y += s * ry;
+        d /= 4;
+    }
+    return Point2i(x, y);
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <memory>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/transform.h"
+#include "heimdall/interaction.h"
+#include "heimdall/shape.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief Shared vertex data of a triangle mesh, stored in world space
+ */
+
+struct TriangleMesh {
+    /// TriangleMesh public data
+    const int nTriangles, nVertices;
+    std::vector<int> vertexIndices;
+    std::vector<Point3f> p;
+    std::vector<Normal3f> n;    /// Optional shading normals
+    std::vector<Point2f> uv;    /// Optional surface parameterization
+
+    /// TriangleMesh public methods
+    TriangleMesh(const Transform& ObjectToWorld, int nTriangles, const int* vertexIndices, int nVertices,
+                 const Point3f* P, const Normal3f* N, const Point2f* UV);
+};
+
+/**
+ * \brief Single triangle referencing its mesh
+ */
+
+class Triangle final : public Shape {
+  public:
+    /// Triangle public methods
+    Triangle(const Transform* ObjectToWorld, const Transform* WorldToObject, bool reverseOrientation,
+             const std::shared_ptr<const TriangleMesh>& mesh, int triNumber);
+
+    Bounds3f ObjectBounds() const;
+    Bounds3f WorldBounds() const;
+    bool Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool testSurfaceAlpha = true) const;
+    bool IntersectTest(const Ray& r, bool testSurfaceAlpha = true) const;
+    float Area() const;
+
+    /// uv holds the barycentrics of the second and third vertex
+    inline bool IntersectHit(const Ray& r, HitRecord* hit, bool testSurfaceAlpha = true) const;
+    void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const;
+
+  private:
+    /// Triangle private data
+    std::shared_ptr<const TriangleMesh> mesh;
+    const int* v;
+};
+
+/**
+ * \brief Every triangle of a mesh as one shape, for accels that address
+ * single triangles by number instead of storing a Triangle for each
+ */
+
+class TriangleMeshShape final : public Shape {
+  public:
+    /// TriangleMeshShape public data
+    std::shared_ptr<const TriangleMesh> mesh;
+
+    /// TriangleMeshShape public methods
+    TriangleMeshShape(const Transform* ObjectToWorld, const Transform* WorldToObject, bool reverseOrientation,
+                      std::shared_ptr<const TriangleMesh> mesh);
+
+    /// Whole mesh, the intersections test every triangle in turn and are
+    /// only meant for meshes used outside of an accel
+    Bounds3f ObjectBounds() const;
+    Bounds3f WorldBounds() const;
+    bool Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool testSurfaceAlpha = true) const;
+    bool IntersectTest(const Ray& r, bool testSurfaceAlpha = true) const;
+    float Area() const;
+    using Shape::IntersectHit;
+    using Shape::ComputeSurfaceInteraction;
+
+    /// Single triangle, uv holds the barycentrics of the second and third vertex
+    Bounds3f TriangleBounds(int triNumber) const;
+    inline bool IntersectHit(const Ray& r, int triNumber, HitRecord* hit) const;
+    void ComputeSurfaceInteraction(const Ray& r, int triNumber, const HitRecord& hit,
+                                   SurfaceInteraction* isect) const;
+};
+
+/// Moller-Trumbore against world space vertices, writes t and the
+/// barycentrics of p1 and p2 to hit
+inline bool IntersectTriangle(const Ray& r, const Point3f& p0, const Point3f& p1, const Point3f& p2,
+                              HitRecord* hit);
+
+/// Interaction at a triangle hit from decoded vertex data. n and uv
+/// point at three values each or are null when the mesh has none.
+void TriangleInteraction(const Shape* shape, const Ray& r, const HitRecord& hit, const Point3f p[3],
+                         const Normal3f* n, const Point2f* uv, SurfaceInteraction* isect);
+
+std::vector<std::shared_ptr<Shape>> CreateTriangleMesh(const Transform* ObjectToWorld,
+    const Transform* WorldToObject, bool reverseOrientation, int nTriangles, const int* vertexIndices,
+    int nVertices, const Point3f* P, const Normal3f* N = nullptr, const Point2f* UV = nullptr);
+
+/**
+ * \brief Triangle inline methods
+ */
+
+inline bool IntersectTriangle(const Ray& r, const Point3f& p0, const Point3f& p1, const Point3f& p2,
+                              HitRecord* hit) {
+    Vec3f e1 = p1 - p0;
+    Vec3f e2 = p2 - p0;
+    Vec3f pvec = Cross(r.d, e2);
+    float det = Dot(e1, pvec);
+    if (det == 0.0f) {
+        return false;
+    }
+    float invDet = 1.0f / det;
+    Vec3f tvec = r.o - p0;
+    float b1 = Dot(tvec, pvec) * invDet;
+    if (b1 < 0.0f or b1 > 1.0f) {
+        return false;
+    }
+    Vec3f qvec = Cross(tvec, e1);
+    float b2 = Dot(r.d, qvec) * invDet;
+    if (b2 < 0.0f or b1 + b2 > 1.0f) {
+        return false;
+    }
+    float t = Dot(e2, qvec) * invDet;
+    if (t <= 0.0f or t > r.tMax) {
+        return false;
+    }
+    hit->t = t;
+    hit->uv = Point2f(b1, b2);
+    return true;
+}
+
+inline bool Triangle::IntersectHit(const Ray& r, HitRecord* hit, bool) const {
+    return IntersectTriangle(r, mesh->p[v[0]], mesh->p[v[1]], mesh->p[v[2]], hit);
+}
+
+inline bool TriangleMeshShape::IntersectHit(const Ray& r, int triNumber, HitRecord* hit) const {
+    const int* v = &mesh->vertexIndices[3 * triNumber];
+    return IntersectTriangle(r, mesh->p[v[0]], mesh->p[v[1]], mesh->p[v[2]], hit);
+}
+
+HEIMDALL_NAMESPACE_END
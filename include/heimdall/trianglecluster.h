@@ -0,0 +1,117 @@
+#pragma once
+
+#include <memory>
+
+#include "heimdall/common.h"
+#include "heimdall/geometry.h"
+#include "heimdall/bvh.h"
+#include "heimdall/triangle.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/* ===================================================================
+    This file contains a bottom-level acceleration structure for a
+    single triangle mesh whose leaves hold the triangles themselves.
+    Each leaf points at clusters of up to eight triangles gathered in
+    structure of arrays layout, with the first vertex and both edges
+    precomputed, so a leaf visit is a few contiguous loads and one
+    fixed width kernel instead of a pointer chase per triangle. The
+    mesh keeps normals and uvs and is only read for the final hit,
+    through the triangle number, so no Triangle is stored per triangle.
+ * =================================================================== */
+
+/**
+ * \brief Up to clusterWidth triangles in structure of arrays layout.
+ * Unused lanes have zero edges, so they can never be hit.
+ */
+
+struct TriangleCluster {
+    /// Triangles per cluster, one kernel lane each
+    static const int clusterWidth = 8;
+
+    /// TriangleCluster public data
+    float p0x[clusterWidth], p0y[clusterWidth], p0z[clusterWidth];
+    float e1x[clusterWidth], e1y[clusterWidth], e1z[clusterWidth];
+    float e2x[clusterWidth], e2y[clusterWidth], e2z[clusterWidth];
+    int primID[clusterWidth];
+
+    /// TriangleCluster public methods
+    TriangleCluster();
+
+    /// Test every lane at once, returns the lane of the closest hit
+    /// within r.tMax or -1, writing its t and barycentrics to hit
+    inline int Intersect(const Ray& r, HitRecord* hit) const;
+};
+
+/**
+ * \brief Bottom-level acceleration structure over one triangle mesh
+ */
+
+class TriangleClusterAccel {
+  public:
+    /// TriangleClusterAccel public methods
+    TriangleClusterAccel(const Transform* ObjectToWorld, const Transform* WorldToObject, bool reverseOrientation,
+                         std::shared_ptr<const TriangleMesh> mesh, SplitMethod splitMethod = SplitMethod::SAH);
+
+    Bounds3f WorldBound() const;
+    bool Intersect(const Ray& r, SurfaceInteraction* isect) const;
+    bool IntersectP(const Ray& r) const;
+
+    /// Compact closest hit, primID is the triangle number in the mesh
+    bool Intersect(const Ray& r, HitRecord* hit) const;
+    void ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const;
+
+    int ClusterCount() const;
+
+  private:
+    /// TriangleClusterAccel private data
+    TriangleMeshShape shape;                /// Only touched for shading
+    std::vector<TriangleCluster> clusters;
+    std::vector<int> leafClusters;          /// First cluster of the leaf at each primitive offset
+    BVH bvh;
+};
+
+/**
+ * \brief TriangleCluster inline methods
+ */
+
+inline int TriangleCluster::Intersect(const Ray& r, HitRecord* hit) const {
+    /// Moller-Trumbore in every lane without branches, so the loop vectorizes
+    float tLane[clusterWidth], b1Lane[clusterWidth], b2Lane[clusterWidth];
+    for (int i = 0; i < clusterWidth; ++i) {
+        float pvx = r.d.y * e2z[i] - r.d.z * e2y[i];
+        float pvy = r.d.z * e2x[i] - r.d.x * e2z[i];
+        float pvz = r.d.x * e2y[i] - r.d.y * e2x[i];
+        float det = e1x[i] * pvx + e1y[i] * pvy + e1z[i] * pvz;
+        float invDet = 1.0f / det;
+        float tvx = r.o.x - p0x[i], tvy = r.o.y - p0y[i], tvz = r.o.z - p0z[i];
+        float b1 = (tvx * pvx + tvy * pvy + tvz * pvz) * invDet;
+        float qvx = tvy * e1z[i] - tvz * e1y[i];
+        float qvy = tvz * e1x[i] - tvx * e1z[i];
+        float qvz = tvx * e1y[i] - tvy * e1x[i];
+        float b2 = (r.d.x * qvx + r.d.y * qvy + r.d.z * qvz) * invDet;
+        float t = (e2x[i] * qvx + e2y[i] * qvy + e2z[i] * qvz) * invDet;
+        bool valid = det != 0.0f and b1 >= 0.0f and b1 <= 1.0f and b2 >= 0.0f and b1 + b2 <= 1.0f and
+            t > 0.0f and t <= r.tMax;
+        tLane[i] = valid ? t : INFINITY;
+        b1Lane[i] = b1;
+        b2Lane[i] = b2;
+    }
+
+    /// Later lanes win ties, as they would in a per triangle loop
+    int closest = -1;
+    float tClosest = INFINITY;
+    for (int i = 0; i < clusterWidth; ++i) {
+        if (tLane[i] != INFINITY and tLane[i] <= tClosest) {
+            closest = i;
+            tClosest = tLane[i];
+        }
+    }
+    if (closest >= 0) {
+        hit->t = tClosest;
+        hit->uv = Point2f(b1Lane[closest], b2Lane[closest]);
+    }
+    return closest;
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,168 @@
+#include "heimdall/aov.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// AOV pixel layout
+static const int aovSampleCountOffset = 0;      /// Every sample in the pixel
+static const int aovHitCountOffset = 1;         /// Samples that hit a surface
+static const int aovCountFloats = 2;
+
+/**
+ * \brief AOVSample method definitions
+ */
+
+AOVSample::AOVSample(const AOVLayout& layout) : layout(layout), lightContributions(layout.nLights) {}
+
+void AOVSample::Reset() {
+    hit = false;
+    std::fill(lightContributions.begin(), lightContributions.end(), RGB());
+}
+
+void AOVSample::SetHit(const Ray& ray, const SurfaceInteraction& isect) {
+    hit = true;
+    if (layout.Enabled(AOVDepth)) {
+        depth = Distance(ray.o, isect.p);
+    }
+    if (layout.Enabled(AOVNormal)) {
+        n = isect.Shading().n;
+    }
+    if (layout.Enabled(AOVObjectID)) {
+        instanceID = isect.instanceID;
+    }
+}
+
+/**
+ * \brief AOVLayout method definitions
+ */
+
+template <uint32_t Aovs>
+void AOVLayout::AccumulateAOVs(const AOVLayout& layout, float* pixel, const AOVSample& sample) {
+    pixel[aovSampleCountOffset] += 1.0f;
+    if (Aovs & AOVLights) {
+        float* lights = pixel + layout.lightsOffset;
+        for (int i = 0; i < layout.nLights; ++i) {
+            lights[3 * i + 0] += sample.lightContributions[i].x;
+            lights[3 * i + 1] += sample.lightContributions[i].y;
+            lights[3 * i + 2] += sample.lightContributions[i].z;
+        }
+    }
+    if (!sample.hit) {
+        return;
+    }
+
+    pixel[aovHitCountOffset] += 1.0f;
+    if (Aovs & AOVDepth) {
+        pixel[layout.depthOffset] += sample.depth;
+    }
+    if (Aovs & AOVNormal) {
+        pixel[layout.normalOffset + 0] += sample.n.x;
+        pixel[layout.normalOffset + 1] += sample.n.y;
+        pixel[layout.normalOffset + 2] += sample.n.z;
+    }
+    if (Aovs & AOVAlbedo) {
+        pixel[layout.albedoOffset + 0] += sample.albedo.x;
+        pixel[layout.albedoOffset + 1] += sample.albedo.y;
+        pixel[layout.albedoOffset + 2] += sample.albedo.z;
+    }
+    if (Aovs & AOVObjectID) {
+        /// Stored off by one so that zero means no hit yet
+        if (pixel[layout.objectIDOffset] == 0.0f) {
+            pixel[layout.objectIDOffset] = float(sample.instanceID + 1);
+        }
+    }
+}
+
+AOVLayout::AOVLayout(uint32_t aovs, int nLights)
+    : aovs(aovs & AOVAll), nLights((aovs & AOVLights) ? std::max(0, nLights) : 0), nFloats(0), nChannels(0),
+      depthOffset(-1), normalOffset(-1), albedoOffset(-1), objectIDOffset(-1), lightsOffset(-1) {
+    if (this->aovs == 0) {
+        accumulate = &AccumulateAOVs<0>;
+        return;
+    }
+
+    /// Only enabled AOVs get floats, in channel order after the counts
+    int offset = aovCountFloats;
+    auto place = [&](uint32_t aov, int size, int* aovOffset) {
+        if (Enabled(aov)) {
+            *aovOffset = offset;
+            offset += size;
+        }
+    };
+    place(AOVDepth, 1, &depthOffset);
+    place(AOVNormal, 3, &normalOffset);
+    place(AOVAlbedo, 3, &albedoOffset);
+    place(AOVObjectID, 1, &objectIDOffset);
+    place(AOVLights, 3 * this->nLights, &lightsOffset);
+    nFloats = offset;
+    nChannels = offset - aovCountFloats;
+
+    /// One instantiation per combination of AOVs, indexed by the bits
+    static const AccumulateFunction table[] = {
+        &AccumulateAOVs<0>,  &AccumulateAOVs<1>,  &AccumulateAOVs<2>,  &AccumulateAOVs<3>,
+        &AccumulateAOVs<4>,  &AccumulateAOVs<5>,  &AccumulateAOVs<6>,  &AccumulateAOVs<7>,
+        &AccumulateAOVs<8>,  &AccumulateAOVs<9>,  &AccumulateAOVs<10>, &AccumulateAOVs<11>,
+        &AccumulateAOVs<12>, &AccumulateAOVs<13>, &AccumulateAOVs<14>, &AccumulateAOVs<15>,
+        &AccumulateAOVs<16>, &AccumulateAOVs<17>, &AccumulateAOVs<18>, &AccumulateAOVs<19>,
+        &AccumulateAOVs<20>, &AccumulateAOVs<21>, &AccumulateAOVs<22>, &AccumulateAOVs<23>,
+        &AccumulateAOVs<24>, &AccumulateAOVs<25>, &AccumulateAOVs<26>, &AccumulateAOVs<27>,
+        &AccumulateAOVs<28>, &AccumulateAOVs<29>, &AccumulateAOVs<30>, &AccumulateAOVs<31>,
+    };
+    accumulate = table[this->aovs];
+}
+
+std::vector<std::string> AOVLayout::ChannelNames() const {
+    std::vector<std::string> names;
+    if (Enabled(AOVDepth)) {
+        names.push_back("Z");
+    }
+    if (Enabled(AOVNormal)) {
+        names.insert(names.end(), {"N.X", "N.Y", "N.Z"});
+    }
+    if (Enabled(AOVAlbedo)) {
+        names.insert(names.end(), {"albedo.R", "albedo.G", "albedo.B"});
+    }
+    if (Enabled(AOVObjectID)) {
+        names.push_back("objectID");
+    }
+    for (int i = 0; i < nLights; ++i) {
+        std::string light = "light" + std::to_string(i);
+        names.insert(names.end(), {light + ".R", light + ".G", light + ".B"});
+    }
+    return names;
+}
+
+void AOVLayout::Merge(float* dst, const float* src) const {
+    for (int i = 0; i < nFloats; ++i) {
+        if (i == objectIDOffset) {
+            /// The samples already in dst came first
+            if (dst[i] == 0.0f) {
+                dst[i] = src[i];
+            }
+        } else {
+            dst[i] += src[i];
+        }
+    }
+}
+
+void AOVLayout::Resolve(const float* pixel, float* values) const {
+    float invSamples = pixel[aovSampleCountOffset] > 0.0f ? 1.0f / pixel[aovSampleCountOffset] : 0.0f;
+    float invHits = pixel[aovHitCountOffset] > 0.0f ? 1.0f / pixel[aovHitCountOffset] : 0.0f;
+    for (int i = aovCountFloats; i < nFloats; ++i) {
+        values[i - aovCountFloats] = pixel[i] * (i >= lightsOffset and lightsOffset >= 0 ? invSamples : invHits);
+    }
+    if (normalOffset >= 0 and pixel[aovHitCountOffset] > 0.0f) {
+        float* n = values + normalOffset - aovCountFloats;
+        Normal3f mean = Normal3f(n[0], n[1], n[2]);
+        if (mean.x != 0.0f or mean.y != 0.0f or mean.z != 0.0f) {
+            mean = Normalize(mean);
+        }
+        n[0] = mean.x;
+        n[1] = mean.y;
+        n[2] = mean.z;
+    }
+    if (objectIDOffset >= 0) {
+        values[objectIDOffset - aovCountFloats] = pixel[objectIDOffset] - 1.0f;
+    }
+}
+
+HEIMDALL_NAMESPACE_END
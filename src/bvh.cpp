@@ -0,0 +1,813 @@
+#include "heimdall/bvh.h"
+#include "heimdall/bvhcache.h"
+#include "heimdall/parallel.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief BVH method definitions
+ */
+
+/// Spatial split build parameters
+static const int nSpatialBins = 32;
+static const float spatialSplitAlpha = 1e-5f;   /// Child overlap, relative to the root, before spatial splits are tried
+static const float maxDuplication = 0.3f;       /// Extra references allowed, relative to the primitive count
+static const int maxSpatialSplitDepth = 48;     /// Keeps the tree within the traversal stack
+
+BVH::BVH(std::vector<BVHPrimitiveInfo> primitiveInfo, int maxPrimsInNode, SplitMethod splitMethod,
+        ClipFunction clipPrimitive)
+    : maxPrimsInNode(std::min(255, maxPrimsInNode)), splitMethod(splitMethod),
+      clipPrimitive(std::move(clipPrimitive)) {
+    if (primitiveInfo.empty()) {
+        return;
+    }
+
+    if (splitMethod != SplitMethod::SBVH) {
+        /// A binary tree with n leaves never has more than 2n - 1 nodes
+        nodes.reserve(2 * primitiveInfo.size() - 1);
+        primitiveIndices.reserve(primitiveInfo.size());
+        RecursiveBuild(primitiveInfo, 0, int(primitiveInfo.size()));
+        nodes.shrink_to_fit();
+        buildCost = SubtreeCosts();
+        return;
+    }
+
+    /// Keep the unclipped primitive bounds around for the refit baseline
+    size_t maxPrimitive = 0;
+    for (const BVHPrimitiveInfo& info : primitiveInfo) {
+        maxPrimitive = std::max(maxPrimitive, info.primitiveNumber);
+    }
+    std::vector<Bounds3f> primitiveBounds(maxPrimitive + 1);
+    Bounds3f rootBounds;
+    for (const BVHPrimitiveInfo& info : primitiveInfo) {
+        primitiveBounds[info.primitiveNumber] = info.bounds;
+        rootBounds = Union(rootBounds, info.bounds);
+    }
+
+    int duplicationBudget = int(maxDuplication * primitiveInfo.size());
+    nodes.reserve(2 * (primitiveInfo.size() + duplicationBudget) - 1);
+    primitiveIndices.reserve(primitiveInfo.size() + duplicationBudget);
+    RecursiveBuildSpatial(primitiveInfo, rootBounds.SurfaceArea(), &duplicationBudget, 0);
+    nodes.shrink_to_fit();
+    primitiveIndices.shrink_to_fit();
+
+    /// A refit only sees whole primitive bounds, so measure later
+    /// degradation against the tree refit that way instead of the clipped one
+    std::vector<LinearBVHNode> clipped = nodes;
+    Refit(primitiveBounds);
+    buildCost = SubtreeCosts();
+    nodes.swap(clipped);
+}
+
+Bounds3f BVH::WorldBound() const {
+    return Empty() ? Bounds3f() : Nodes()[0].bounds;
+}
+
+void BVH::Detach() {
+    /// Copy a mapped tree into owned storage before it is first modified
+    if (mapping) {
+        nodes.assign(mappedNodes, mappedNodes + nMappedNodes);
+        primitiveIndices.assign(mappedIndices, mappedIndices + nMappedIndices);
+        buildCost.assign(mappedCost, mappedCost + nMappedNodes);
+        mapping.reset();
+    }
+}
+
+int BVH::CreateLeaf(const std::vector<BVHPrimitiveInfo>& primitiveInfo, int start, int end,
+        const Bounds3f& bounds) {
+    int nodeIndex = int(nodes.size());
+    nodes.push_back(LinearBVHNode());
+    LinearBVHNode& node = nodes.back();
+    node.bounds = bounds;
+    node.primitivesOffset = int(primitiveIndices.size());
+    node.nPrimitives = uint16_t(end - start);
+    node.axis = 0;
+    for (int i = start; i < end; ++i) {
+        primitiveIndices.push_back(int(primitiveInfo[i].primitiveNumber));
+    }
+    return nodeIndex;
+}
+
+int BVH::RecursiveBuild(std::vector<BVHPrimitiveInfo>& primitiveInfo, int start, int end) {
+    /// Compute bounds of all primitives in node
+    Bounds3f bounds;
+    for (int i = start; i < end; ++i) {
+        bounds = Union(bounds, primitiveInfo[i].bounds);
+    }
+
+    int nPrimitives = end - start;
+    if (nPrimitives == 1) {
+        return CreateLeaf(primitiveInfo, start, end, bounds);
+    }
+
+    /// Compute bound of primitive centroids, choose split dimension
+    Bounds3f centroidBounds;
+    for (int i = start; i < end; ++i) {
+        centroidBounds = Union(centroidBounds, primitiveInfo[i].centroid);
+    }
+    int dim = centroidBounds.MaximumExtent();
+
+    /// Coincident centroids cannot be partitioned any further
+    if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) {
+        if (nPrimitives <= 0xffff) {
+            return CreateLeaf(primitiveInfo, start, end, bounds);
+        }
+    }
+
+    /// Partition primitives into two sets
+    int mid = (start + end) / 2;
+    switch (splitMethod) {
+      case SplitMethod::Middle: {
+        float pmid = 0.5f * (centroidBounds.pMin[dim] + centroidBounds.pMax[dim]);
+        BVHPrimitiveInfo* midPtr = std::partition(&primitiveInfo[start], &primitiveInfo[end - 1] + 1,
+            [dim, pmid](const BVHPrimitiveInfo& pi) {
+                return pi.centroid[dim] < pmid;
+            });
+        mid = int(midPtr - &primitiveInfo[0]);
+        if (mid != start and mid != end) {
+            break;
+        }
+        /// Fall back to equal counts if the middle split failed
+        mid = (start + end) / 2;
+        std::nth_element(&primitiveInfo[start], &primitiveInfo[mid], &primitiveInfo[end - 1] + 1,
+            [dim](const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b) {
+                return a.centroid[dim] < b.centroid[dim];
+            });
+        break;
+      }
+      case SplitMethod::EqualCounts: {
+        std::nth_element(&primitiveInfo[start], &primitiveInfo[mid], &primitiveInfo[end - 1] + 1,
+            [dim](const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b) {
+                return a.centroid[dim] < b.centroid[dim];
+            });
+        break;
+      }
+      case SplitMethod::SAH:
+      default: {
+        if (nPrimitives <= 2) {
+            std::nth_element(&primitiveInfo[start], &primitiveInfo[mid], &primitiveInfo[end - 1] + 1,
+                [dim](const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b) {
+                    return a.centroid[dim] < b.centroid[dim];
+                });
+            break;
+        }
+
+        /// Initialize buckets for SAH partition
+        const int nBuckets = 12;
+        struct BucketInfo {
+            int count = 0;
+            Bounds3f bounds;
+        };
+        BucketInfo buckets[nBuckets];
+        for (int i = start; i < end; ++i) {
+            int b = int(nBuckets * centroidBounds.Offset(primitiveInfo[i].centroid)[dim]);
+            b = Clamp(b, 0, nBuckets - 1);
+            buckets[b].count++;
+            buckets[b].bounds = Union(buckets[b].bounds, primitiveInfo[i].bounds);
+        }
+
+        /// Compute costs for splitting after each bucket
+        float cost[nBuckets - 1];
+        for (int i = 0; i < nBuckets - 1; ++i) {
+            Bounds3f b0, b1;
+            int count0 = 0, count1 = 0;
+            for (int j = 0; j <= i; ++j) {
+                b0 = Union(b0, buckets[j].bounds);
+                count0 += buckets[j].count;
+            }
+            for (int j = i + 1; j < nBuckets; ++j) {
+                b1 = Union(b1, buckets[j].bounds);
+                count1 += buckets[j].count;
+            }
+            float area0 = count0 ? b0.SurfaceArea() : 0.0f;
+            float area1 = count1 ? b1.SurfaceArea() : 0.0f;
+            cost[i] = 0.125f + (count0 * area0 + count1 * area1) / bounds.SurfaceArea();
+        }
+
+        /// Find bucket to split at that minimizes SAH metric
+        float minCost = cost[0];
+        int minCostSplitBucket = 0;
+        for (int i = 1; i < nBuckets - 1; ++i) {
+            if (cost[i] < minCost) {
+                minCost = cost[i];
+                minCostSplitBucket = i;
+            }
+        }
+
+        /// Either create leaf or split primitives at selected SAH bucket
+        float leafCost = float(nPrimitives);
+        if (nPrimitives > maxPrimsInNode or minCost < leafCost) {
+            BVHPrimitiveInfo* pmid = std::partition(&primitiveInfo[start], &primitiveInfo[end - 1] + 1,
+                [=](const BVHPrimitiveInfo& pi) {
+                    int b = int(nBuckets * centroidBounds.Offset(pi.centroid)[dim]);
+                    b = Clamp(b, 0, nBuckets - 1);
+                    return b <= minCostSplitBucket;
+                });
+            mid = int(pmid - &primitiveInfo[0]);
+        } else {
+            return CreateLeaf(primitiveInfo, start, end, bounds);
+        }
+        break;
+      }
+    }
+
+    /// A split with an empty side, as when too many centroids coincide
+    /// for one leaf, would recurse on the same range forever
+    if (mid == start or mid == end) {
+        mid = (start + end) / 2;
+    }
+
+    /// Build children depth first, the first child directly follows its parent
+    int nodeIndex = int(nodes.size());
+    nodes.push_back(LinearBVHNode());
+    nodes[nodeIndex].bounds = bounds;
+    nodes[nodeIndex].nPrimitives = 0;
+    nodes[nodeIndex].axis = uint8_t(dim);
+    RecursiveBuild(primitiveInfo, start, mid);
+    int secondChild = RecursiveBuild(primitiveInfo, mid, end);
+    nodes[nodeIndex].secondChildOffset = secondChild;
+    return nodeIndex;
+}
+
+Bounds3f BVH::ClipReference(const BVHPrimitiveInfo& reference, const Bounds3f& clip) const {
+    Bounds3f bounds = clipPrimitive ? clipPrimitive(reference.primitiveNumber, clip) : reference.bounds;
+
+    /// Intersect without reordering the corners, the result never grows
+    Bounds3f ret;
+    ret.pMin = Max(Max(bounds.pMin, reference.bounds.pMin), clip.pMin);
+    ret.pMax = Min(Min(bounds.pMax, reference.bounds.pMax), clip.pMax);
+    return ret;
+}
+
+int BVH::RecursiveBuildSpatial(std::vector<BVHPrimitiveInfo>& references, float rootArea,
+        int* duplicationBudget, int depth) {
+    int nReferences = int(references.size());
+    Bounds3f bounds, centroidBounds;
+    for (const BVHPrimitiveInfo& reference : references) {
+        bounds = Union(bounds, reference.bounds);
+        centroidBounds = Union(centroidBounds, reference.centroid);
+    }
+    if (nReferences == 1) {
+        return CreateLeaf(references, 0, nReferences, bounds);
+    }
+    float area = bounds.SurfaceArea();
+    float invArea = area > 0.0f ? 1.0f / area : 0.0f;
+
+    struct Bin {
+        int count = 0;
+        int entries = 0;
+        int exits = 0;
+        Bounds3f bounds;
+    };
+
+    /// Find the best binned object split over all three axes
+    float objectCost = INFINITY;
+    int objectAxis = 0;
+    int objectBin = 0;
+    Bounds3f objectLeft, objectRight;
+    for (int axis = 0; axis < 3; ++axis) {
+        float cMin = centroidBounds.pMin[axis];
+        float cExtent = centroidBounds.pMax[axis] - cMin;
+        if (cExtent <= 0.0f) {
+            continue;
+        }
+        Bin bins[nSpatialBins];
+        for (const BVHPrimitiveInfo& reference : references) {
+            int b = Clamp(int(nSpatialBins * (reference.centroid[axis] - cMin) / cExtent), 0, nSpatialBins - 1);
+            bins[b].count++;
+            bins[b].bounds = Union(bins[b].bounds, reference.bounds);
+        }
+        Bounds3f rightBounds[nSpatialBins];
+        Bounds3f accum;
+        for (int i = nSpatialBins - 1; i > 0; --i) {
+            accum = Union(accum, bins[i].bounds);
+            rightBounds[i] = accum;
+        }
+        Bounds3f leftBounds;
+        int nLeft = 0;
+        for (int i = 0; i < nSpatialBins - 1; ++i) {
+            leftBounds = Union(leftBounds, bins[i].bounds);
+            nLeft += bins[i].count;
+            int nRight = nReferences - nLeft;
+            if (nLeft == 0 or nRight == 0) {
+                continue;
+            }
+            float cost = 0.125f + (nLeft * leftBounds.SurfaceArea() +
+                                   nRight * rightBounds[i + 1].SurfaceArea()) * invArea;
+            if (cost < objectCost) {
+                objectCost = cost;
+                objectAxis = axis;
+                objectBin = i;
+                objectLeft = leftBounds;
+                objectRight = rightBounds[i + 1];
+            }
+        }
+    }
+
+    /// Only try spatial splits where the object split children overlap noticeably
+    float spatialCost = INFINITY;
+    int spatialAxis = 0;
+    float spatialPlane = 0.0f;
+    int spatialLeftCount = 0, spatialRightCount = 0;
+    Bounds3f spatialLeft, spatialRight;
+    Bounds3f overlap;
+    overlap.pMin = Max(objectLeft.pMin, objectRight.pMin);
+    overlap.pMax = Min(objectLeft.pMax, objectRight.pMax);
+    bool overlapping = objectCost == INFINITY or
+        (overlap.pMin.x < overlap.pMax.x and overlap.pMin.y < overlap.pMax.y and
+         overlap.pMin.z < overlap.pMax.z and overlap.SurfaceArea() > spatialSplitAlpha * rootArea);
+    if (overlapping and *duplicationBudget > 0 and depth < maxSpatialSplitDepth) {
+        for (int axis = 0; axis < 3; ++axis) {
+            float bMin = bounds.pMin[axis];
+            float bExtent = bounds.pMax[axis] - bMin;
+            if (bExtent <= 0.0f) {
+                continue;
+            }
+            auto binOf = [&](float x) {
+                return Clamp(int(nSpatialBins * (x - bMin) / bExtent), 0, nSpatialBins - 1);
+            };
+
+            /// Chop every reference into the bins it overlaps
+            Bin bins[nSpatialBins];
+            for (const BVHPrimitiveInfo& reference : references) {
+                int b0 = binOf(reference.bounds.pMin[axis]);
+                int b1 = binOf(reference.bounds.pMax[axis]);
+                bins[b0].entries++;
+                bins[b1].exits++;
+                for (int b = b0; b <= b1; ++b) {
+                    Bounds3f slab = bounds;
+                    slab.pMin[axis] = bMin + bExtent * b / nSpatialBins;
+                    slab.pMax[axis] = (b == nSpatialBins - 1) ? bounds.pMax[axis] : bMin + bExtent * (b + 1) / nSpatialBins;
+                    bins[b].bounds = Union(bins[b].bounds, ClipReference(reference, slab));
+                }
+            }
+
+            Bounds3f rightBounds[nSpatialBins];
+            int rightCount[nSpatialBins];
+            Bounds3f accum;
+            int exits = 0;
+            for (int i = nSpatialBins - 1; i > 0; --i) {
+                accum = Union(accum, bins[i].bounds);
+                exits += bins[i].exits;
+                rightBounds[i] = accum;
+                rightCount[i] = exits;
+            }
+            Bounds3f leftBounds;
+            int nLeft = 0;
+            for (int i = 0; i < nSpatialBins - 1; ++i) {
+                leftBounds = Union(leftBounds, bins[i].bounds);
+                nLeft += bins[i].entries;
+                int nRight = rightCount[i + 1];
+                if (nLeft == 0 or nRight == 0 or (nLeft == nReferences and nRight == nReferences)) {
+                    continue;
+                }
+                if (nLeft + nRight - nReferences > *duplicationBudget) {
+                    continue;
+                }
+                float cost = 0.125f + (nLeft * leftBounds.SurfaceArea() +
+                                       nRight * rightBounds[i + 1].SurfaceArea()) * invArea;
+                if (cost < spatialCost) {
+                    spatialCost = cost;
+                    spatialAxis = axis;
+                    spatialPlane = bMin + bExtent * (i + 1) / nSpatialBins;
+                    spatialLeftCount = nLeft;
+                    spatialRightCount = nRight;
+                    spatialLeft = leftBounds;
+                    spatialRight = rightBounds[i + 1];
+                }
+            }
+        }
+    }
+
+    /// Make a leaf if neither split beats intersecting everything here
+    float minCost = std::min(objectCost, spatialCost);
+    if (nReferences <= 0xffff and (minCost == INFINITY or
+        (nReferences <= maxPrimsInNode and minCost >= float(nReferences)))) {
+        return CreateLeaf(references, 0, nReferences, bounds);
+    }
+
+    std::vector<BVHPrimitiveInfo> left, right;
+    int axis;
+    if (minCost == INFINITY) {
+        /// Too many coincident references for a leaf, split them evenly
+        axis = bounds.MaximumExtent();
+        left.assign(references.begin(), references.begin() + nReferences / 2);
+        right.assign(references.begin() + nReferences / 2, references.end());
+    } else if (objectCost <= spatialCost) {
+        axis = objectAxis;
+        float cMin = centroidBounds.pMin[axis];
+        float cExtent = centroidBounds.pMax[axis] - cMin;
+        for (const BVHPrimitiveInfo& reference : references) {
+            int b = Clamp(int(nSpatialBins * (reference.centroid[axis] - cMin) / cExtent), 0, nSpatialBins - 1);
+            if (b <= objectBin) {
+                left.push_back(reference);
+            } else {
+                right.push_back(reference);
+            }
+        }
+    } else {
+        axis = spatialAxis;
+        Bounds3f leftClip = bounds, rightClip = bounds;
+        leftClip.pMax[axis] = spatialPlane;
+        rightClip.pMin[axis] = spatialPlane;
+        int nLeft = spatialLeftCount, nRight = spatialRightCount;
+        for (const BVHPrimitiveInfo& reference : references) {
+            if (reference.bounds.pMax[axis] <= spatialPlane) {
+                left.push_back(reference);
+            } else if (reference.bounds.pMin[axis] >= spatialPlane) {
+                right.push_back(reference);
+            } else {
+                /// Reference unsplitting, keep straddlers whole when that is cheaper
+                float splitCost = spatialLeft.SurfaceArea() * nLeft + spatialRight.SurfaceArea() * nRight;
+                Bounds3f leftUnion = Union(spatialLeft, reference.bounds);
+                Bounds3f rightUnion = Union(spatialRight, reference.bounds);
+                float leftCost = leftUnion.SurfaceArea() * nLeft + spatialRight.SurfaceArea() * (nRight - 1);
+                float rightCost = spatialLeft.SurfaceArea() * (nLeft - 1) + rightUnion.SurfaceArea() * nRight;
+                if (leftCost < splitCost and leftCost <= rightCost) {
+                    left.push_back(reference);
+                    spatialLeft = leftUnion;
+                    nRight--;
+                } else if (rightCost < splitCost) {
+                    right.push_back(reference);
+                    spatialRight = rightUnion;
+                    nLeft--;
+                } else {
+                    left.push_back(BVHPrimitiveInfo(reference.primitiveNumber, ClipReference(reference, leftClip)));
+                    right.push_back(BVHPrimitiveInfo(reference.primitiveNumber, ClipReference(reference, rightClip)));
+                    (*duplicationBudget)--;
+                }
+            }
+        }
+    }
+
+    /// Guard against rounding at the split plane leaving a child empty
+    if (left.empty() or right.empty()) {
+        left.clear();
+        right.clear();
+        axis = centroidBounds.MaximumExtent();
+        std::nth_element(references.begin(), references.begin() + nReferences / 2, references.end(),
+            [axis](const BVHPrimitiveInfo& a, const BVHPrimitiveInfo& b) {
+                return a.centroid[axis] < b.centroid[axis];
+            });
+        left.assign(references.begin(), references.begin() + nReferences / 2);
+        right.assign(references.begin() + nReferences / 2, references.end());
+    }
+    std::vector<BVHPrimitiveInfo>().swap(references);
+
+    int nodeIndex = int(nodes.size());
+    nodes.push_back(LinearBVHNode());
+    nodes[nodeIndex].bounds = bounds;
+    nodes[nodeIndex].nPrimitives = 0;
+    nodes[nodeIndex].axis = uint8_t(axis);
+    RecursiveBuildSpatial(left, rootArea, duplicationBudget, depth + 1);
+    int secondChild = RecursiveBuildSpatial(right, rootArea, duplicationBudget, depth + 1);
+    nodes[nodeIndex].secondChildOffset = secondChild;
+    return nodeIndex;
+}
+
+int BVH::SubtreeEnd(int nodeIndex) const {
+    /// The last node of a subtree is its rightmost leaf
+    const LinearBVHNode* linearNodes = Nodes();
+    while (linearNodes[nodeIndex].nPrimitives == 0) {
+        nodeIndex = linearNodes[nodeIndex].secondChildOffset;
+    }
+    return nodeIndex + 1;
+}
+
+std::vector<float> BVH::SubtreeCosts() const {
+    /// Accumulate unnormalized costs bottom up, children follow their parent
+    const LinearBVHNode* linearNodes = Nodes();
+    std::vector<float> cost(NodeCount());
+    for (int i = NodeCount() - 1; i >= 0; --i) {
+        const LinearBVHNode& node = linearNodes[i];
+        float area = node.bounds.SurfaceArea();
+        if (node.nPrimitives > 0) {
+            cost[i] = area * node.nPrimitives;
+        } else {
+            cost[i] = area * 0.125f + cost[i + 1] + cost[node.secondChildOffset];
+        }
+    }
+
+    /// Normalize by node area so rigid motion and scaling leave costs unchanged
+    for (int i = 0; i < NodeCount(); ++i) {
+        float area = linearNodes[i].bounds.SurfaceArea();
+        cost[i] = area > 0.0f ? cost[i] / area : 0.0f;
+    }
+    return cost;
+}
+
+float BVH::SAHCost() const {
+    return Empty() ? 0.0f : SubtreeCosts()[0];
+}
+
+size_t BVH::MemoryBytes() const {
+    return size_t(NodeCount()) * sizeof(LinearBVHNode) + size_t(PrimitiveIndexCount()) * sizeof(int) +
+        buildCost.size() * sizeof(float);
+}
+
+void BVH::RefitNode(int nodeIndex, const std::vector<Bounds3f>& primitiveBounds) {
+    LinearBVHNode& node = nodes[nodeIndex];
+    if (node.nPrimitives > 0) {
+        Bounds3f bounds;
+        for (int i = 0; i < node.nPrimitives; ++i) {
+            bounds = Union(bounds, primitiveBounds[primitiveIndices[node.primitivesOffset + i]]);
+        }
+        node.bounds = bounds;
+    } else {
+        node.bounds = Union(nodes[nodeIndex + 1].bounds, nodes[node.secondChildOffset].bounds);
+    }
+}
+
+void BVH::Refit(const std::vector<Bounds3f>& primitiveBounds) {
+    Detach();
+    if (nodes.empty()) {
+        return;
+    }
+
+    /// Small trees are refit with one reverse sweep, which always visits
+    /// children before their parent
+    int nThreads = MaxThreadIndex();
+    if (nThreads == 1 or nodes.size() < 4096) {
+        for (int i = int(nodes.size()) - 1; i >= 0; --i) {
+            RefitNode(i, primitiveBounds);
+        }
+        return;
+    }
+
+    /// Cut the top of the tree into disjoint subtrees, breadth first
+    std::vector<int> upper;
+    std::vector<int> subtrees(1, 0);
+    while (subtrees.size() < size_t(4 * nThreads)) {
+        std::vector<int> next;
+        for (int nodeIndex : subtrees) {
+            if (nodes[nodeIndex].nPrimitives > 0) {
+                next.push_back(nodeIndex);
+            } else {
+                upper.push_back(nodeIndex);
+                next.push_back(nodeIndex + 1);
+                next.push_back(nodes[nodeIndex].secondChildOffset);
+            }
+        }
+        if (next.size() == subtrees.size()) {
+            break;
+        }
+        subtrees.swap(next);
+    }
+
+    /// Each subtree is a contiguous node range and is swept independently
+    ParallelFor(int64_t(subtrees.size()), [&](int64_t k) {
+        int end = SubtreeEnd(subtrees[k]);
+        for (int i = end - 1; i >= subtrees[k]; --i) {
+            RefitNode(i, primitiveBounds);
+        }
+    });
+
+    /// Finish the nodes above the cut, deepest level first
+    for (auto it = upper.rbegin(); it != upper.rend(); ++it) {
+        RefitNode(*it, primitiveBounds);
+    }
+}
+
+BVHUpdate BVH::Update(const std::vector<Bounds3f>& primitiveBounds, float rebuildThreshold) {
+    Refit(primitiveBounds);
+    if (nodes.empty()) {
+        return BVHUpdate::Refit;
+    }
+
+    std::vector<float> cost = SubtreeCosts();
+    auto degraded = [&](int nodeIndex) {
+        return cost[nodeIndex] > rebuildThreshold * buildCost[nodeIndex];
+    };
+    if (!degraded(0)) {
+        return BVHUpdate::Refit;
+    }
+
+    /// Follow the degradation down while it is confined to a single child
+    int nodeIndex = 0;
+    while (nodes[nodeIndex].nPrimitives == 0) {
+        int first = nodeIndex + 1;
+        int second = nodes[nodeIndex].secondChildOffset;
+        if (degraded(first) == degraded(second)) {
+            break;
+        }
+        nodeIndex = degraded(first) ? first : second;
+    }
+
+    if (nodeIndex != 0) {
+        RebuildSubtree(nodeIndex, primitiveBounds);
+        return BVHUpdate::PartialRebuild;
+    }
+
+    std::vector<BVHPrimitiveInfo> primitiveInfo(primitiveBounds.size());
+    for (size_t i = 0; i < primitiveBounds.size(); ++i) {
+        primitiveInfo[i] = BVHPrimitiveInfo(i, primitiveBounds[i]);
+    }
+    *this = BVH(std::move(primitiveInfo), maxPrimsInNode, splitMethod, clipPrimitive);
+    return BVHUpdate::FullRebuild;
+}
+
+void BVH::RebuildSubtree(int nodeIndex, const std::vector<Bounds3f>& primitiveBounds) {
+    int end = SubtreeEnd(nodeIndex);
+
+    /// Leaves of a subtree reference a contiguous range of primitive indices
+    int primStart = std::numeric_limits<int>::max();
+    int primEnd = 0;
+    for (int i = nodeIndex; i < end; ++i) {
+        if (nodes[i].nPrimitives > 0) {
+            primStart = std::min(primStart, nodes[i].primitivesOffset);
+            primEnd = std::max(primEnd, nodes[i].primitivesOffset + nodes[i].nPrimitives);
+        }
+    }
+
+    /// Spatial splits may have referenced a primitive more than once
+    std::vector<int> subtreePrimitives(primitiveIndices.begin() + primStart, primitiveIndices.begin() + primEnd);
+    if (splitMethod == SplitMethod::SBVH) {
+        std::sort(subtreePrimitives.begin(), subtreePrimitives.end());
+        subtreePrimitives.erase(std::unique(subtreePrimitives.begin(), subtreePrimitives.end()),
+            subtreePrimitives.end());
+    }
+    std::vector<BVHPrimitiveInfo> primitiveInfo;
+    primitiveInfo.reserve(subtreePrimitives.size());
+    for (int primitive : subtreePrimitives) {
+        primitiveInfo.push_back(BVHPrimitiveInfo(primitive, primitiveBounds[primitive]));
+    }
+    BVH subtree(std::move(primitiveInfo), maxPrimsInNode, splitMethod, clipPrimitive);
+
+    /// Splice the new primitive references over the old ones
+    int primDelta = int(subtree.primitiveIndices.size()) - (primEnd - primStart);
+    std::vector<int> splicedIndices(primitiveIndices.begin(), primitiveIndices.begin() + primStart);
+    splicedIndices.insert(splicedIndices.end(), subtree.primitiveIndices.begin(), subtree.primitiveIndices.end());
+    splicedIndices.insert(splicedIndices.end(), primitiveIndices.begin() + primEnd, primitiveIndices.end());
+    primitiveIndices.swap(splicedIndices);
+
+    /// Splice the new nodes over the old range, shifting offsets past it
+    int delta = int(subtree.nodes.size()) - (end - nodeIndex);
+    std::vector<LinearBVHNode> spliced;
+    std::vector<float> splicedCost;
+    spliced.reserve(nodes.size() + delta);
+    splicedCost.reserve(nodes.size() + delta);
+    for (int i = 0; i < nodeIndex; ++i) {
+        spliced.push_back(nodes[i]);
+        splicedCost.push_back(buildCost[i]);
+        if (nodes[i].nPrimitives == 0 and nodes[i].secondChildOffset >= end) {
+            spliced.back().secondChildOffset += delta;
+        }
+    }
+    for (size_t i = 0; i < subtree.nodes.size(); ++i) {
+        spliced.push_back(subtree.nodes[i]);
+        splicedCost.push_back(subtree.buildCost[i]);
+        if (subtree.nodes[i].nPrimitives > 0) {
+            spliced.back().primitivesOffset += primStart;
+        } else {
+            spliced.back().secondChildOffset += nodeIndex;
+        }
+    }
+    for (int i = end; i < int(nodes.size()); ++i) {
+        spliced.push_back(nodes[i]);
+        splicedCost.push_back(buildCost[i]);
+        if (nodes[i].nPrimitives == 0) {
+            spliced.back().secondChildOffset += delta;
+        } else {
+            spliced.back().primitivesOffset += primDelta;
+        }
+    }
+    nodes.swap(spliced);
+    buildCost.swap(splicedCost);
+}
+
+void BVH::CollapseSubtrees(int maxPrims) {
+    Detach();
+    if (Empty()) {
+        return;
+    }
+    std::vector<LinearBVHNode> collapsed;
+    collapsed.reserve(nodes.size());
+    CollapseNode(0, maxPrims, &collapsed);
+    nodes.swap(collapsed);
+    nodes.shrink_to_fit();
+    buildCost = SubtreeCosts();
+}
+
+int BVH::CollapseNode(int nodeIndex, int maxPrims, std::vector<LinearBVHNode>* collapsed) const {
+    const LinearBVHNode& node = nodes[nodeIndex];
+    int outIndex = int(collapsed->size());
+    collapsed->push_back(node);
+    if (node.nPrimitives > 0) {
+        return outIndex;
+    }
+
+    /// Leaves store their indices in depth first order, so a subtree's
+    /// primitives run from its leftmost leaf to the end of its rightmost
+    int first = nodeIndex;
+    while (nodes[first].nPrimitives == 0) {
+        ++first;
+    }
+    const LinearBVHNode& last = nodes[SubtreeEnd(nodeIndex) - 1];
+    int nPrimitives = last.primitivesOffset + last.nPrimitives - nodes[first].primitivesOffset;
+    if (nPrimitives <= maxPrims) {
+        LinearBVHNode& leaf = (*collapsed)[outIndex];
+        leaf.primitivesOffset = nodes[first].primitivesOffset;
+        leaf.nPrimitives = uint16_t(nPrimitives);
+        leaf.axis = 0;
+        return outIndex;
+    }
+    CollapseNode(nodeIndex + 1, maxPrims, collapsed);
+    int secondChild = CollapseNode(node.secondChildOffset, maxPrims, collapsed);
+    (*collapsed)[outIndex].secondChildOffset = secondChild;
+    return outIndex;
+}
+
+/**
+ * \brief BVHAccel method definitions
+ */
+
+BVHAccel::BVHAccel(std::vector<std::shared_ptr<Shape>> shapes, int maxPrimsInNode, SplitMethod splitMethod,
+        const std::string& cacheFilename)
+    : shapes(std::move(shapes)) {
+    std::vector<BVHPrimitiveInfo> primitiveInfo(this->shapes.size());
+    for (size_t i = 0; i < this->shapes.size(); ++i) {
+        primitiveInfo[i] = BVHPrimitiveInfo(i, this->shapes[i]->WorldBounds());
+    }
+    if (cacheFilename.empty()) {
+        bvh = BVH(std::move(primitiveInfo), maxPrimsInNode, splitMethod);
+        return;
+    }
+
+    uint64_t key = BVHCacheKey(primitiveInfo, maxPrimsInNode, splitMethod);
+    if (!LoadBVHCache(cacheFilename, key, &bvh)) {
+        /// A failed write only means the next run builds the tree again
+        bvh = BVH(std::move(primitiveInfo), maxPrimsInNode, splitMethod);
+        WriteBVHCache(cacheFilename, bvh, key);
+    }
+}
+
+Bounds3f BVHAccel::WorldBound() const {
+    return bvh.WorldBound();
+}
+
+bool BVHAccel::Intersect(const Ray& r, SurfaceInteraction* isect) const {
+    HitRecord hit;
+    if (!Intersect(r, &hit)) {
+        return false;
+    }
+    ComputeSurfaceInteraction(r, hit, isect);
+    return true;
+}
+
+bool BVHAccel::Intersect(const Ray& r, HitRecord* hit) const {
+    return bvh.Intersect(r, [&](int index) {
+        if (!shapes[index]->IntersectHit(r, hit)) {
+            return false;
+        }
+        r.tMax = hit->t;
+        hit->primID = index;
+        return true;
+    });
+}
+
+void BVHAccel::Intersect(const Ray* rays, int nRays, HitRecord* hits) const {
+    for (int i = 0; i < nRays; ++i) {
+        hits[i] = HitRecord();
+    }
+    bvh.IntersectInterleaved(rays, nRays, [&](int ray, int index) {
+        if (shapes[index]->IntersectHit(rays[ray], &hits[ray])) {
+            rays[ray].tMax = hits[ray].t;
+            hits[ray].primID = index;
+        }
+    });
+}
+
+void BVHAccel::ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const {
+    shapes[hit.primID]->ComputeSurfaceInteraction(r, hit, isect);
+}
+
+bool BVHAccel::IntersectP(const Ray& r) const {
+    return bvh.IntersectP(r, [&](int index) {
+        return shapes[index]->IntersectTest(r);
+    });
+}
+
+bool BVHAccel::IntersectP(const Ray& r, OcclusionCache* cache, int light) const {
+    /// The cached primitive may come from another accel sharing the cache
+    int& last = cache->primID[light];
+    if (last >= 0 and last < int(shapes.size()) and shapes[last]->IntersectTest(r)) {
+        return true;
+    }
+    return bvh.IntersectP(r, [&](int index) {
+        if (index == last or !shapes[index]->IntersectTest(r)) {
+            return false;
+        }
+        last = index;
+        return true;
+    });
+}
+
+BVHUpdate BVHAccel::Update(float rebuildThreshold) {
+    std::vector<Bounds3f> bounds(shapes.size());
+    for (size_t i = 0; i < shapes.size(); ++i) {
+        bounds[i] = shapes[i]->WorldBounds();
+    }
+    return bvh.Update(bounds, rebuildThreshold);
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,149 @@
+#include <cstdio>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "heimdall/bvhcache.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief Fixed size header at the start of every cache file
+ */
+
+struct BVHCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t nodeSize;          /// Catches layout changes that forgot the version
+    uint64_t key;
+    int32_t maxPrimsInNode;
+    int32_t splitMethod;
+    int32_t nNodes;
+    int32_t nPrimitiveIndices;
+};
+
+static const char bvhCacheMagic[8] = {'H', 'M', 'D', 'L', 'B', 'V', 'H', '\0'};
+static const size_t nodesOffset = 64;   /// Header padded so nodes start cache line aligned
+
+static size_t CacheFileSize(int nNodes, int nPrimitiveIndices) {
+    return nodesOffset + nNodes * sizeof(LinearBVHNode) + nPrimitiveIndices * sizeof(int) +
+           nNodes * sizeof(float);
+}
+
+/**
+ * \brief BVH cache function definitions
+ */
+
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint64_t BVHCacheKey(const std::vector<BVHPrimitiveInfo>& primitiveInfo, int maxPrimsInNode,
+        SplitMethod splitMethod) {
+    int32_t params[3] = {int32_t(primitiveInfo.size()), maxPrimsInNode, int32_t(splitMethod)};
+    uint64_t hash = HashBytes(params, sizeof(params));
+    for (const BVHPrimitiveInfo& info : primitiveInfo) {
+        uint64_t primitiveNumber = info.primitiveNumber;
+        float bounds[6] = {info.bounds.pMin.x, info.bounds.pMin.y, info.bounds.pMin.z,
+                           info.bounds.pMax.x, info.bounds.pMax.y, info.bounds.pMax.z};
+        hash = HashBytes(&primitiveNumber, sizeof(primitiveNumber), hash);
+        hash = HashBytes(bounds, sizeof(bounds), hash);
+    }
+    return hash;
+}
+
+bool WriteBVHCache(const std::string& filename, const BVH& bvh, uint64_t key) {
+    /// A mapped tree is unchanged since it was loaded, its file is current
+    if (bvh.mapping) {
+        return true;
+    }
+
+    BVHCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, bvhCacheMagic, sizeof(header.magic));
+    header.version = bvhCacheVersion;
+    header.nodeSize = sizeof(LinearBVHNode);
+    header.key = key;
+    header.maxPrimsInNode = bvh.maxPrimsInNode;
+    header.splitMethod = int32_t(bvh.splitMethod);
+    header.nNodes = int32_t(bvh.nodes.size());
+    header.nPrimitiveIndices = int32_t(bvh.primitiveIndices.size());
+
+    std::string tmpFilename = filename + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream file(tmpFilename, std::ios::binary | std::ios::trunc);
+        char padding[nodesOffset] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(padding, nodesOffset - sizeof(header));
+        file.write(reinterpret_cast<const char*>(bvh.nodes.data()), bvh.nodes.size() * sizeof(LinearBVHNode));
+        file.write(reinterpret_cast<const char*>(bvh.primitiveIndices.data()),
+            bvh.primitiveIndices.size() * sizeof(int));
+        file.write(reinterpret_cast<const char*>(bvh.buildCost.data()), bvh.buildCost.size() * sizeof(float));
+        if (!file) {
+            file.close();
+            std::remove(tmpFilename.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+        std::remove(tmpFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool LoadBVHCache(const std::string& filename, uint64_t key, BVH* bvh) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 or size_t(st.st_size) < nodesOffset) {
+        close(fd);
+        return false;
+    }
+    size_t size = size_t(st.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    std::shared_ptr<const void> mapping(data, [size](const void* p) {
+        munmap(const_cast<void*>(p), size);
+    });
+
+    const char* bytes = static_cast<const char*>(data);
+    const BVHCacheHeader* header = reinterpret_cast<const BVHCacheHeader*>(bytes);
+    if (std::memcmp(header->magic, bvhCacheMagic, sizeof(bvhCacheMagic)) != 0 or
+        header->version != bvhCacheVersion or header->nodeSize != sizeof(LinearBVHNode) or
+        header->key != key or header->nNodes < 0 or header->nPrimitiveIndices < 0 or
+        CacheFileSize(header->nNodes, header->nPrimitiveIndices) != size) {
+        return false;
+    }
+
+    /// Point the tree at the mapped arrays, the mapping lives as long as
+    /// any BVH copy referencing it
+    const char* indices = bytes + nodesOffset + header->nNodes * sizeof(LinearBVHNode);
+    const char* cost = indices + header->nPrimitiveIndices * sizeof(int);
+    *bvh = BVH();
+    bvh->maxPrimsInNode = header->maxPrimsInNode;
+    bvh->splitMethod = SplitMethod(header->splitMethod);
+    bvh->mappedNodes = reinterpret_cast<const LinearBVHNode*>(bytes + nodesOffset);
+    bvh->mappedIndices = reinterpret_cast<const int*>(indices);
+    bvh->mappedCost = reinterpret_cast<const float*>(cost);
+    bvh->nMappedNodes = header->nNodes;
+    bvh->nMappedIndices = header->nPrimitiveIndices;
+    bvh->mapping = std::move(mapping);
+    return true;
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,146 @@
+#include "heimdall/camera.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief Camera method definitions
+ */
+
+Camera::Camera(const AnimatedTransform& CameraToWorld, float shutterOpen, float shutterClose, Film* film)
+    : CameraToWorld(CameraToWorld), shutterOpen(shutterOpen), shutterClose(shutterClose), film(film) {}
+
+Camera::~Camera() {}
+
+float Camera::GenerateRayDifferential(const CameraSample& sample, RayDifferential* ray) const {
+    GenerateRayDifferentials(&sample, 1, ray);
+    return 1.0f;
+}
+
+/**
+ * \brief ProjectiveCamera method definitions
+ */
+
+ProjectiveCamera::ProjectiveCamera(const AnimatedTransform& CameraToWorld, const Transform& CameraToScreen,
+                                   const Bounds2f& screenWindow, float shutterOpen, float shutterClose, Film* film)
+    : Camera(CameraToWorld, shutterOpen, shutterClose, film), CameraToScreen(CameraToScreen) {
+    /// Screen window to raster, y flips so raster rows run downwards
+    ScreenToRaster = Scale(float(film->fullResolution.x), float(film->fullResolution.y), 1.0f) *
+                     Scale(1.0f / (screenWindow.pMax.x - screenWindow.pMin.x),
+                           1.0f / (screenWindow.pMin.y - screenWindow.pMax.y), 1.0f) *
+                     Translate(Vec3f(-screenWindow.pMin.x, -screenWindow.pMax.y, 0.0f));
+    RasterToScreen = Inverse(ScreenToRaster);
+    RasterToCamera = Inverse(CameraToScreen) * RasterToScreen;
+
+    /// Raster points map onto the near plane affinely, tabulate the map
+    pCamera0 = RasterToCamera(Point3f(0.0f, 0.0f, 0.0f));
+    dxCamera = RasterToCamera(Point3f(1.0f, 0.0f, 0.0f)) - pCamera0;
+    dyCamera = RasterToCamera(Point3f(0.0f, 1.0f, 0.0f)) - pCamera0;
+    CameraToWorld.Interpolate(shutterOpen, &CameraToWorld0);
+}
+
+/**
+ * \brief OrthographicCamera method definitions
+ */
+
+OrthographicCamera::OrthographicCamera(const AnimatedTransform& CameraToWorld, const Bounds2f& screenWindow,
+                                       float shutterOpen, float shutterClose, Film* film)
+    : ProjectiveCamera(CameraToWorld, Orthographic(0.0f, 1.0f), screenWindow, shutterOpen, shutterClose, film) {
+    pWorld0 = CameraToWorld0(pCamera0);
+    dxWorld = CameraToWorld0(dxCamera);
+    dyWorld = CameraToWorld0(dyCamera);
+    dirWorld = CameraToWorld0(Vec3f(0.0f, 0.0f, 1.0f));
+}
+
+void OrthographicCamera::GenerateRayDifferentials(const CameraSample* samples, int n,
+                                                  RayDifferential* rays) const {
+    if (CameraToWorld.IsAnimated()) {
+        for (int i = 0; i < n; ++i) {
+            const Point2f& p = samples[i].pFilm;
+            Point3f o = pCamera0 + dxCamera * p.x + dyCamera * p.y;
+            RayDifferential ray(o, Vec3f(0.0f, 0.0f, 1.0f), INFINITY, SampleTime(samples[i].time));
+            ray.rxOrigin = o + dxCamera;
+            ray.ryOrigin = o + dyCamera;
+            ray.rxDirection = ray.ryDirection = ray.d;
+            ray.hasDifferentials = true;
+            rays[i] = CameraToWorld(ray);
+        }
+        return;
+    }
+
+    for (int i = 0; i < n; ++i) {
+        const Point2f& p = samples[i].pFilm;
+        RayDifferential& ray = rays[i];
+        ray.o = pWorld0 + dxWorld * p.x + dyWorld * p.y;
+        ray.d = dirWorld;
+        ray.tMax = INFINITY;
+        ray.time = SampleTime(samples[i].time);
+        ray.medium = nullptr;
+        ray.rxOrigin = ray.o + dxWorld;
+        ray.ryOrigin = ray.o + dyWorld;
+        ray.rxDirection = ray.ryDirection = dirWorld;
+        ray.hasDifferentials = true;
+    }
+}
+
+/**
+ * \brief PerspectiveCamera method definitions
+ */
+
+PerspectiveCamera::PerspectiveCamera(const AnimatedTransform& CameraToWorld, const Bounds2f& screenWindow,
+                                     float shutterOpen, float shutterClose, float fov, Film* film)
+    : ProjectiveCamera(CameraToWorld, Perspective(fov, 1e-2f, 1000.0f), screenWindow, shutterOpen, shutterClose,
+                       film) {
+    oWorld = CameraToWorld0(Point3f(0.0f, 0.0f, 0.0f));
+    dWorld0 = CameraToWorld0(Vec3f(pCamera0));
+    dxWorld = CameraToWorld0(dxCamera);
+    dyWorld = CameraToWorld0(dyCamera);
+}
+
+void PerspectiveCamera::GenerateRayDifferentials(const CameraSample* samples, int n,
+                                                 RayDifferential* rays) const {
+    if (CameraToWorld.IsAnimated()) {
+        for (int i = 0; i < n; ++i) {
+            const Point2f& p = samples[i].pFilm;
+            Vec3f dir = Vec3f(pCamera0) + dxCamera * p.x + dyCamera * p.y;
+            RayDifferential ray(Point3f(0.0f, 0.0f, 0.0f), Normalize(dir), INFINITY, SampleTime(samples[i].time));
+            ray.rxOrigin = ray.ryOrigin = ray.o;
+            ray.rxDirection = Normalize(dir + dxCamera);
+            ray.ryDirection = Normalize(dir + dyCamera);
+            ray.hasDifferentials = true;
+            rays[i] = CameraToWorld(ray);
+        }
+        return;
+    }
+
+    /// Directions are normalized in camera space, so world space rays
+    /// match transforming the camera space ones even under scale
+    for (int i = 0; i < n; ++i) {
+        const Point2f& p = samples[i].pFilm;
+        Vec3f dirCamera = Vec3f(pCamera0) + dxCamera * p.x + dyCamera * p.y;
+        Vec3f dirWorld = dWorld0 + dxWorld * p.x + dyWorld * p.y;
+        RayDifferential& ray = rays[i];
+        ray.o = oWorld;
+        ray.d = dirWorld / dirCamera.Length();
+        ray.tMax = INFINITY;
+        ray.time = SampleTime(samples[i].time);
+        ray.medium = nullptr;
+        ray.rxOrigin = ray.ryOrigin = oWorld;
+        ray.rxDirection = (dirWorld + dxWorld) / (dirCamera + dxCamera).Length();
+        ray.ryDirection = (dirWorld + dyWorld) / (dirCamera + dyCamera).Length();
+        ray.hasDifferentials = true;
+    }
+}
+
+/**
+ * \brief Camera function definitions
+ */
+
+Bounds2f DefaultScreenWindow(const Point2i& resolution) {
+    float frame = float(resolution.x) / float(resolution.y);
+    if (frame > 1.0f) {
+        return Bounds2f(Point2f(-frame, -1.0f), Point2f(frame, 1.0f));
+    }
+    return Bounds2f(Point2f(-1.0f, -1.0f / frame), Point2f(1.0f, 1.0f / frame));
+}
+
+HEIMDALL_NAMESPACE_END
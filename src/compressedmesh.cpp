@@ -0,0 +1,217 @@
+#include "heimdall/compressedmesh.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Quantization parameters
+static const float positionSteps = 65535.0f;   /// Largest quantized coordinate
+static const float normalSteps = 32767.0f;     /// Largest octahedral snorm value
+
+/**
+ * \brief Compressed mesh function definitions
+ */
+
+uint32_t EncodeOctahedral(const Normal3f& n) {
+    /// Project onto the octahedron, then fold the lower hemisphere out
+    float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    float x = n.x / l1, y = n.y / l1;
+    if (n.z < 0.0f) {
+        float fx = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float fy = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    int16_t qx = int16_t(std::round(Clamp(x, -1.0f, 1.0f) * normalSteps));
+    int16_t qy = int16_t(std::round(Clamp(y, -1.0f, 1.0f) * normalSteps));
+    return uint32_t(uint16_t(qx)) | (uint32_t(uint16_t(qy)) << 16);
+}
+
+uint16_t FloatToHalf(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(float));
+    uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+    uint32_t mantissa = bits & 0x7fffff;
+    int exponent = int((bits >> 23) & 0xff) - 127 + 15;
+
+    if ((bits & 0x7fffffff) >= 0x7f800000) {
+        /// Infinity stays infinity, NaN stays a quiet NaN
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+    if (exponent >= 31) {
+        return sign | 0x7c00;
+    }
+    if (exponent <= 0) {
+        /// Subnormal half or zero
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway or (remainder == halfway and (half & 1))) {
+            ++half;
+        }
+        return sign | uint16_t(half);
+    }
+
+    /// Round to nearest even, a carry correctly bumps the exponent
+    uint32_t half = (uint32_t(exponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1fff;
+    if (remainder > 0x1000 or (remainder == 0x1000 and (half & 1))) {
+        ++half;
+    }
+    return sign | uint16_t(half);
+}
+
+/**
+ * \brief CompressedTriangleMesh method definitions
+ */
+
+CompressedTriangleMesh::CompressedTriangleMesh(const Transform& ObjectToWorld, int nTriangles,
+        const int* vertexIndices, int nVertices, const Point3f* P, const Normal3f* N, const Point2f* UV)
+    : nTriangles(nTriangles), nVertices(nVertices) {
+
+    /// Quantize world space positions against the mesh bounds
+    std::vector<Point3f> world(nVertices);
+    for (int i = 0; i < nVertices; ++i) {
+        world[i] = ObjectToWorld(P[i]);
+        bounds = Union(bounds, world[i]);
+    }
+    Vec3f extent = bounds.Diagonal();
+    scale = Vec3f(extent.x / positionSteps, extent.y / positionSteps, extent.z / positionSteps);
+    p.resize(3 * nVertices);
+    for (int i = 0; i < nVertices; ++i) {
+        Vec3f offset = world[i] - bounds.pMin;
+        for (int axis = 0; axis < 3; ++axis) {
+            float q = scale[axis] > 0.0f ? offset[axis] / scale[axis] : 0.0f;
+            p[3 * i + axis] = uint16_t(Clamp(std::round(q), 0.0f, positionSteps));
+        }
+    }
+    if (N) {
+        n.resize(nVertices);
+        for (int i = 0; i < nVertices; ++i) {
+            Normal3f nw = ObjectToWorld(N[i]);
+            n[i] = EncodeOctahedral(nw.LengthSquared() > 0.0f ? Normalize(nw) : Normal3f(0.0f, 0.0f, 1.0f));
+        }
+    }
+    if (UV) {
+        uv.resize(2 * nVertices);
+        for (int i = 0; i < nVertices; ++i) {
+            uv[2 * i] = FloatToHalf(UV[i].x);
+            uv[2 * i + 1] = FloatToHalf(UV[i].y);
+        }
+    }
+
+    /// Store each block of indices as offsets from its smallest vertex
+    int nBlocks = (nTriangles + blockSize - 1) / blockSize;
+    blocks.resize(nBlocks);
+    indexOffsets.resize(3 * nTriangles);
+    for (int b = 0; b < nBlocks; ++b) {
+        int begin = 3 * b * blockSize;
+        int end = 3 * std::min((b + 1) * blockSize, nTriangles);
+        int minIndex = vertexIndices[begin], maxIndex = vertexIndices[begin];
+        for (int i = begin; i < end; ++i) {
+            minIndex = std::min(minIndex, vertexIndices[i]);
+            maxIndex = std::max(maxIndex, vertexIndices[i]);
+        }
+        blocks[b].base = uint32_t(minIndex);
+        if (maxIndex - minIndex <= 0xffff) {
+            blocks[b].wideOffset = -1;
+            for (int i = begin; i < end; ++i) {
+                indexOffsets[i] = uint16_t(vertexIndices[i] - minIndex);
+            }
+        } else {
+            blocks[b].wideOffset = int32_t(wideIndices.size());
+            wideIndices.insert(wideIndices.end(), vertexIndices + begin, vertexIndices + end);
+        }
+    }
+}
+
+size_t CompressedTriangleMesh::MemoryBytes() const {
+    return p.size() * sizeof(uint16_t) + n.size() * sizeof(uint32_t) + uv.size() * sizeof(uint16_t) +
+        blocks.size() * sizeof(IndexBlock) + indexOffsets.size() * sizeof(uint16_t) +
+        wideIndices.size() * sizeof(int);
+}
+
+/**
+ * \brief CompressedMeshShape method definitions
+ */
+
+CompressedMeshShape::CompressedMeshShape(const Transform* ObjectToWorld, const Transform* WorldToObject,
+        bool reverseOrientation, std::shared_ptr<const CompressedTriangleMesh> mesh)
+    : Shape(ObjectToWorld, WorldToObject, reverseOrientation), mesh(std::move(mesh)) {}
+
+Bounds3f CompressedMeshShape::ObjectBounds() const {
+    return (*WorldToObject)(mesh->bounds);
+}
+
+Bounds3f CompressedMeshShape::WorldBounds() const {
+    return mesh->bounds;
+}
+
+bool CompressedMeshShape::Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool) const {
+    Ray ray = r;
+    HitRecord hit;
+    int closest = -1;
+    for (int i = 0; i < mesh->nTriangles; ++i) {
+        if (IntersectHit(ray, i, &hit)) {
+            ray.tMax = hit.t;
+            closest = i;
+        }
+    }
+    if (closest < 0) {
+        return false;
+    }
+    ComputeSurfaceInteraction(r, closest, hit, isect);
+    *tHit = hit.t;
+    return true;
+}
+
+bool CompressedMeshShape::IntersectTest(const Ray& r, bool) const {
+    HitRecord hit;
+    for (int i = 0; i < mesh->nTriangles; ++i) {
+        if (IntersectHit(r, i, &hit)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+float CompressedMeshShape::Area() const {
+    float area = 0.0f;
+    for (int i = 0; i < mesh->nTriangles; ++i) {
+        int v[3];
+        mesh->Indices(i, v);
+        Point3f p0 = mesh->P(v[0]);
+        area += 0.5f * Cross(mesh->P(v[1]) - p0, mesh->P(v[2]) - p0).Length();
+    }
+    return area;
+}
+
+Bounds3f CompressedMeshShape::TriangleBounds(int triNumber) const {
+    int v[3];
+    mesh->Indices(triNumber, v);
+    return Union(Bounds3f(mesh->P(v[0]), mesh->P(v[1])), mesh->P(v[2]));
+}
+
+void CompressedMeshShape::ComputeSurfaceInteraction(const Ray& r, int triNumber, const HitRecord& hit,
+        SurfaceInteraction* isect) const {
+    int v[3];
+    mesh->Indices(triNumber, v);
+    Point3f p[3];
+    Normal3f n[3];
+    Point2f uv[3];
+    for (int i = 0; i < 3; ++i) {
+        p[i] = mesh->P(v[i]);
+        if (!mesh->n.empty()) {
+            n[i] = mesh->N(v[i]);
+        }
+        if (!mesh->uv.empty()) {
+            uv[i] = mesh->UV(v[i]);
+        }
+    }
+    TriangleInteraction(this, r, hit, p, mesh->n.empty() ? nullptr : n, mesh->uv.empty() ? nullptr : uv, isect);
+}
+
+HEIMDALL_NAMESPACE_END
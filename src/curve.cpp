@@ -0,0 +1,362 @@
+#include "heimdall/curve.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Curve intersection parameters
+static const int maxCurveDepth = 10;        /// Subdivision levels before a piece is taken as straight
+static const float flatnessWidth = 0.05f;   /// Allowed deviation from straight, relative to the width
+static const float minFlatness = 1e-6f;     /// Floor on the allowed deviation, in object space units
+
+/**
+ * \brief Bezier helper functions
+ */
+
+static Point3f BlossomBezier(const Point3f p[4], float u0, float u1, float u2) {
+    Point3f a[3] = {p[0] * (1 - u0) + p[1] * u0, p[1] * (1 - u0) + p[2] * u0, p[2] * (1 - u0) + p[3] * u0};
+    Point3f b[2] = {a[0] * (1 - u1) + a[1] * u1, a[1] * (1 - u1) + a[2] * u1};
+    return b[0] * (1 - u2) + b[1] * u2;
+}
+
+static void SubdivideBezier(const Point3f cp[4], Point3f cpSplit[7]) {
+    cpSplit[0] = cp[0];
+    cpSplit[1] = (cp[0] + cp[1]) * 0.5f;
+    cpSplit[2] = (cp[0] + cp[1] * 2.0f + cp[2]) * 0.25f;
+    cpSplit[3] = (cp[0] + cp[1] * 3.0f + cp[2] * 3.0f + cp[3]) * 0.125f;
+    cpSplit[4] = (cp[1] + cp[2] * 2.0f + cp[3]) * 0.25f;
+    cpSplit[5] = (cp[2] + cp[3]) * 0.5f;
+    cpSplit[6] = cp[3];
+}
+
+static Point3f EvalBezier(const Point3f cp[4], float u, Vec3f* deriv) {
+    Point3f cp1[3] = {cp[0] * (1 - u) + cp[1] * u, cp[1] * (1 - u) + cp[2] * u, cp[2] * (1 - u) + cp[3] * u};
+    Point3f cp2[2] = {cp1[0] * (1 - u) + cp1[1] * u, cp1[1] * (1 - u) + cp1[2] * u};
+    if ((cp2[1] - cp2[0]).LengthSquared() > 0.0f) {
+        *deriv = (cp2[1] - cp2[0]) * 3.0f;
+    } else {
+        /// Degenerate first control points, fall back to the chord
+        *deriv = cp[3] - cp[0];
+    }
+    return cp2[0] * (1 - u) + cp2[1] * u;
+}
+
+/**
+ * \brief Orthonormal frame with the ray origin at its center and the ray
+ * direction as its z axis
+ */
+
+struct CurveRayFrame {
+    Point3f o;
+    Vec3f x, y, z;
+
+    CurveRayFrame(const Ray& ray, const Point3f cp[4]) : o(ray.o) {
+        /// Orient x and y so the curve chord lies in the xz plane
+        Vec3f up = Cross(ray.d, cp[3] - cp[0]);
+        if (up.LengthSquared() == 0.0f) {
+            Vec3f unused;
+            CoordinateSystem(Normalize(ray.d), &up, &unused);
+        }
+        z = Normalize(ray.d);
+        x = Normalize(Cross(Normalize(up), z));
+        y = Cross(z, x);
+    }
+
+    Point3f ToRay(const Point3f& p) const {
+        Vec3f v = p - o;
+        return Point3f(Dot(v, x), Dot(v, y), Dot(v, z));
+    }
+
+    Vec3f ToRay(const Vec3f& v) const {
+        return Vec3f(Dot(v, x), Dot(v, y), Dot(v, z));
+    }
+
+    Vec3f ToObject(const Vec3f& v) const {
+        return x * v.x + y * v.y + z * v.z;
+    }
+};
+
+/// Ribbon normal at u, spherically interpolated between the end normals
+static Normal3f RibbonNormal(const CurveCommon& common, float u) {
+    if (common.normalAngle == 0.0f) {
+        return common.n[0];
+    }
+    float sin0 = std::sin((1 - u) * common.normalAngle) * common.invSinNormalAngle;
+    float sin1 = std::sin(u * common.normalAngle) * common.invSinNormalAngle;
+    return common.n[0] * sin0 + common.n[1] * sin1;
+}
+
+/**
+ * \brief CurveCommon method definitions
+ */
+
+CurveCommon::CurveCommon(const Point3f c[4], float width0, float width1, CurveType type, const Normal3f* norm,
+        bool orientedBounds)
+    : type(type), normalAngle(0.0f), invSinNormalAngle(0.0f), orientedBounds(orientedBounds) {
+    width[0] = width0;
+    width[1] = width1;
+    for (int i = 0; i < 4; ++i) {
+        cpObj[i] = c[i];
+    }
+    if (norm) {
+        n[0] = Normalize(norm[0]);
+        n[1] = Normalize(norm[1]);
+        normalAngle = std::acos(Clamp(Dot(n[0], n[1]), 0.0f, 1.0f));
+        if (normalAngle > 0.0f) {
+            invSinNormalAngle = 1.0f / std::sin(normalAngle);
+        }
+    }
+}
+
+/**
+ * \brief Curve method definitions
+ */
+
+Curve::Curve(const Transform* ObjectToWorld, const Transform* WorldToObject, bool reverseOrientation,
+        const std::shared_ptr<const CurveCommon>& common, float uMin, float uMax)
+    : Shape(ObjectToWorld, WorldToObject, reverseOrientation), common(common), uMin(uMin), uMax(uMax) {
+    cp[0] = BlossomBezier(common->cpObj, uMin, uMin, uMin);
+    cp[1] = BlossomBezier(common->cpObj, uMin, uMin, uMax);
+    cp[2] = BlossomBezier(common->cpObj, uMin, uMax, uMax);
+    cp[3] = BlossomBezier(common->cpObj, uMax, uMax, uMax);
+
+    /// Box in a frame along the chord, much tighter than any axis aligned
+    /// box for a straight strand lying diagonally
+    if (common->orientedBounds) {
+        Vec3f chord = cp[3] - cp[0];
+        boxAxis[2] = chord.LengthSquared() > 0.0f ? Normalize(chord) : Vec3f(0.0f, 0.0f, 1.0f);
+        CoordinateSystem(boxAxis[2], &boxAxis[0], &boxAxis[1]);
+        for (int i = 0; i < 4; ++i) {
+            Vec3f p(cp[i]);
+            box = Union(box, Point3f(Dot(p, boxAxis[0]), Dot(p, boxAxis[1]), Dot(p, boxAxis[2])));
+        }
+        float maxWidth = std::max(Lerp(uMin, common->width[0], common->width[1]),
+                                  Lerp(uMax, common->width[0], common->width[1]));
+        box = Expand(box, 0.5f * maxWidth);
+    }
+}
+
+Bounds3f Curve::ObjectBounds() const {
+    Bounds3f b = Union(Bounds3f(cp[0], cp[1]), Bounds3f(cp[2], cp[3]));
+    float maxWidth = std::max(Lerp(uMin, common->width[0], common->width[1]),
+                              Lerp(uMax, common->width[0], common->width[1]));
+    return Expand(b, 0.5f * maxWidth);
+}
+
+Bounds3f Curve::WorldBounds() const {
+    /// Bound the world space control points, then grow each axis by the
+    /// extent of the transformed width sphere along it
+    Bounds3f b;
+    for (int i = 0; i < 4; ++i) {
+        b = Union(b, (*ObjectToWorld)(cp[i]));
+    }
+    float radius = 0.5f * std::max(Lerp(uMin, common->width[0], common->width[1]),
+                                   Lerp(uMax, common->width[0], common->width[1]));
+    Vec3f ex = (*ObjectToWorld)(Vec3f(1.0f, 0.0f, 0.0f));
+    Vec3f ey = (*ObjectToWorld)(Vec3f(0.0f, 1.0f, 0.0f));
+    Vec3f ez = (*ObjectToWorld)(Vec3f(0.0f, 0.0f, 1.0f));
+    Vec3f grow(radius * std::sqrt(ex.x * ex.x + ey.x * ey.x + ez.x * ez.x),
+               radius * std::sqrt(ex.y * ex.y + ey.y * ey.y + ez.y * ez.y),
+               radius * std::sqrt(ex.z * ex.z + ey.z * ey.z + ez.z * ez.z));
+    return Bounds3f(b.pMin - grow, b.pMax + grow);
+}
+
+bool Curve::Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool testSurfaceAlpha) const {
+    HitRecord hit;
+    if (!IntersectHit(r, &hit, testSurfaceAlpha)) {
+        return false;
+    }
+    ComputeSurfaceInteraction(r, hit, isect);
+    *tHit = hit.t;
+    return true;
+}
+
+bool Curve::IntersectTest(const Ray& r, bool) const {
+    float t;
+    Point2f uv;
+    return Hit((*WorldToObject)(r), &t, &uv, true);
+}
+
+bool Curve::IntersectHit(const Ray& r, HitRecord* hit, bool) const {
+    float t;
+    Point2f uv;
+    if (!Hit((*WorldToObject)(r), &t, &uv, false)) {
+        return false;
+    }
+    hit->t = t;
+    hit->uv = uv;
+    return true;
+}
+
+float Curve::Area() const {
+    /// Control polygon length times the average width
+    float approxLength = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        approxLength += Distance(cp[i], cp[i + 1]);
+    }
+    float avgWidth = 0.5f * (Lerp(uMin, common->width[0], common->width[1]) +
+                             Lerp(uMax, common->width[0], common->width[1]));
+    return approxLength * avgWidth;
+}
+
+bool Curve::InsideOrientedBounds(const Ray& ray) const {
+    Vec3f o(ray.o);
+    Ray local(Point3f(Dot(o, boxAxis[0]), Dot(o, boxAxis[1]), Dot(o, boxAxis[2])),
+              Vec3f(Dot(ray.d, boxAxis[0]), Dot(ray.d, boxAxis[1]), Dot(ray.d, boxAxis[2])), ray.tMax);
+    float t0, t1;
+    return box.IntersectP(local, &t0, &t1);
+}
+
+bool Curve::Hit(const Ray& ray, float* tHit, Point2f* uv, bool anyHit) const {
+    if (common->orientedBounds and !InsideOrientedBounds(ray)) {
+        return false;
+    }
+
+    /// Project the control points into the ray's frame, the ray is then
+    /// the z axis and a hit is a piece of curve passing close to it
+    CurveRayFrame frame(ray, cp);
+    Point3f cpRay[4];
+    for (int i = 0; i < 4; ++i) {
+        cpRay[i] = frame.ToRay(cp[i]);
+    }
+
+    /// Choose the subdivision depth from how far the curve is from straight
+    float L0 = 0.0f;
+    for (int i = 0; i < 2; ++i) {
+        L0 = std::max(L0, std::max(std::max(std::abs(cpRay[i].x - 2 * cpRay[i + 1].x + cpRay[i + 2].x),
+                                            std::abs(cpRay[i].y - 2 * cpRay[i + 1].y + cpRay[i + 2].y)),
+                                   std::abs(cpRay[i].z - 2 * cpRay[i + 1].z + cpRay[i + 2].z)));
+    }
+    /// Widths are checked by CreateCurve, this only keeps a directly made
+    /// curve without width from dividing by zero below
+    float eps = std::max(std::max(common->width[0], common->width[1]) * flatnessWidth, minFlatness);
+    float depthEstimate = 1.41421356237f * 6.0f * L0 / (8.0f * eps);
+    int maxDepth = depthEstimate > 1.0f ? Clamp(int(std::log2(depthEstimate)) / 2, 0, maxCurveDepth) : 0;
+
+    float rayLength = ray.d.Length();
+    float zMax = rayLength * ray.tMax;
+    if (!RecursiveHit(ray, rayLength, cpRay, uMin, uMax, maxDepth, &zMax, uv, anyHit)) {
+        return false;
+    }
+    *tHit = zMax / rayLength;
+    return true;
+}
+
+bool Curve::RecursiveHit(const Ray& ray, float rayLength, const Point3f cp[4], float u0, float u1, int depth,
+        float* zMax, Point2f* uv, bool anyHit) const {
+    if (depth > 0) {
+        /// Split in two and visit the halves whose bounds reach the ray
+        Point3f cpSplit[7];
+        SubdivideBezier(cp, cpSplit);
+        bool hit = false;
+        float u[3] = {u0, 0.5f * (u0 + u1), u1};
+        const Point3f* cps = cpSplit;
+        for (int seg = 0; seg < 2; ++seg, cps += 3) {
+            float halfWidth = 0.5f * std::max(Lerp(u[seg], common->width[0], common->width[1]),
+                                              Lerp(u[seg + 1], common->width[0], common->width[1]));
+            Bounds3f b = Union(Bounds3f(cps[0], cps[1]), Bounds3f(cps[2], cps[3]));
+            if (b.pMax.x + halfWidth < 0.0f or b.pMin.x - halfWidth > 0.0f or
+                b.pMax.y + halfWidth < 0.0f or b.pMin.y - halfWidth > 0.0f or
+                b.pMax.z + halfWidth < 0.0f or b.pMin.z - halfWidth > *zMax) {
+                continue;
+            }
+            if (RecursiveHit(ray, rayLength, cps, u[seg], u[seg + 1], depth - 1, zMax, uv, anyHit)) {
+                hit = true;
+                if (anyHit) {
+                    return true;
+                }
+            }
+        }
+        return hit;
+    }
+
+    /// The ray must pass between the planes through both end points
+    float edge = (cp[1].y - cp[0].y) * -cp[0].y + cp[0].x * (cp[0].x - cp[1].x);
+    if (edge < 0.0f) {
+        return false;
+    }
+    edge = (cp[2].y - cp[3].y) * -cp[3].y + cp[3].x * (cp[3].x - cp[2].x);
+    if (edge < 0.0f) {
+        return false;
+    }
+
+    /// Closest point on the segment to the ray, in the xy plane
+    Vec2f segmentDirection(cp[3].x - cp[0].x, cp[3].y - cp[0].y);
+    float denom = segmentDirection.LengthSquared();
+    if (denom == 0.0f) {
+        return false;
+    }
+    float w = Dot(Vec2f(-cp[0].x, -cp[0].y), segmentDirection) / denom;
+    float u = Clamp(Lerp(w, u0, u1), u0, u1);
+    float hitWidth = Lerp(u, common->width[0], common->width[1]);
+    if (common->type == CurveType::Ribbon) {
+        /// Ribbons seen edge on get narrower
+        hitWidth *= AbsDot(RibbonNormal(*common, u), ray.d) / rayLength;
+    }
+
+    Vec3f dpcdw;
+    Point3f pc = EvalBezier(cp, Clamp(w, 0.0f, 1.0f), &dpcdw);
+    float ptCurveDist2 = pc.x * pc.x + pc.y * pc.y;
+    if (ptCurveDist2 >= hitWidth * hitWidth * 0.25f) {
+        return false;
+    }
+    if (pc.z < 0.0f or pc.z > *zMax) {
+        return false;
+    }
+
+    /// v runs across the width, 0.5 on the curve itself
+    float ptCurveDist = std::sqrt(ptCurveDist2);
+    float edgeFunc = dpcdw.x * -pc.y + pc.x * dpcdw.y;
+    float v = edgeFunc > 0.0f ? 0.5f + ptCurveDist / hitWidth : 0.5f - ptCurveDist / hitWidth;
+    *zMax = pc.z;
+    *uv = Point2f(u, v);
+    return true;
+}
+
+void Curve::ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const {
+    Ray ray = (*WorldToObject)(r);
+    float u = hit.uv.x, v = hit.uv.y;
+    float hitWidth = Lerp(u, common->width[0], common->width[1]);
+    Vec3f dpdu, dpdv;
+    EvalBezier(common->cpObj, u, &dpdu);
+    if (common->type == CurveType::Ribbon) {
+        Normal3f nHit = RibbonNormal(*common, u);
+        hitWidth *= AbsDot(nHit, ray.d) / ray.d.Length();
+        dpdv = Normalize(Cross(Vec3f(nHit.x, nHit.y, nHit.z), dpdu)) * hitWidth;
+    } else {
+        /// Flat and cylinder curves face the ray, so dpdv lies across it
+        CurveRayFrame frame(ray, cp);
+        Vec3f dpduPlane = frame.ToRay(dpdu);
+        Vec3f dpdvPlane = Normalize(Vec3f(-dpduPlane.y, dpduPlane.x, 0.0f)) * hitWidth;
+        if (common->type == CurveType::Cylinder) {
+            /// Turn dpdv about the curve as if the hit were on a tube
+            float theta = Lerp(v, -90.0f, 90.0f);
+            dpdvPlane = Rotate(-theta, dpduPlane)(dpdvPlane);
+        }
+        dpdv = frame.ToObject(dpdvPlane);
+    }
+    *isect = (*ObjectToWorld)(SurfaceInteraction(ray(hit.t), Vec3f(), hit.uv, -ray.d, dpdu, dpdv, Normal3f(),
+        Normal3f(), ray.time, this));
+}
+
+std::vector<std::shared_ptr<Shape>> CreateCurve(const Transform* ObjectToWorld, const Transform* WorldToObject,
+        bool reverseOrientation, const Point3f c[4], float width0, float width1, CurveType type,
+        const Normal3f* norm, int nSegments, bool orientedBounds) {
+    if (!(width0 >= 0.0f and width1 >= 0.0f and std::max(width0, width1) > 0.0f)) {
+        return std::vector<std::shared_ptr<Shape>>();
+    }
+    if (type == CurveType::Ribbon and !norm) {
+        return std::vector<std::shared_ptr<Shape>>();
+    }
+    std::shared_ptr<const CurveCommon> common = std::make_shared<CurveCommon>(c, width0, width1, type, norm,
+        orientedBounds);
+    std::vector<std::shared_ptr<Shape>> segments;
+    segments.reserve(nSegments);
+    for (int i = 0; i < nSegments; ++i) {
+        float uMin = float(i) / float(nSegments);
+        float uMax = float(i + 1) / float(nSegments);
+        segments.push_back(std::make_shared<Curve>(ObjectToWorld, WorldToObject, reverseOrientation, common,
+            uMin, uMax));
+    }
+    return segments;
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,292 @@
+#include "heimdall/film.h"
+#include "heimdall/parallel.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Film parameters
+static const int filterTableWidth = 16;     /// Filter table entries per axis over one radius
+static const int maxRowLocks = 256;         /// Rows share a lock beyond this many
+static const float minErrorMean = 0.01f;    /// Darker pixels are judged on absolute error
+
+/**
+ * \brief FilmTile method definitions
+ */
+
+FilmTile::FilmTile(const Vec2f& filterRadius, const float* filterTable, int filterTableWidth, int pixelCapacity,
+                   const AOVLayout* aovLayout)
+    : filterRadius(filterRadius), invFilterRadius(1.0f / filterRadius.x, 1.0f / filterRadius.y),
+      filterTable(filterTable), filterTableWidth(filterTableWidth), aovLayout(aovLayout),
+      ifx(2 * int(std::ceil(filterRadius.x)) + 1), ify(2 * int(std::ceil(filterRadius.y)) + 1) {
+    pixels.reserve(pixelCapacity);
+    aovPixels.reserve(size_t(pixelCapacity) * aovLayout->nFloats);
+}
+
+void FilmTile::Reset(const Bounds2i& bounds) {
+    /// Assigning within the reserved capacity never allocates
+    pixelBounds = bounds;
+    pixels.assign(std::max(0, bounds.SurfaceArea()), FilmTilePixel());
+    aovPixels.assign(pixels.size() * aovLayout->nFloats, 0.0f);
+}
+
+void FilmTile::AddSample(const Point2f& pFilm, const RGB& L, float sampleWeight) {
+    Point2i pPixel(int(std::floor(pFilm.x)), int(std::floor(pFilm.y)));
+    if (InsideExclusive(pPixel, pixelBounds)) {
+        int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+        pixels[(pPixel.y - pixelBounds.pMin.y) * width + (pPixel.x - pixelBounds.pMin.x)].variance.Add(Luminance(L));
+    }
+
+    /// Pixels whose centers lie within the filter radius of the sample
+    float dx = pFilm.x - 0.5f, dy = pFilm.y - 0.5f;
+    int x0 = std::max(int(std::ceil(dx - filterRadius.x)), pixelBounds.pMin.x);
+    int y0 = std::max(int(std::ceil(dy - filterRadius.y)), pixelBounds.pMin.y);
+    int x1 = std::min(int(std::floor(dx + filterRadius.x)) + 1, pixelBounds.pMax.x);
+    int y1 = std::min(int(std::floor(dy + filterRadius.y)) + 1, pixelBounds.pMax.y);
+    if (x0 >= x1 or y0 >= y1) {
+        return;
+    }
+
+    /// Filter table offsets are computed once per column and per row,
+    /// the scratch arrays hold the widest footprint of the radius
+    for (int x = x0; x < x1; ++x) {
+        float fx = std::abs((x - dx) * invFilterRadius.x * filterTableWidth);
+        ifx[x - x0] = std::min(int(fx), filterTableWidth - 1);
+    }
+    for (int y = y0; y < y1; ++y) {
+        float fy = std::abs((y - dy) * invFilterRadius.y * filterTableWidth);
+        ify[y - y0] = std::min(int(fy), filterTableWidth - 1);
+    }
+
+    int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    for (int y = y0; y < y1; ++y) {
+        FilmTilePixel* row = pixels.data() + (y - pixelBounds.pMin.y) * width;
+        for (int x = x0; x < x1; ++x) {
+            float filterWeight = filterTable[ify[y - y0] * filterTableWidth + ifx[x - x0]];
+            FilmTilePixel& pixel = row[x - pixelBounds.pMin.x];
+            pixel.contribSum += L * (sampleWeight * filterWeight);
+            pixel.filterWeightSum += filterWeight;
+        }
+    }
+}
+
+void FilmTile::AddAOVSample(const Point2f& pFilm, const AOVSample& sample) {
+    Point2i pPixel(int(std::floor(pFilm.x)), int(std::floor(pFilm.y)));
+    if (aovLayout->nFloats == 0 or !InsideExclusive(pPixel, pixelBounds)) {
+        return;
+    }
+    int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    int index = (pPixel.y - pixelBounds.pMin.y) * width + (pPixel.x - pixelBounds.pMin.x);
+    aovLayout->Accumulate(&aovPixels[size_t(index) * aovLayout->nFloats], sample);
+}
+
+const FilmTilePixel& FilmTile::GetPixel(const Point2i& p) const {
+    int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    return pixels[(p.y - pixelBounds.pMin.y) * width + (p.x - pixelBounds.pMin.x)];
+}
+
+Bounds2i FilmTile::GetPixelBounds() const {
+    return pixelBounds;
+}
+
+/**
+ * \brief Film method definitions
+ */
+
+Film::Film(const Point2i& resolution, std::unique_ptr<Filter> filt, int maxTileSize, int nPooledTiles,
+           const AOVLayout& aovLayout)
+    : fullResolution(resolution), pixelBounds(Point2i(0, 0), resolution), aovLayout(aovLayout),
+      filter(std::move(filt)), pixels(resolution.x * resolution.y),
+      aovPixels(size_t(resolution.x) * resolution.y * aovLayout.nFloats),
+      rowLocks(std::max(1, std::min(resolution.y, maxRowLocks))) {
+    /// Tabulate one quadrant of the filter, it is symmetric
+    filterTable.resize(filterTableWidth * filterTableWidth);
+    for (int y = 0; y < filterTableWidth; ++y) {
+        for (int x = 0; x < filterTableWidth; ++x) {
+            Point2f p((x + 0.5f) * filter->radius.x / filterTableWidth,
+                      (y + 0.5f) * filter->radius.y / filterTableWidth);
+            filterTable[y * filterTableWidth + x] = filter->Evaluate(p);
+        }
+    }
+
+    /// A tile of maxTileSize samples reaches one radius beyond them on each side
+    int padX = 2 * int(std::ceil(filter->radius.x)) + 1;
+    int padY = 2 * int(std::ceil(filter->radius.y)) + 1;
+    tileCapacity = (maxTileSize + padX) * (maxTileSize + padY);
+    if (nPooledTiles <= 0) {
+        nPooledTiles = 2 * MaxThreadIndex();
+    }
+    for (int i = 0; i < nPooledTiles; ++i) {
+        tilePool.push_back(std::unique_ptr<FilmTile>(new FilmTile(filter->radius, filterTable.data(),
+            filterTableWidth, tileCapacity, &this->aovLayout)));
+        freeTiles.push_back(tilePool.back().get());
+    }
+}
+
+Bounds2i Film::GetSampleBounds() const {
+    return Bounds2i(Point2i(int(std::floor(0.5f - filter->radius.x)), int(std::floor(0.5f - filter->radius.y))),
+                    Point2i(int(std::ceil(fullResolution.x - 0.5f + filter->radius.x)),
+                            int(std::ceil(fullResolution.y - 0.5f + filter->radius.y))));
+}
+
+Vec2f Film::GetFilterRadius() const {
+    return filter->radius;
+}
+
+FilmTile* Film::GetFilmTile(const Bounds2i& sampleBounds) {
+    /// Pad the sample region by the filter radius, clipped to the image
+    Point2i p0(int(std::ceil(sampleBounds.pMin.x - 0.5f - filter->radius.x)),
+               int(std::ceil(sampleBounds.pMin.y - 0.5f - filter->radius.y)));
+    Point2i p1(int(std::floor(sampleBounds.pMax.x - 0.5f + filter->radius.x)) + 1,
+               int(std::floor(sampleBounds.pMax.y - 0.5f + filter->radius.y)) + 1);
+    Bounds2i tileBounds;
+    tileBounds.pMin = Point2i(std::max(p0.x, pixelBounds.pMin.x), std::max(p0.y, pixelBounds.pMin.y));
+    tileBounds.pMax = Point2i(std::max(tileBounds.pMin.x, std::min(p1.x, pixelBounds.pMax.x)),
+                              std::max(tileBounds.pMin.y, std::min(p1.y, pixelBounds.pMax.y)));
+
+    FilmTile* tile;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (freeTiles.empty()) {
+            /// More tiles in flight than pooled, grow the pool for good
+            tilePool.push_back(std::unique_ptr<FilmTile>(new FilmTile(filter->radius, filterTable.data(),
+                filterTableWidth, tileCapacity, &this->aovLayout)));
+            freeTiles.push_back(tilePool.back().get());
+        }
+        tile = freeTiles.back();
+        freeTiles.pop_back();
+    }
+    tile->Reset(tileBounds);
+    return tile;
+}
+
+void Film::MergeFilmTile(FilmTile* tile) {
+    const Bounds2i& bounds = tile->pixelBounds;
+    int width = bounds.pMax.x - bounds.pMin.x;
+    for (int y = bounds.pMin.y; y < bounds.pMax.y; ++y) {
+        std::lock_guard<std::mutex> lock(rowLocks[y % rowLocks.size()]);
+        const FilmTilePixel* tileRow = &tile->pixels[(y - bounds.pMin.y) * width];
+        Pixel* filmRow = &pixels[y * fullResolution.x + bounds.pMin.x];
+        for (int x = 0; x < width; ++x) {
+            filmRow[x].rgb[0] += tileRow[x].contribSum.x;
+            filmRow[x].rgb[1] += tileRow[x].contribSum.y;
+            filmRow[x].rgb[2] += tileRow[x].contribSum.z;
+            filmRow[x].filterWeightSum += tileRow[x].filterWeightSum;
+            filmRow[x].variance.Merge(tileRow[x].variance);
+        }
+        int nFloats = aovLayout.nFloats;
+        for (int x = 0; x < width and nFloats > 0; ++x) {
+            aovLayout.Merge(&aovPixels[(size_t(y) * fullResolution.x + bounds.pMin.x + x) * nFloats],
+                            &tile->aovPixels[(size_t(y - bounds.pMin.y) * width + x) * nFloats]);
+        }
+    }
+    std::lock_guard<std::mutex> lock(poolMutex);
+    freeTiles.push_back(tile);
+}
+
+RGB Film::GetPixel(const Point2i& p) const {
+    const Pixel& pixel = pixels[p.y * fullResolution.x + p.x];
+    if (pixel.filterWeightSum == 0.0f) {
+        return RGB();
+    }
+    float invWeight = 1.0f / pixel.filterWeightSum;
+    return RGB(pixel.rgb[0] * invWeight, pixel.rgb[1] * invWeight, pixel.rgb[2] * invWeight);
+}
+
+const VarianceEstimator& Film::GetPixelVariance(const Point2i& p) const {
+    return pixels[p.y * fullResolution.x + p.x].variance;
+}
+
+float Film::RegionError(const Bounds2i& region) const {
+    float error = 0.0f;
+    for (int y = std::max(region.pMin.y, 0); y < std::min(region.pMax.y, fullResolution.y); ++y) {
+        for (int x = std::max(region.pMin.x, 0); x < std::min(region.pMax.x, fullResolution.x); ++x) {
+            error = std::max(error, pixels[y * fullResolution.x + x].variance.RelativeError(minErrorMean));
+        }
+    }
+    return error;
+}
+
+float Film::MeanError(const Bounds2i& region) const {
+    double errorSum = 0.0;
+    int64_t nPixels = 0;
+    for (int y = std::max(region.pMin.y, 0); y < std::min(region.pMax.y, fullResolution.y); ++y) {
+        for (int x = std::max(region.pMin.x, 0); x < std::min(region.pMax.x, fullResolution.x); ++x) {
+            errorSum += pixels[y * fullResolution.x + x].variance.RelativeError(minErrorMean);
+            ++nPixels;
+        }
+    }
+    return nPixels > 0 ? float(errorSum / nPixels) : 0.0f;
+}
+
+std::vector<RGB> Film::GetImage() const {
+    std::vector<RGB> image;
+    image.reserve(pixels.size());
+    for (int y = 0; y < fullResolution.y; ++y) {
+        std::lock_guard<std::mutex> lock(rowLocks[y % rowLocks.size()]);
+        for (int x = 0; x < fullResolution.x; ++x) {
+            image.push_back(GetPixel(Point2i(x, y)));
+        }
+    }
+    return image;
+}
+
+void Film::GetRegion(const Bounds2i& region, float* rgb) const {
+    for (int y = region.pMin.y; y < region.pMax.y; ++y) {
+        std::lock_guard<std::mutex> lock(rowLocks[y % rowLocks.size()]);
+        for (int x = region.pMin.x; x < region.pMax.x; ++x) {
+            RGB pixel = GetPixel(Point2i(x, y));
+            *rgb++ = pixel.x;
+            *rgb++ = pixel.y;
+            *rgb++ = pixel.z;
+        }
+    }
+}
+
+void Film::GetAOVRegion(const Bounds2i& region, float* values) const {
+    int nFloats = aovLayout.nFloats;
+    if (nFloats == 0) {
+        return;
+    }
+    for (int y = region.pMin.y; y < region.pMax.y; ++y) {
+        std::lock_guard<std::mutex> lock(rowLocks[y % rowLocks.size()]);
+        for (int x = region.pMin.x; x < region.pMax.x; ++x) {
+            aovLayout.Resolve(&aovPixels[(size_t(y) * fullResolution.x + x) * nFloats], values);
+            values += aovLayout.nChannels;
+        }
+    }
+}
+
+std::vector<std::string> Film::GetChannelNames() const {
+    std::vector<std::string> names = {"R", "G", "B"};
+    std::vector<std::string> aovNames = aovLayout.ChannelNames();
+    names.insert(names.end(), aovNames.begin(), aovNames.end());
+    return names;
+}
+
+void Film::GetChannelRegion(const Bounds2i& region, float* values) const {
+    int nFloats = aovLayout.nFloats;
+    for (int y = region.pMin.y; y < region.pMax.y; ++y) {
+        std::lock_guard<std::mutex> lock(rowLocks[y % rowLocks.size()]);
+        for (int x = region.pMin.x; x < region.pMax.x; ++x) {
+            RGB pixel = GetPixel(Point2i(x, y));
+            *values++ = pixel.x;
+            *values++ = pixel.y;
+            *values++ = pixel.z;
+            if (nFloats > 0) {
+                aovLayout.Resolve(&aovPixels[(size_t(y) * fullResolution.x + x) * nFloats], values);
+                values += aovLayout.nChannels;
+            }
+        }
+    }
+}
+
+void Film::Clear() {
+    std::fill(pixels.begin(), pixels.end(), Pixel());
+    std::fill(aovPixels.begin(), aovPixels.end(), 0.0f);
+}
+
+int Film::PooledTileCount() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return int(tilePool.size());
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,38 @@
+#include "heimdall/filter.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief Filter method definitions
+ */
+
+Filter::Filter(const Vec2f& radius) : radius(radius), invRadius(1.0f / radius.x, 1.0f / radius.y) {}
+
+Filter::~Filter() {}
+
+BoxFilter::BoxFilter(const Vec2f& radius) : Filter(radius) {}
+
+float BoxFilter::Evaluate(const Point2f&) const {
+    return 1.0f;
+}
+
+TriangleFilter::TriangleFilter(const Vec2f& radius) : Filter(radius) {}
+
+float TriangleFilter::Evaluate(const Point2f& p) const {
+    return std::max(0.0f, radius.x - std::abs(p.x)) * std::max(0.0f, radius.y - std::abs(p.y));
+}
+
+GaussianFilter::GaussianFilter(const Vec2f& radius, float alpha)
+    : Filter(radius), alpha(alpha), expX(std::exp(-alpha * radius.x * radius.x)),
+      expY(std::exp(-alpha * radius.y * radius.y)) {}
+
+float GaussianFilter::Evaluate(const Point2f& p) const {
+    return Gaussian(p.x, expX) * Gaussian(p.y, expY);
+}
+
+float GaussianFilter::Gaussian(float d, float expv) const {
+    /// Shifted down so the filter reaches zero at its radius
+    return std::max(0.0f, std::exp(-alpha * d * d) - expv);
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,422 @@
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "heimdall/imageio.h"
+#include "heimdall/film.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Image output parameters
+static const uint32_t exrMagic = 20000630;          /// First four bytes of every EXR file
+static const uint32_t exrTiledVersion = 2 | 0x200;  /// Format version 2, single part, tiled
+static const int exrTileHeaderSize = 20;            /// Tile coordinates, levels and data size
+static const int exrPixelTypeFloat = 2;
+
+/**
+ * \brief Little endian encoding of EXR data
+ */
+
+static void AppendUInt32(std::vector<char>* out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        out->push_back(char((v >> (8 * i)) & 0xff));
+    }
+}
+
+static void AppendUInt64(std::vector<char>* out, uint64_t v) {
+    AppendUInt32(out, uint32_t(v));
+    AppendUInt32(out, uint32_t(v >> 32));
+}
+
+static void AppendFloat(std::vector<char>* out, float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    AppendUInt32(out, bits);
+}
+
+static void AppendString(std::vector<char>* out, const std::string& s) {
+    out->insert(out->end(), s.begin(), s.end());
+    out->push_back('\0');
+}
+
+static void AppendAttribute(std::vector<char>* out, const std::string& name, const std::string& type,
+                            const std::vector<char>& value) {
+    AppendString(out, name);
+    AppendString(out, type);
+    AppendUInt32(out, uint32_t(value.size()));
+    out->insert(out->end(), value.begin(), value.end());
+}
+
+static void StoreUInt32(char* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        p[i] = char((v >> (8 * i)) & 0xff);
+    }
+}
+
+static void StoreFloat(char* p, float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    StoreUInt32(p, bits);
+}
+
+/// Header of a single part, uncompressed, one level tiled EXR file
+static std::vector<char> ExrHeader(const Point2i& resolution, const std::vector<std::string>& sortedNames,
+                                   int tileSize) {
+    std::vector<char> header;
+    AppendUInt32(&header, exrMagic);
+    AppendUInt32(&header, exrTiledVersion);
+
+    std::vector<char> value;
+    for (const std::string& name : sortedNames) {
+        AppendString(&value, name);
+        AppendUInt32(&value, exrPixelTypeFloat);
+        AppendUInt32(&value, 0);            /// pLinear and reserved bytes
+        AppendUInt32(&value, 1);            /// x and y sampling
+        AppendUInt32(&value, 1);
+    }
+    value.push_back('\0');
+    AppendAttribute(&header, "channels", "chlist", value);
+    AppendAttribute(&header, "compression", "compression", std::vector<char>(1, 0));
+
+    value.clear();
+    AppendUInt32(&value, 0);
+    AppendUInt32(&value, 0);
+    AppendUInt32(&value, uint32_t(resolution.x - 1));
+    AppendUInt32(&value, uint32_t(resolution.y - 1));
+    AppendAttribute(&header, "dataWindow", "box2i", value);
+    AppendAttribute(&header, "displayWindow", "box2i", value);
+
+    /// Tiles are stored in increasing y, then x, order
+    AppendAttribute(&header, "lineOrder", "lineOrder", std::vector<char>(1, 0));
+    value.clear();
+    AppendFloat(&value, 1.0f);
+    AppendAttribute(&header, "pixelAspectRatio", "float", value);
+    value.clear();
+    AppendFloat(&value, 0.0f);
+    AppendFloat(&value, 0.0f);
+    AppendAttribute(&header, "screenWindowCenter", "v2f", value);
+    value.clear();
+    AppendFloat(&value, 1.0f);
+    AppendAttribute(&header, "screenWindowWidth", "float", value);
+
+    value.clear();
+    AppendUInt32(&value, uint32_t(tileSize));
+    AppendUInt32(&value, uint32_t(tileSize));
+    value.push_back(0);                     /// One level, rounding down
+    AppendAttribute(&header, "tiles", "tiledesc", value);
+    header.push_back('\0');
+    return header;
+}
+
+static bool WriteAll(int fd, const char* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t written = pwrite(fd, data, size, off_t(offset));
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= size_t(written);
+        offset += uint64_t(written);
+    }
+    return true;
+}
+
+/**
+ * \brief Image output function definitions
+ */
+
+ImageFormat ImageFormatFromFilename(const std::string& filename) {
+    size_t dot = filename.find_last_of('.');
+    if (dot != std::string::npos) {
+        std::string extension = filename.substr(dot + 1);
+        for (char& c : extension) {
+            c = char(std::tolower(c));
+        }
+        if (extension == "pfm") {
+            return ImageFormat::PFM;
+        }
+    }
+    return ImageFormat::EXR;
+}
+
+bool WriteImage(const Film& film, const std::string& filename) {
+    /// EXR takes the AOVs along, PFM only has room for RGB
+    const Point2i& resolution = film.fullResolution;
+    std::vector<std::string> names = film.GetChannelNames();
+    if (ImageFormatFromFilename(filename) == ImageFormat::PFM) {
+        names.resize(3);
+    }
+    std::unique_ptr<TiledImageWriter> writer = TiledImageWriter::Create(filename, resolution, names);
+    if (!writer) {
+        return false;
+    }
+    /// Bands one tile high complete every tile they touch
+    int bandHeight = writer->tileSize;
+    std::vector<float> band(names.size() * resolution.x * bandHeight);
+    for (int y = 0; y < resolution.y; y += bandHeight) {
+        Bounds2i region(Point2i(0, y), Point2i(resolution.x, std::min(y + bandHeight, resolution.y)));
+        if (names.size() == 3) {
+            film.GetRegion(region, band.data());
+        } else {
+            film.GetChannelRegion(region, band.data());
+        }
+        writer->WriteRegion(region, band.data());
+    }
+    return writer->Close();
+}
+
+/**
+ * \brief TiledImageWriter method definitions
+ */
+
+std::unique_ptr<TiledImageWriter> TiledImageWriter::Create(const std::string& filename, const Point2i& resolution,
+                                                           const std::vector<std::string>& channelNames,
+                                                           int tileSize, size_t maxQueuedBytes) {
+    ImageFormat format = ImageFormatFromFilename(filename);
+    int nChannels = int(channelNames.size());
+    if (resolution.x <= 0 or resolution.y <= 0 or nChannels == 0 or tileSize <= 0 or
+        (format == ImageFormat::PFM and nChannels != 1 and nChannels != 3)) {
+        return nullptr;
+    }
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return nullptr;
+    }
+    std::unique_ptr<TiledImageWriter> writer(new TiledImageWriter(fd, resolution, format, nChannels, tileSize,
+                                                                  maxQueuedBytes));
+
+    std::vector<char> header;
+    uint64_t fileSize;
+    if (format == ImageFormat::EXR) {
+        /// EXR stores channels sorted by name
+        std::vector<int>& order = writer->channelOrder;
+        for (int c = 0; c < nChannels; ++c) {
+            order.push_back(c);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return channelNames[a] < channelNames[b];
+        });
+        std::vector<std::string> sortedNames;
+        for (int c : order) {
+            sortedNames.push_back(channelNames[c]);
+        }
+        header = ExrHeader(resolution, sortedNames, tileSize);
+
+        /// Every tile's place follows from the sizes of the ones before it,
+        /// so the offset table is final before any pixel is rendered
+        int nTilesTotal = writer->nTiles.x * writer->nTiles.y;
+        uint64_t offset = header.size() + 8 * uint64_t(nTilesTotal);
+        for (int i = 0; i < nTilesTotal; ++i) {
+            writer->tileOffsets.push_back(offset);
+            AppendUInt64(&header, offset);
+            offset += exrTileHeaderSize + uint64_t(writer->TileBounds(i).SurfaceArea()) * nChannels * 4;
+        }
+        fileSize = offset;
+    } else {
+        /// Scale -1 marks little endian data, PFM rows run bottom to top
+        uint32_t one = 1;
+        bool littleEndian = *reinterpret_cast<char*>(&one) == 1;
+        std::string text = std::string(nChannels == 3 ? "PF" : "Pf") + "\n" + std::to_string(resolution.x) +
+                           " " + std::to_string(resolution.y) + "\n" + (littleEndian ? "-1.0" : "1.0") + "\n";
+        header.assign(text.begin(), text.end());
+        writer->pixelOffset = header.size();
+        fileSize = header.size() + uint64_t(resolution.x) * resolution.y * nChannels * 4;
+    }
+
+    /// Sizing the file up front leaves zeros wherever nothing is written
+    if (!WriteAll(fd, header.data(), header.size(), 0) or ftruncate(fd, off_t(fileSize)) != 0) {
+        writer->Close();
+        std::remove(filename.c_str());
+        return nullptr;
+    }
+    return writer;
+}
+
+TiledImageWriter::TiledImageWriter(int fd, const Point2i& resolution, ImageFormat format, int nChannels,
+                                   int tileSize, size_t maxQueuedBytes)
+    : resolution(resolution), format(format), nChannels(nChannels), tileSize(tileSize), fd(fd),
+      nTiles((resolution.x + tileSize - 1) / tileSize, (resolution.y + tileSize - 1) / tileSize),
+      pixelOffset(0), maxQueuedBytes(maxQueuedBytes), queuedBytes(0), closing(false), failed(false) {
+    if (format == ImageFormat::EXR) {
+        tileDone.resize(nTiles.x * nTiles.y, false);
+    }
+    ioThread = std::thread(&TiledImageWriter::IOLoop, this);
+}
+
+TiledImageWriter::~TiledImageWriter() {
+    Close();
+}
+
+void TiledImageWriter::WriteRegion(const Bounds2i& region, const float* pixels) {
+    Bounds2i clipped = Intersect(region, Bounds2i(Point2i(0, 0), resolution));
+    if (clipped.pMin.x >= clipped.pMax.x or clipped.pMin.y >= clipped.pMax.y) {
+        return;
+    }
+    int regionWidth = region.pMax.x - region.pMin.x;
+    auto regionPixel = [&](int x, int y) {
+        return pixels + (int64_t(y - region.pMin.y) * regionWidth + (x - region.pMin.x)) * nChannels;
+    };
+
+    if (format == ImageFormat::PFM) {
+        /// Each row of the region is one contiguous run of the file
+        size_t rowBytes = size_t(clipped.pMax.x - clipped.pMin.x) * nChannels * sizeof(float);
+        for (int y = clipped.pMin.y; y < clipped.pMax.y; ++y) {
+            Chunk chunk;
+            chunk.offset = pixelOffset + (uint64_t(resolution.y - 1 - y) * resolution.x + clipped.pMin.x) *
+                                             nChannels * sizeof(float);
+            const char* row = reinterpret_cast<const char*>(regionPixel(clipped.pMin.x, y));
+            chunk.bytes.assign(row, row + rowBytes);
+            Enqueue(std::move(chunk));
+        }
+        return;
+    }
+
+    /// Scatter the region into the tiles it overlaps, tiles it completes
+    /// are queued once the pending tiles are unlocked
+    std::vector<Chunk> finished;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        for (int ty = clipped.pMin.y / tileSize; ty <= (clipped.pMax.y - 1) / tileSize; ++ty) {
+            for (int tx = clipped.pMin.x / tileSize; tx <= (clipped.pMax.x - 1) / tileSize; ++tx) {
+                int tileIndex = ty * nTiles.x + tx;
+                Bounds2i tileBounds = TileBounds(tileIndex);
+                Bounds2i overlap = Intersect(tileBounds, clipped);
+                PendingTile& tile = GetPendingTile(tileIndex);
+                int tileWidth = tileBounds.pMax.x - tileBounds.pMin.x;
+                for (int y = overlap.pMin.y; y < overlap.pMax.y; ++y) {
+                    /// A tile scanline holds each channel's values in turn
+                    char* line = tile.bytes.data() + exrTileHeaderSize +
+                                 size_t(y - tileBounds.pMin.y) * tileWidth * nChannels * 4;
+                    for (int c = 0; c < nChannels; ++c) {
+                        char* out = line + (size_t(c) * tileWidth + (overlap.pMin.x - tileBounds.pMin.x)) * 4;
+                        const float* in = regionPixel(overlap.pMin.x, y) + channelOrder[c];
+                        for (int x = overlap.pMin.x; x < overlap.pMax.x; ++x, out += 4, in += nChannels) {
+                            StoreFloat(out, *in);
+                        }
+                    }
+                }
+                tile.remainingPixels -= overlap.SurfaceArea();
+                if (tile.remainingPixels <= 0) {
+                    Chunk chunk;
+                    chunk.offset = tileOffsets[tileIndex];
+                    chunk.bytes = std::move(tile.bytes);
+                    finished.push_back(std::move(chunk));
+                    pendingTiles.erase(tileIndex);
+                    tileDone[tileIndex] = true;
+                }
+            }
+        }
+    }
+    for (Chunk& chunk : finished) {
+        Enqueue(std::move(chunk));
+    }
+}
+
+size_t TiledImageWriter::PendingBytes() const {
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    size_t bytes = 0;
+    for (const std::pair<const int, PendingTile>& tile : pendingTiles) {
+        bytes += tile.second.bytes.size();
+    }
+    return bytes;
+}
+
+bool TiledImageWriter::Close() {
+    if (fd < 0) {
+        return !failed;
+    }
+
+    /// Tiles never completed go out with zeros for their missing pixels
+    if (format == ImageFormat::EXR) {
+        std::vector<Chunk> remaining;
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            for (int i = 0; i < int(tileDone.size()); ++i) {
+                if (!tileDone[i]) {
+                    Chunk chunk;
+                    chunk.offset = tileOffsets[i];
+                    chunk.bytes = std::move(GetPendingTile(i).bytes);
+                    remaining.push_back(std::move(chunk));
+                    tileDone[i] = true;
+                }
+            }
+            pendingTiles.clear();
+        }
+        for (Chunk& chunk : remaining) {
+            Enqueue(std::move(chunk));
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        closing = true;
+    }
+    chunkReady.notify_all();
+    ioThread.join();
+    if (close(fd) != 0) {
+        failed = true;
+    }
+    fd = -1;
+    return !failed;
+}
+
+Bounds2i TiledImageWriter::TileBounds(int tileIndex) const {
+    Point2i pMin((tileIndex % nTiles.x) * tileSize, (tileIndex / nTiles.x) * tileSize);
+    return Bounds2i(pMin, Point2i(std::min(pMin.x + tileSize, resolution.x),
+                                  std::min(pMin.y + tileSize, resolution.y)));
+}
+
+TiledImageWriter::PendingTile& TiledImageWriter::GetPendingTile(int tileIndex) {
+    std::map<int, PendingTile>::iterator it = pendingTiles.find(tileIndex);
+    if (it != pendingTiles.end()) {
+        return it->second;
+    }
+    Bounds2i bounds = TileBounds(tileIndex);
+    int area = bounds.SurfaceArea();
+    PendingTile& tile = pendingTiles[tileIndex];
+    tile.remainingPixels = area;
+    tile.bytes.assign(exrTileHeaderSize + size_t(area) * nChannels * 4, 0);
+    StoreUInt32(&tile.bytes[0], uint32_t(tileIndex % nTiles.x));
+    StoreUInt32(&tile.bytes[4], uint32_t(tileIndex / nTiles.x));
+    StoreUInt32(&tile.bytes[16], uint32_t(area * nChannels * 4));
+    return tile;
+}
+
+void TiledImageWriter::Enqueue(Chunk chunk) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    /// A chunk larger than the whole limit still goes through on its own
+    spaceReady.wait(lock, [&]() {
+        return queuedBytes == 0 or queuedBytes + chunk.bytes.size() <= maxQueuedBytes;
+    });
+    queuedBytes += chunk.bytes.size();
+    queue.push_back(std::move(chunk));
+    chunkReady.notify_one();
+}
+
+void TiledImageWriter::IOLoop() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while (true) {
+        chunkReady.wait(lock, [&]() {
+            return !queue.empty() or closing;
+        });
+        if (queue.empty()) {
+            return;
+        }
+        Chunk chunk = std::move(queue.front());
+        queue.pop_front();
+
+        /// Queued bytes count until written, so the bound covers the write
+        /// in flight too
+        lock.unlock();
+        bool written = WriteAll(fd, chunk.bytes.data(), chunk.bytes.size(), chunk.offset);
+        lock.lock();
+        queuedBytes -= chunk.bytes.size();
+        failed = failed or !written;
+        spaceReady.notify_all();
+    }
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,137 @@
+#include "heimdall/instance.h"
+#include "heimdall/interaction.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief Instance method definitions
+ */
+
+Instance::Instance(std::shared_ptr<const BVHAccel> blas, const Transform& InstanceToWorld)
+    : blas(std::move(blas)), InstanceToWorld(InstanceToWorld), WorldToInstance(Inverse(InstanceToWorld)) {}
+
+Bounds3f Instance::WorldBound() const {
+    return InstanceToWorld(blas->WorldBound());
+}
+
+bool Instance::Intersect(const Ray& r, SurfaceInteraction* isect) const {
+    HitRecord hit;
+    if (!Intersect(r, &hit)) {
+        return false;
+    }
+    ComputeSurfaceInteraction(r, hit, isect);
+    return true;
+}
+
+bool Instance::Intersect(const Ray& r, HitRecord* hit) const {
+    /// Transform ray into the object space of the shared BVH, the ray
+    /// parameterization is unchanged so tMax carries over directly
+    Ray ray = WorldToInstance(r);
+    if (!blas->Intersect(ray, hit)) {
+        return false;
+    }
+    r.tMax = ray.tMax;
+    return true;
+}
+
+void Instance::ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const {
+    blas->ComputeSurfaceInteraction(WorldToInstance(r), hit, isect);
+    *isect = InstanceToWorld(*isect);
+}
+
+bool Instance::IntersectP(const Ray& r) const {
+    return blas->IntersectP(WorldToInstance(r));
+}
+
+bool Instance::IntersectP(const Ray& r, OcclusionCache* cache, int light) const {
+    return blas->IntersectP(WorldToInstance(r), cache, light);
+}
+
+/**
+ * \brief InstanceAccel method definitions
+ */
+
+InstanceAccel::InstanceAccel(std::vector<Instance> instances, int maxPrimsInNode, SplitMethod splitMethod)
+    : instances(std::move(instances)) {
+    std::vector<BVHPrimitiveInfo> primitiveInfo(this->instances.size());
+    for (size_t i = 0; i < this->instances.size(); ++i) {
+        primitiveInfo[i] = BVHPrimitiveInfo(i, this->instances[i].WorldBound());
+    }
+    bvh = BVH(std::move(primitiveInfo), maxPrimsInNode, splitMethod);
+}
+
+Bounds3f InstanceAccel::WorldBound() const {
+    return bvh.WorldBound();
+}
+
+bool InstanceAccel::Intersect(const Ray& r, SurfaceInteraction* isect) const {
+    HitRecord hit;
+    if (!Intersect(r, &hit)) {
+        return false;
+    }
+    ComputeSurfaceInteraction(r, hit, isect);
+    return true;
+}
+
+bool InstanceAccel::Intersect(const Ray& r, HitRecord* hit) const {
+    return bvh.Intersect(r, [&](int index) {
+        if (!instances[index].Intersect(r, hit)) {
+            return false;
+        }
+        hit->instanceID = index;
+        return true;
+    });
+}
+
+void InstanceAccel::Intersect(const Ray* rays, int nRays, HitRecord* hits) const {
+    for (int i = 0; i < nRays; ++i) {
+        hits[i] = HitRecord();
+    }
+    bvh.IntersectInterleaved(rays, nRays, [&](int ray, int index) {
+        if (instances[index].Intersect(rays[ray], &hits[ray])) {
+            hits[ray].instanceID = index;
+        }
+    });
+}
+
+void InstanceAccel::ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const {
+    instances[hit.instanceID].ComputeSurfaceInteraction(r, hit, isect);
+    isect->instanceID = hit.instanceID;
+}
+
+bool InstanceAccel::IntersectP(const Ray& r) const {
+    return bvh.IntersectP(r, [&](int index) {
+        return instances[index].IntersectP(r);
+    });
+}
+
+bool InstanceAccel::IntersectP(const Ray& r, OcclusionCache* cache, int light) const {
+    /// The last occluding instance is tested first, its BVH then tests
+    /// the last occluding primitive first
+    int& last = cache->instanceID[light];
+    if (last >= 0 and last < int(instances.size()) and instances[last].IntersectP(r, cache, light)) {
+        return true;
+    }
+    return bvh.IntersectP(r, [&](int index) {
+        if (index == last or !instances[index].IntersectP(r, cache, light)) {
+            return false;
+        }
+        last = index;
+        return true;
+    });
+}
+
+void InstanceAccel::SetTransform(size_t index, const Transform& InstanceToWorld) {
+    instances[index].InstanceToWorld = InstanceToWorld;
+    instances[index].WorldToInstance = Inverse(InstanceToWorld);
+}
+
+BVHUpdate InstanceAccel::Update(float rebuildThreshold) {
+    std::vector<Bounds3f> bounds(instances.size());
+    for (size_t i = 0; i < instances.size(); ++i) {
+        bounds[i] = instances[i].WorldBound();
+    }
+    return bvh.Update(bounds, rebuildThreshold);
+}
+
+HEIMDALL_NAMESPACE_END
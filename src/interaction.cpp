@@ -21,41 +21,54 @@ SurfaceInteraction::SurfaceInteraction(const Point3f& p, const Vec3f& error, con
         const Vec3f& wo, const Vec3f& dpdu, const Vec3f& dpdv, const Normal3f& dndu, const Normal3f& dndv, 
         float time, const Shape* shape)
     : Interaction(p, Normal3f(Normalize(Cross(dpdu, dpdv))), error, wo, time), uv(uv), 
-      dpdu(dpdu), dpdv(dpdv), dndu(dndu), dndv(dndv), shape(shape) {
-
-    /// Initalize shading geometry
-    shading.n = n;
-    shading.dpdu = dpdu;
-    shading.dpdv = dpdv;
-    shading.dndu = dndu;
-    shading.dndv = dndv;
+      dpdu(dpdu), dpdv(dpdv), dndu(dndu), dndv(dndv), shape(shape), hasShadingGeometry(false),
+      shadingValid(false) {
 
     /// Adjust normal based on orientation and handedness    
     if (shape and (shape->reverseOrientation ^ shape->transformSwapsHandedness)) {
         n *= -1;
-        shading.n *= -1;
     }
 }
 
 void SurfaceInteraction::SetShadingGeometry(const Vec3f& dpdus, const Vec3f& dpdvs, const Normal3f& dndus, 
     const Normal3f& dndvs, bool orientationIsAuthoritative) {
-    
-    /// Compute shading.n for SurfaceInteraction
-    shading.n = Normal3f(Normalize(Cross(dpdus, dpdvs)));
-    if (shape and (shape->reverseOrientation ^ shape->transformSwapsHandedness)) {
-        shading.n = -shading.n;
-    }
+
+    /// Initialize shading partial derivative values, shading.n follows lazily
+    shading.dpdu = dpdus;
+    shading.dpdv = dpdvs;
+    shading.dndu = dndus;
+    shading.dndv = dndvs;
+    hasShadingGeometry = true;
+    shadingValid = false;
+
+    /// The geometric normal follows the shading normal, which is needed now
     if (orientationIsAuthoritative) {
+        shading.n = Normal3f(Normalize(Cross(dpdus, dpdvs)));
+        if (shape and (shape->reverseOrientation ^ shape->transformSwapsHandedness)) {
+            shading.n = -shading.n;
+        }
         n = Faceforward(n, shading.n);
-    } else {
-        shading.n = Faceforward(shading.n, n);
+        shadingValid = true;
     }
+}
 
-    /// Initialize shading partial derivative values
-    shading.dpdu = dpdu;
-    shading.dpdv = dpdv;
-    shading.dndu = dndu;
-    shading.dndv = dndv;
+const SurfaceInteraction::ShadingGeometry& SurfaceInteraction::Shading() const {
+    if (shadingValid) {
+        return shading;
+    }
+    if (hasShadingGeometry) {
+        /// Shading normal lies in the geometric normal's hemisphere, so its
+        /// orientation needs no handedness correction
+        shading.n = Faceforward(Normal3f(Normalize(Cross(shading.dpdu, shading.dpdv))), n);
+    } else {
+        shading.n = n;
+        shading.dpdu = dpdu;
+        shading.dpdv = dpdv;
+        shading.dndu = dndu;
+        shading.dndv = dndv;
+    }
+    shadingValid = true;
+    return shading;
 }
 
 HEIMDALL_NAMESPACE_END
\ No newline at end of file
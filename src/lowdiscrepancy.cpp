@@ -0,0 +1,187 @@
+#include "heimdall/lowdiscrepancy.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Low discrepancy parameters
+static const uint64_t permutationSeed = 0x68656d64616c6cull;   /// Seeds the Halton digit permutations
+static const uint64_t pmj02Seed = 0x706d6a3032ull;             /// Seeds the (0, 2) set scrambles
+
+/// Primitive polynomials and initial direction numbers of Sobol
+/// dimensions 1 and up, from Joe and Kuo (2008). The polynomial of
+/// degree s has the inner coefficients a, highest power first.
+struct SobolDirections {
+    int s, a;
+    uint32_t m[6];
+};
+
+static const SobolDirections sobolDirections[nSobolDimensions - 1] = {
+    {1, 0,  {1}},
+    {2, 1,  {1, 3}},
+    {3, 1,  {1, 3, 1}},
+    {3, 2,  {1, 1, 1}},
+    {4, 1,  {1, 1, 3, 3}},
+    {4, 4,  {1, 3, 5, 13}},
+    {5, 2,  {1, 1, 5, 5, 17}},
+    {5, 4,  {1, 1, 5, 5, 5}},
+    {5, 7,  {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6, 1,  {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}}
+};
+
+/**
+ * \brief Sobol function definitions
+ */
+
+/// Generator matrices of every dimension, column i at 32 * dimension + i
+static std::vector<uint32_t> ComputeSobolMatrices() {
+    std::vector<uint32_t> matrices(32 * nSobolDimensions);
+
+    /// Dimension 0 is the van der Corput sequence
+    for (int i = 0; i < 32; ++i) {
+        matrices[i] = 1u << (31 - i);
+    }
+
+    for (int dim = 1; dim < nSobolDimensions; ++dim) {
+        const SobolDirections& dir = sobolDirections[dim - 1];
+        uint32_t* v = &matrices[32 * dim];
+        for (int i = 0; i < dir.s; ++i) {
+            v[i] = dir.m[i] << (31 - i);
+        }
+
+        /// Recurrence of the primitive polynomial
+        for (int i = dir.s; i < 32; ++i) {
+            v[i] = v[i - dir.s] ^ (v[i - dir.s] >> dir.s);
+            for (int k = 1; k < dir.s; ++k) {
+                if ((dir.a >> (dir.s - 1 - k)) & 1) {
+                    v[i] ^= v[i - k];
+                }
+            }
+        }
+    }
+    return matrices;
+}
+
+const uint32_t* SobolMatrix(int dimension) {
+    static const std::vector<uint32_t> matrices = ComputeSobolMatrices();
+    return &matrices[32 * dimension];
+}
+
+/**
+ * \brief Halton function definitions
+ */
+
+static std::vector<int> ComputePrimes() {
+    std::vector<int> primes;
+    for (int n = 2; int(primes.size()) < nHaltonDimensions; ++n) {
+        bool isPrime = true;
+        for (int i = 0; i < int(primes.size()) and primes[i] * primes[i] <= n; ++i) {
+            if (n % primes[i] == 0) {
+                isPrime = false;
+                break;
+            }
+        }
+        if (isPrime) {
+            primes.push_back(n);
+        }
+    }
+    return primes;
+}
+
+int Prime(int baseIndex) {
+    static const std::vector<int> primes = ComputePrimes();
+    return primes[baseIndex];
+}
+
+float RadicalInverse(int baseIndex, uint64_t a) {
+    const int base = Prime(baseIndex);
+    const double invBase = 1.0 / base;
+    uint64_t reversedDigits = 0;
+    double invBaseN = 1.0;
+    while (a) {
+        uint64_t next = a / base;
+        uint64_t digit = a - next * base;
+        reversedDigits = reversedDigits * base + digit;
+        invBaseN *= invBase;
+        a = next;
+    }
+    return std::min(float(reversedDigits * invBaseN), OneMinusEpsilon);
+}
+
+/// Permutations of every base back to back, base i at offsets[i]
+struct RadicalInversePermutations {
+    std::vector<uint16_t> perms;
+    std::vector<int> offsets;
+
+    RadicalInversePermutations() {
+        uint64_t state = permutationSeed;
+        for (int i = 0; i < nHaltonDimensions; ++i) {
+            int base = Prime(i);
+            offsets.push_back(int(perms.size()));
+            for (int j = 0; j < base; ++j) {
+                perms.push_back(uint16_t(j));
+            }
+
+            /// Fisher-Yates shuffle driven by a hashed counter
+            uint16_t* perm = &perms[offsets.back()];
+            for (int j = base - 1; j > 0; --j) {
+                state = MixBits(state + 0x9e3779b97f4a7c15ull);
+                std::swap(perm[j], perm[state % uint64_t(j + 1)]);
+            }
+        }
+    }
+};
+
+const uint16_t* RadicalInversePermutation(int baseIndex) {
+    static const RadicalInversePermutations permutations;
+    return &permutations.perms[permutations.offsets[baseIndex]];
+}
+
+float ScrambledRadicalInverse(int baseIndex, uint64_t a, const uint16_t* perm) {
+    const int base = Prime(baseIndex);
+    const double invBase = 1.0 / base;
+    uint64_t reversedDigits = 0;
+    double invBaseN = 1.0;
+    while (a) {
+        uint64_t next = a / base;
+        uint64_t digit = a - next * base;
+        reversedDigits = reversedDigits * base + perm[digit];
+        invBaseN *= invBase;
+        a = next;
+    }
+
+    /// The permuted trailing zeros sum to a geometric series
+    return std::min(float(invBaseN * (reversedDigits + invBase * perm[0] / (1.0 - invBase))), OneMinusEpsilon);
+}
+
+/**
+ * \brief PMJ02 function definitions
+ */
+
+/// Owen scrambled Sobol points of dimensions 0 and 1 form a (0, 2)
+/// sequence: every prefix of 4^k points is progressively jittered and
+/// stratified in all elementary intervals, which is what pmj02 sets are
+static std::vector<uint32_t> ComputePMJ02Sets() {
+    std::vector<uint32_t> sets(2 * nPMJ02Sets * pmj02SetSize);
+    for (int set = 0; set < nPMJ02Sets; ++set) {
+        uint64_t seed = MixBits(pmj02Seed + set);
+        for (int i = 0; i < pmj02SetSize; ++i) {
+            uint32_t* p = &sets[2 * (set * pmj02SetSize + i)];
+            p[0] = OwenScramble(SobolBits(i, 0), uint32_t(seed));
+            p[1] = OwenScramble(SobolBits(i, 1), uint32_t(seed >> 32));
+        }
+    }
+    return sets;
+}
+
+void PMJ02Bits(int setIndex, int sampleIndex, uint32_t* x, uint32_t* y) {
+    static const std::vector<uint32_t> sets = ComputePMJ02Sets();
+    const uint32_t* p = &sets[2 * (setIndex * pmj02SetSize + sampleIndex)];
+    *x = p[0];
+    *y = p[1];
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,331 @@
+#include "heimdall/motionbvh.h"
+#include "heimdall/interaction.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Motion BVH build parameters
+static const int nMotionSamples = 16;          /// Samples used to make transformed bounds linear
+static const int nBuckets = 12;
+static const float temporalSplitRatio = 1.1f;  /// Swept to end point area before temporal splits are tried
+static const int maxTemporalSplits = 6;        /// Time ranges never shrink below 1/64 of the shutter
+static const int maxDepth = 56;                /// Keeps the tree within the traversal stack
+
+/**
+ * \brief LinearBounds3f function definitions
+ */
+
+LinearBounds3f Union(const LinearBounds3f& b1, const LinearBounds3f& b2) {
+    return LinearBounds3f(Union(b1.bounds0, b2.bounds0), Union(b1.bounds1, b2.bounds1));
+}
+
+LinearBounds3f MotionBounds(const AnimatedTransform& transform, const Bounds3f& b, float time0, float time1) {
+    Transform t;
+    transform.Interpolate(time0, &t);
+    Bounds3f b0 = t(b);
+    transform.Interpolate(time1, &t);
+    Bounds3f b1 = t(b);
+    LinearBounds3f ret(b0, b1);
+
+    /// Rotation makes the motion nonlinear, grow both ends by the most any
+    /// sample escapes the straight interpolation
+    Vec3f growMin, growMax;
+    for (int i = 1; i < nMotionSamples; ++i) {
+        float s = float(i) / nMotionSamples;
+        transform.Interpolate(Lerp(s, time0, time1), &t);
+        Bounds3f sample = t(b);
+        Bounds3f interpolated = ret.Interpolate(s);
+        growMin = Max(growMin, interpolated.pMin - sample.pMin);
+        growMax = Max(growMax, sample.pMax - interpolated.pMax);
+    }
+    ret.bounds0.pMin -= growMin;
+    ret.bounds1.pMin -= growMin;
+    ret.bounds0.pMax += growMax;
+    ret.bounds1.pMax += growMax;
+    return ret;
+}
+
+/**
+ * \brief Per-primitive information used while building a motion BVH
+ */
+
+struct MotionPrimitiveInfo {
+    int primitiveNumber;
+    LinearBounds3f bounds;
+    Point3f centroid;
+
+    MotionPrimitiveInfo(int primitiveNumber, const LinearBounds3f& bounds)
+        : primitiveNumber(primitiveNumber), bounds(bounds) {
+        Bounds3f mid = bounds.Interpolate(0.5f);
+        centroid = mid.pMin * 0.5f + mid.pMax * 0.5f;
+    }
+};
+
+/**
+ * \brief MotionBVH method definitions
+ */
+
+MotionBVH::MotionBVH(size_t nPrimitives, float shutterOpen, float shutterClose,
+        MotionBoundsFunction primitiveBounds, int maxPrimsInNode)
+    : maxPrimsInNode(std::min(255, maxPrimsInNode)), minTemporalRange(0.0f) {
+    if (nPrimitives == 0) {
+        return;
+    }
+
+    /// An instantaneous shutter still needs a time range to interpolate over
+    if (shutterClose <= shutterOpen) {
+        shutterClose = shutterOpen + 1.0f;
+    }
+    minTemporalRange = (shutterClose - shutterOpen) / (1 << maxTemporalSplits);
+    std::vector<MotionPrimitiveInfo> primitiveInfo;
+    primitiveInfo.reserve(nPrimitives);
+    for (size_t i = 0; i < nPrimitives; ++i) {
+        primitiveInfo.push_back(MotionPrimitiveInfo(int(i), primitiveBounds(i, shutterOpen, shutterClose)));
+    }
+    RecursiveBuild(primitiveInfo, primitiveBounds, shutterOpen, shutterClose, 0);
+    nodes.shrink_to_fit();
+    primitiveIndices.shrink_to_fit();
+}
+
+Bounds3f MotionBVH::WorldBound() const {
+    if (nodes.empty()) {
+        return Bounds3f();
+    }
+    return Union(nodes[0].bounds.bounds0, nodes[0].bounds.bounds1);
+}
+
+int MotionBVH::CreateLeaf(const std::vector<MotionPrimitiveInfo>& primitiveInfo, const LinearBounds3f& bounds,
+        float time0, float time1) {
+    int nodeIndex = int(nodes.size());
+    nodes.push_back(MotionBVHNode());
+    MotionBVHNode& node = nodes.back();
+    node.bounds = bounds;
+    node.time0 = time0;
+    node.time1 = time1;
+    node.primitivesOffset = int(primitiveIndices.size());
+    node.nPrimitives = uint16_t(primitiveInfo.size());
+    node.axis = 0;
+    node.temporalSplit = 0;
+    for (const MotionPrimitiveInfo& info : primitiveInfo) {
+        primitiveIndices.push_back(info.primitiveNumber);
+    }
+    return nodeIndex;
+}
+
+int MotionBVH::RecursiveBuild(std::vector<MotionPrimitiveInfo>& primitiveInfo,
+        const MotionBoundsFunction& primitiveBounds, float time0, float time1, int depth) {
+    int nPrimitives = int(primitiveInfo.size());
+    LinearBounds3f bounds = primitiveInfo[0].bounds;
+    Bounds3f centroidBounds;
+    for (const MotionPrimitiveInfo& info : primitiveInfo) {
+        bounds = Union(bounds, info.bounds);
+        centroidBounds = Union(centroidBounds, info.centroid);
+    }
+    float area = bounds.ExpectedArea();
+    float invArea = area > 0.0f ? 1.0f / area : 0.0f;
+
+    /// Binned SAH object split on the centroids at the middle of the time range
+    float objectCost = INFINITY;
+    int dim = centroidBounds.MaximumExtent();
+    int splitBucket = 0;
+    float cMin = centroidBounds.pMin[dim];
+    float cExtent = centroidBounds.pMax[dim] - cMin;
+    auto bucketOf = [&](const MotionPrimitiveInfo& info) {
+        return Clamp(int(nBuckets * (info.centroid[dim] - cMin) / cExtent), 0, nBuckets - 1);
+    };
+    if (nPrimitives > 1 and cExtent > 0.0f) {
+        int counts[nBuckets] = {0};
+        LinearBounds3f bucketBounds[nBuckets];
+        for (const MotionPrimitiveInfo& info : primitiveInfo) {
+            int b = bucketOf(info);
+            bucketBounds[b] = counts[b]++ ? Union(bucketBounds[b], info.bounds) : info.bounds;
+        }
+        for (int i = 0; i < nBuckets - 1; ++i) {
+            LinearBounds3f b0, b1;
+            int count0 = 0, count1 = 0;
+            for (int j = 0; j < nBuckets; ++j) {
+                if (counts[j] == 0) {
+                    continue;
+                }
+                if (j <= i) {
+                    b0 = count0 ? Union(b0, bucketBounds[j]) : bucketBounds[j];
+                    count0 += counts[j];
+                } else {
+                    b1 = count1 ? Union(b1, bucketBounds[j]) : bucketBounds[j];
+                    count1 += counts[j];
+                }
+            }
+            if (count0 == 0 or count1 == 0) {
+                continue;
+            }
+            float cost = 0.125f + (count0 * b0.ExpectedArea() + count1 * b1.ExpectedArea()) * invArea;
+            if (cost < objectCost) {
+                objectCost = cost;
+                splitBucket = i;
+            }
+        }
+    }
+
+    /// Temporal split when the node sweeps much more space than it covers at any instant
+    float temporalCost = INFINITY;
+    float timeSplit = 0.5f * (time0 + time1);
+    std::vector<MotionPrimitiveInfo> early, late;
+    float swept = Union(bounds.bounds0, bounds.bounds1).SurfaceArea();
+    float instantaneous = std::max(bounds.bounds0.SurfaceArea(), bounds.bounds1.SurfaceArea());
+    if (depth < maxDepth and time1 - time0 > 1.5f * minTemporalRange and
+        swept > temporalSplitRatio * instantaneous) {
+        early.reserve(nPrimitives);
+        late.reserve(nPrimitives);
+        for (const MotionPrimitiveInfo& info : primitiveInfo) {
+            early.push_back(MotionPrimitiveInfo(info.primitiveNumber,
+                primitiveBounds(info.primitiveNumber, time0, timeSplit)));
+            late.push_back(MotionPrimitiveInfo(info.primitiveNumber,
+                primitiveBounds(info.primitiveNumber, timeSplit, time1)));
+        }
+        LinearBounds3f earlyBounds = early[0].bounds, lateBounds = late[0].bounds;
+        for (int i = 1; i < nPrimitives; ++i) {
+            earlyBounds = Union(earlyBounds, early[i].bounds);
+            lateBounds = Union(lateBounds, late[i].bounds);
+        }
+
+        /// Each half holds every primitive but sees only half of the rays
+        temporalCost = 0.125f + 0.5f * nPrimitives * (earlyBounds.ExpectedArea() + lateBounds.ExpectedArea()) * invArea;
+    }
+
+    /// Make a leaf if neither split beats intersecting everything here
+    float minCost = std::min(objectCost, temporalCost);
+    if (nPrimitives <= 0xffff and (minCost == INFINITY or depth >= maxDepth or
+        (nPrimitives <= maxPrimsInNode and minCost >= float(nPrimitives)))) {
+        return CreateLeaf(primitiveInfo, bounds, time0, time1);
+    }
+
+    int nodeIndex = int(nodes.size());
+    nodes.push_back(MotionBVHNode());
+    nodes[nodeIndex].bounds = bounds;
+    nodes[nodeIndex].time0 = time0;
+    nodes[nodeIndex].time1 = time1;
+    nodes[nodeIndex].nPrimitives = 0;
+    nodes[nodeIndex].axis = uint8_t(dim);
+
+    int secondChild;
+    if (temporalCost < objectCost) {
+        nodes[nodeIndex].temporalSplit = 1;
+        std::vector<MotionPrimitiveInfo>().swap(primitiveInfo);
+        RecursiveBuild(early, primitiveBounds, time0, timeSplit, depth + 1);
+        secondChild = RecursiveBuild(late, primitiveBounds, timeSplit, time1, depth + 1);
+    } else {
+        nodes[nodeIndex].temporalSplit = 0;
+        std::vector<MotionPrimitiveInfo> left, right;
+        if (objectCost == INFINITY) {
+            /// Too many coincident primitives for a leaf, split them evenly
+            left.assign(primitiveInfo.begin(), primitiveInfo.begin() + nPrimitives / 2);
+            right.assign(primitiveInfo.begin() + nPrimitives / 2, primitiveInfo.end());
+        } else {
+            for (const MotionPrimitiveInfo& info : primitiveInfo) {
+                if (bucketOf(info) <= splitBucket) {
+                    left.push_back(info);
+                } else {
+                    right.push_back(info);
+                }
+            }
+        }
+        std::vector<MotionPrimitiveInfo>().swap(primitiveInfo);
+        RecursiveBuild(left, primitiveBounds, time0, time1, depth + 1);
+        secondChild = RecursiveBuild(right, primitiveBounds, time0, time1, depth + 1);
+    }
+    nodes[nodeIndex].secondChildOffset = secondChild;
+    return nodeIndex;
+}
+
+/**
+ * \brief MotionInstance method definitions
+ */
+
+MotionInstance::MotionInstance(std::shared_ptr<const BVHAccel> blas, const AnimatedTransform* InstanceToWorld)
+    : blas(std::move(blas)), InstanceToWorld(InstanceToWorld) {}
+
+LinearBounds3f MotionInstance::WorldBound(float time0, float time1) const {
+    return MotionBounds(*InstanceToWorld, blas->WorldBound(), time0, time1);
+}
+
+bool MotionInstance::Intersect(const Ray& r, SurfaceInteraction* isect) const {
+    HitRecord hit;
+    if (!Intersect(r, &hit)) {
+        return false;
+    }
+    ComputeSurfaceInteraction(r, hit, isect);
+    return true;
+}
+
+bool MotionInstance::Intersect(const Ray& r, HitRecord* hit) const {
+    Transform interpolated;
+    InstanceToWorld->Interpolate(r.time, &interpolated);
+    Ray ray = Inverse(interpolated)(r);
+    if (!blas->Intersect(ray, hit)) {
+        return false;
+    }
+    r.tMax = ray.tMax;
+    return true;
+}
+
+void MotionInstance::ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const {
+    Transform interpolated;
+    InstanceToWorld->Interpolate(r.time, &interpolated);
+    blas->ComputeSurfaceInteraction(Inverse(interpolated)(r), hit, isect);
+    *isect = interpolated(*isect);
+}
+
+bool MotionInstance::IntersectP(const Ray& r) const {
+    Transform interpolated;
+    InstanceToWorld->Interpolate(r.time, &interpolated);
+    return blas->IntersectP(Inverse(interpolated)(r));
+}
+
+/**
+ * \brief MotionInstanceAccel method definitions
+ */
+
+MotionInstanceAccel::MotionInstanceAccel(std::vector<MotionInstance> instances, float shutterOpen,
+        float shutterClose, int maxPrimsInNode)
+    : instances(std::move(instances)) {
+    bvh = MotionBVH(this->instances.size(), shutterOpen, shutterClose,
+        [this](size_t index, float time0, float time1) {
+            return this->instances[index].WorldBound(time0, time1);
+        }, maxPrimsInNode);
+}
+
+Bounds3f MotionInstanceAccel::WorldBound() const {
+    return bvh.WorldBound();
+}
+
+bool MotionInstanceAccel::Intersect(const Ray& r, SurfaceInteraction* isect) const {
+    HitRecord hit;
+    if (!Intersect(r, &hit)) {
+        return false;
+    }
+    ComputeSurfaceInteraction(r, hit, isect);
+    return true;
+}
+
+bool MotionInstanceAccel::Intersect(const Ray& r, HitRecord* hit) const {
+    return bvh.Intersect(r, [&](int index) {
+        if (!instances[index].Intersect(r, hit)) {
+            return false;
+        }
+        hit->instanceID = index;
+        return true;
+    });
+}
+
+void MotionInstanceAccel::ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit,
+        SurfaceInteraction* isect) const {
+    instances[hit.instanceID].ComputeSurfaceInteraction(r, hit, isect);
+    isect->instanceID = hit.instanceID;
+}
+
+bool MotionInstanceAccel::IntersectP(const Ray& r) const {
+    return bvh.IntersectP(r, [&](int index) {
+        return instances[index].IntersectP(r);
+    });
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,258 @@
+#include "heimdall/parallel.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Pool the calling thread works for and its queue in that pool
+static thread_local ThreadPool* currentPool = nullptr;
+static thread_local int threadIndex = 0;
+
+static std::unique_ptr<ThreadPool> globalPool;
+static std::mutex globalPoolMutex;
+
+/**
+ * \brief ThreadPool method definitions
+ */
+
+ThreadPool::ThreadPool(int nThreads, bool pinThreads) : nQueued(0), shutdown(false) {
+    if (nThreads <= 0) {
+        nThreads = NumSystemCores();
+    }
+    for (int i = 0; i < nThreads; ++i) {
+        queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+    }
+    for (int i = 1; i < nThreads; ++i) {
+        threads.push_back(std::thread(&ThreadPool::WorkerLoop, this, i, pinThreads));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        shutdown = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+int ThreadPool::Size() const {
+    return int(queues.size());
+}
+
+void ThreadPool::Submit(Task* task) {
+    /// Workers push onto their own deque, everyone else shares queue 0
+    int queueIndex = currentPool == this ? threadIndex : 0;
+    {
+        std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+        queues[queueIndex]->tasks.push_back(task);
+    }
+    ++nQueued;
+
+    /// Taking the lock orders this against a worker about to sleep
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+ThreadPool::Task* ThreadPool::Pop(int queueIndex) {
+    /// Newest own task first, it is the most likely to be in cache
+    {
+        WorkQueue& own = *queues[queueIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            Task* task = own.tasks.back();
+            own.tasks.pop_back();
+            --nQueued;
+            return task;
+        }
+    }
+
+    /// Otherwise steal the oldest task of another thread
+    for (int i = 1; i < Size(); ++i) {
+        WorkQueue& victim = *queues[(queueIndex + i) % Size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            Task* task = victim.tasks.front();
+            victim.tasks.pop_front();
+            --nQueued;
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+bool ThreadPool::RunOne() {
+    Task* task = Pop(currentPool == this ? threadIndex : 0);
+    if (!task) {
+        return false;
+    }
+    task->func();
+
+    /// The group may be destroyed as soon as it is released
+    TaskGroup* group = task->group;
+    delete task;
+    --group->pending;
+    return true;
+}
+
+void ThreadPool::WorkerLoop(int queueIndex, bool pin) {
+    currentPool = this;
+    threadIndex = queueIndex;
+#ifdef __linux__
+    if (pin) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(queueIndex % NumSystemCores(), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus);
+    }
+#endif
+
+    while (true) {
+        if (RunOne()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() {
+            return shutdown or nQueued > 0;
+        });
+        if (shutdown) {
+            return;
+        }
+    }
+}
+
+/**
+ * \brief TaskGroup method definitions
+ */
+
+TaskGroup::TaskGroup(ThreadPool* pool) : pool(pool ? pool : GlobalThreadPool()), pending(0) {}
+
+TaskGroup::~TaskGroup() {
+    Wait();
+}
+
+void TaskGroup::Run(std::function<void()> func) {
+    if (pool->Size() == 1) {
+        func();
+        return;
+    }
+    ++pending;
+    pool->Submit(new ThreadPool::Task{std::move(func), this});
+}
+
+void TaskGroup::Wait() {
+    while (pending > 0) {
+        if (!pool->RunOne()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/**
+ * \brief Parallel function definitions
+ */
+
+void ParallelInit(int nThreads, bool pinThreads) {
+    std::lock_guard<std::mutex> lock(globalPoolMutex);
+    globalPool.reset(new ThreadPool(nThreads, pinThreads));
+}
+
+void ParallelCleanup() {
+    std::lock_guard<std::mutex> lock(globalPoolMutex);
+    globalPool.reset();
+}
+
+ThreadPool* GlobalThreadPool() {
+    std::lock_guard<std::mutex> lock(globalPoolMutex);
+    if (!globalPool) {
+        globalPool.reset(new ThreadPool());
+    }
+    return globalPool.get();
+}
+
+int NumSystemCores() {
+    return int(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+int MaxThreadIndex() {
+    return GlobalThreadPool()->Size();
+}
+
+int ThreadIndex() {
+    return threadIndex;
+}
+
+void ParallelFor(int64_t count, const std::function<void(int64_t)>& func, int64_t chunkSize) {
+    ThreadPool* pool = GlobalThreadPool();
+    chunkSize = std::max<int64_t>(1, chunkSize);
+    if (pool->Size() == 1 or count <= chunkSize) {
+        for (int64_t i = 0; i < count; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    /// Fork the upper half until a chunk is left, then run it here
+    TaskGroup group(pool);
+    std::function<void(int64_t, int64_t)> split = [&](int64_t begin, int64_t end) {
+        while (end - begin > chunkSize) {
+            int64_t mid = begin + (end - begin) / 2;
+            group.Run([&split, mid, end]() {
+                split(mid, end);
+            });
+            end = mid;
+        }
+        for (int64_t i = begin; i < end; ++i) {
+            func(i);
+        }
+    };
+    split(0, count);
+    group.Wait();
+}
+
+void ParallelForInOrder(int64_t count, const std::function<void(int64_t)>& func) {
+    ThreadPool* pool = GlobalThreadPool();
+    std::atomic<int64_t> next(0);
+    auto work = [&]() {
+        for (int64_t i = next++; i < count; i = next++) {
+            func(i);
+        }
+    };
+
+    /// One task per other thread, the calling thread takes part as well
+    TaskGroup group(pool);
+    int64_t nTasks = std::min<int64_t>(pool->Size(), count);
+    for (int64_t t = 1; t < nTasks; ++t) {
+        group.Run(work);
+    }
+    work();
+    group.Wait();
+}
+
+void ParallelFor2D(const Bounds2i& bounds, int tileSize, const std::function<void(const Bounds2i&)>& func,
+                   TraversalOrder tileOrder) {
+    Vec2i extent = bounds.Diagonal();
+    if (extent.x <= 0 or extent.y <= 0) {
+        return;
+    }
+    Bounds2i tileGrid(Point2i(0, 0), Point2i((extent.x + tileSize - 1) / tileSize,
+                                             (extent.y + tileSize - 1) / tileSize));
+    std::vector<Bounds2i> tiles;
+    for (Point2i tile : Traversal(tileGrid, tileOrder)) {
+        Point2i pMin(bounds.pMin.x + tile.x * tileSize, bounds.pMin.y + tile.y * tileSize);
+        Point2i pMax(std::min(pMin.x + tileSize, bounds.pMax.x), std::min(pMin.y + tileSize, bounds.pMax.y));
+        tiles.push_back(Bounds2i(pMin, pMax));
+    }
+    ParallelForInOrder(int64_t(tiles.size()), [&](int64_t i) {
+        func(tiles[i]);
+    });
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,71 @@
+#include "heimdall/raysort.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Ray sort parameters
+static const int mortonBits = 9;      /// Origin cells per axis are 2^mortonBits
+static const int bitsPerPass = 8;     /// Radix sort digit size
+static const int nPasses = 4;         /// Covers all 32 key bits
+
+/**
+ * \brief Ray sorting function definitions
+ */
+
+static inline uint32_t LeftShift3(uint32_t x) {
+    /// Spread the low 10 bits of x so two zero bits follow each one
+    if (x == (1 << 10)) {
+        --x;
+    }
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+uint32_t RaySortKey(const Ray& r, const Bounds3f& bounds) {
+    /// Quantize the origin, clamping origins outside the bounds to its faces
+    Point3f o = bounds.Offset(r.o);
+    const float scale = float((1 << mortonBits) - 1);
+    uint32_t x = uint32_t(Clamp(o.x, 0.0f, 1.0f) * scale);
+    uint32_t y = uint32_t(Clamp(o.y, 0.0f, 1.0f) * scale);
+    uint32_t z = uint32_t(Clamp(o.z, 0.0f, 1.0f) * scale);
+    uint32_t morton = (LeftShift3(z) << 2) | (LeftShift3(y) << 1) | LeftShift3(x);
+
+    uint32_t octant = (r.d.x < 0 ? 1 : 0) | (r.d.y < 0 ? 2 : 0) | (r.d.z < 0 ? 4 : 0);
+    return (octant << (3 * mortonBits)) | morton;
+}
+
+void SortRays(const Ray* rays, int nRays, const Bounds3f& bounds, std::vector<int>* order) {
+    std::vector<std::pair<uint32_t, int>> keys(nRays), scratch(nRays);
+    for (int i = 0; i < nRays; ++i) {
+        keys[i] = std::make_pair(RaySortKey(rays[i], bounds), i);
+    }
+
+    /// Least significant digit radix sort, each pass is stable
+    const int nBuckets = 1 << bitsPerPass;
+    const uint32_t bitMask = nBuckets - 1;
+    for (int pass = 0; pass < nPasses; ++pass) {
+        int lowBit = pass * bitsPerPass;
+        int bucketCount[nBuckets] = {0};
+        for (const auto& key : keys) {
+            ++bucketCount[(key.first >> lowBit) & bitMask];
+        }
+        int outIndex[nBuckets];
+        outIndex[0] = 0;
+        for (int i = 1; i < nBuckets; ++i) {
+            outIndex[i] = outIndex[i - 1] + bucketCount[i - 1];
+        }
+        for (const auto& key : keys) {
+            scratch[outIndex[(key.first >> lowBit) & bitMask]++] = key;
+        }
+        keys.swap(scratch);
+    }
+
+    order->resize(nRays);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        (*order)[i] = keys[i].second;
+    }
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,324 @@
+#include "heimdall/render.h"
+#include "heimdall/parallel.h"
+
+#include <chrono>
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Render loop parameters
+static const int firstIntegratorDimension = 3;      /// Film position and time come first
+
+/**
+ * \brief Render loop function definitions
+ */
+
+/// Tiles of tileSize on a side covering bounds, clipped to it
+static std::vector<Bounds2i> SplitTiles(const Bounds2i& bounds, int tileSize) {
+    std::vector<Bounds2i> tiles;
+    for (int y = bounds.pMin.y; y < bounds.pMax.y; y += tileSize) {
+        for (int x = bounds.pMin.x; x < bounds.pMax.x; x += tileSize) {
+            tiles.push_back(Bounds2i(Point2i(x, y), Point2i(std::min(x + tileSize, bounds.pMax.x),
+                                                            std::min(y + tileSize, bounds.pMax.y))));
+        }
+    }
+    return tiles;
+}
+
+/// Take samples [firstSample, firstSample + nSamples) of every pixel of
+/// tileBounds and merge them into the film
+static void RenderTile(const Camera& camera, Sampler& sampler, const RadianceFunction& Li,
+                       const Bounds2i& tileBounds, int64_t firstSample, int64_t nSamples) {
+    Film* film = camera.film;
+    FilmTile* filmTile = film->GetFilmTile(tileBounds);
+    Vec2i extent = tileBounds.Diagonal();
+    int nPixels = extent.x * extent.y;
+    std::vector<CameraSample> cameraSamples(nPixels);
+    std::vector<RayDifferential> rays(nPixels);
+
+    /// Films without AOVs never ask the radiance function for them
+    AOVSample aovSample(film->aovLayout);
+    AOVSample* aov = film->aovLayout.nFloats > 0 ? &aovSample : nullptr;
+
+    /// Differentials shrink with the nominal sample count, as in pbrt
+    float differentialScale = 1.0f / std::sqrt(float(std::max<int64_t>(1, sampler.samplesPerPixel)));
+    for (int64_t s = firstSample; s < firstSample + nSamples; ++s) {
+        sampler.GetCameraSamples(tileBounds, s, cameraSamples.data());
+        camera.GenerateRayDifferentials(cameraSamples.data(), nPixels, rays.data());
+        int i = 0;
+        for (Point2i p : tileBounds) {
+            rays[i].ScaleDifferentials(differentialScale);
+            sampler.StartPixelSample(p, s, firstIntegratorDimension);
+            if (aov) {
+                aovSample.Reset();
+            }
+            filmTile->AddSample(cameraSamples[i].pFilm, Li(rays[i], sampler, aov));
+            if (aov) {
+                filmTile->AddAOVSample(cameraSamples[i].pFilm, aovSample);
+            }
+            ++i;
+        }
+    }
+    film->MergeFilmTile(filmTile);
+}
+
+RenderStats RenderAdaptive(const Camera& camera, const Sampler& sampler, const RadianceFunction& Li,
+                           const AdaptiveSettings& settings) {
+    struct AdaptiveTile {
+        Bounds2i bounds;
+        int64_t area;
+        int64_t samplesTaken;
+        float error;
+        bool converged;
+    };
+
+    Film* film = camera.film;
+    std::vector<AdaptiveTile> tiles;
+    for (const Bounds2i& bounds : SplitTiles(film->GetSampleBounds(), settings.tileSize)) {
+        Vec2i extent = bounds.Diagonal();
+        tiles.push_back(AdaptiveTile{bounds, int64_t(extent.x) * extent.y, 0, INFINITY, false});
+    }
+
+    /// Output goes out in whole tiles of the writer, so it never holds a
+    /// partly written EXR tile. Pixels are final once every tile whose
+    /// samples reach them through the filter is done.
+    Bounds2i sampleBounds = film->GetSampleBounds();
+    int nTilesX = (sampleBounds.pMax.x - sampleBounds.pMin.x + settings.tileSize - 1) / settings.tileSize;
+    int nTilesY = int(tiles.size()) / std::max(1, nTilesX);
+    Vec2f filterRadius = film->GetFilterRadius();
+    Vec2i reach(int(std::ceil(filterRadius.x)), int(std::ceil(filterRadius.y)));
+    std::vector<Bounds2i> outputRegions;
+    if (settings.output) {
+        Bounds2i image(Point2i(0, 0), settings.output->resolution);
+        for (const Bounds2i& outputTile : SplitTiles(image, settings.output->tileSize)) {
+            Bounds2i region = Intersect(outputTile, film->pixelBounds);
+            if (region.pMin.x < region.pMax.x and region.pMin.y < region.pMax.y) {
+                outputRegions.push_back(region);
+            }
+        }
+    }
+    std::vector<bool> streamed(outputRegions.size(), false);
+    std::vector<float> streamBuffer;
+    const int64_t maxSamples = sampler.samplesPerPixel;
+    auto streamFinishedTiles = [&](bool renderDone) {
+        auto done = [&](const AdaptiveTile& tile) {
+            return renderDone or tile.converged or tile.samplesTaken >= maxSamples;
+        };
+        auto tileX = [&](int x) {
+            return Clamp((x - sampleBounds.pMin.x) / settings.tileSize, 0, nTilesX - 1);
+        };
+        auto tileY = [&](int y) {
+            return Clamp((y - sampleBounds.pMin.y) / settings.tileSize, 0, nTilesY - 1);
+        };
+        for (size_t i = 0; i < outputRegions.size(); ++i) {
+            const Bounds2i& region = outputRegions[i];
+            if (streamed[i]) {
+                continue;
+            }
+            bool final = true;
+            for (int y = tileY(region.pMin.y - reach.y); y <= tileY(region.pMax.y - 1 + reach.y) and final; ++y) {
+                for (int x = tileX(region.pMin.x - reach.x); x <= tileX(region.pMax.x - 1 + reach.x); ++x) {
+                    final = final and done(tiles[y * nTilesX + x]);
+                }
+            }
+            if (!final) {
+                continue;
+            }
+            streamed[i] = true;
+            int nChannels = settings.output->nChannels;
+            streamBuffer.resize(size_t(nChannels) * region.SurfaceArea());
+            if (nChannels == 3) {
+                film->GetRegion(region, streamBuffer.data());
+            } else {
+                film->GetChannelRegion(region, streamBuffer.data());
+            }
+            settings.output->WriteRegion(region, streamBuffer.data());
+        }
+    };
+
+    RenderStats stats;
+    stats.tiles = int(tiles.size());
+    std::vector<std::pair<int, int64_t>> work;
+    while (true) {
+        /// The first pass covers everything, later ones the worst tiles first
+        std::vector<int> order;
+        for (int i = 0; i < int(tiles.size()); ++i) {
+            if (!tiles[i].converged and tiles[i].samplesTaken < maxSamples) {
+                order.push_back(i);
+            }
+        }
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return tiles[a].error > tiles[b].error;
+        });
+
+        /// Hand out the pass until the budget is spent
+        work.clear();
+        int64_t passSamples = 0;
+        for (int i : order) {
+            AdaptiveTile& tile = tiles[i];
+            int64_t n = std::min(stats.passes == 0 ? settings.minSamples : settings.samplesPerPass,
+                                 maxSamples - tile.samplesTaken);
+            if (settings.sampleBudget > 0) {
+                n = std::min(n, (settings.sampleBudget - stats.totalSamples - passSamples) / tile.area);
+            }
+            if (n <= 0) {
+                break;
+            }
+            work.push_back(std::make_pair(i, n));
+            passSamples += n * tile.area;
+        }
+        if (work.empty()) {
+            break;
+        }
+
+        ParallelFor(int64_t(work.size()), [&](int64_t w) {
+            AdaptiveTile& tile = tiles[work[w].first];
+            std::unique_ptr<Sampler> tileSampler = sampler.Clone();
+            RenderTile(camera, *tileSampler, Li, tile.bounds, tile.samplesTaken, work[w].second);
+        });
+
+        /// Error estimates of the tiles that just got samples
+        for (const std::pair<int, int64_t>& item : work) {
+            AdaptiveTile& tile = tiles[item.first];
+            tile.samplesTaken += item.second;
+            tile.error = film->RegionError(tile.bounds);
+            if (tile.samplesTaken >= settings.minSamples and tile.error <= settings.noiseThreshold) {
+                tile.converged = true;
+                ++stats.convergedTiles;
+            }
+        }
+        stats.totalSamples += passSamples;
+        ++stats.passes;
+        if (settings.output) {
+            streamFinishedTiles(false);
+        }
+    }
+    if (settings.output) {
+        streamFinishedTiles(true);
+    }
+    return stats;
+}
+
+/**
+ * \brief ProgressiveRenderer method definitions
+ */
+
+ProgressiveRenderer::ProgressiveRenderer(const Camera& camera, const Sampler& sampler, const RadianceFunction& Li,
+                                         const ProgressiveSettings& settings)
+    : camera(camera), sampler(sampler.Clone()), Li(Li), settings(settings), previewReady(false), completedSamples(0) {
+    const Point2i& resolution = camera.film->fullResolution;
+    int scale = std::max(1, settings.previewScale);
+    previewResolution = Point2i((resolution.x + scale - 1) / scale, (resolution.y + scale - 1) / scale);
+    preview.resize(previewResolution.x * previewResolution.y);
+}
+
+RenderStats ProgressiveRenderer::Render() {
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    auto outOfTime = [&]() {
+        return settings.timeLimit > 0.0 and
+               std::chrono::duration<double>(Clock::now() - start).count() >= settings.timeLimit;
+    };
+
+    RenderPreview();
+
+    /// Center tiles first, they are what a deadline should not cut
+    Film* film = camera.film;
+    Bounds2i sampleBounds = film->GetSampleBounds();
+    Vec2i extent = sampleBounds.Diagonal();
+    int tileSize = settings.tileSize;
+    Bounds2i tileGrid(Point2i(0, 0), Point2i((extent.x + tileSize - 1) / tileSize,
+                                             (extent.y + tileSize - 1) / tileSize));
+    std::vector<Bounds2i> tiles;
+    for (Point2i t : Traversal(tileGrid, TraversalOrder::Spiral)) {
+        Point2i pMin(sampleBounds.pMin.x + t.x * tileSize, sampleBounds.pMin.y + t.y * tileSize);
+        tiles.push_back(Bounds2i(pMin, Point2i(std::min(pMin.x + tileSize, sampleBounds.pMax.x),
+                                               std::min(pMin.y + tileSize, sampleBounds.pMax.y))));
+    }
+
+    RenderStats stats;
+    stats.tiles = int(tiles.size());
+    std::atomic<int64_t> totalSamples(0);
+    std::atomic<bool> timedOut(false);
+    int64_t completed = 0;
+    while (completed < sampler->samplesPerPixel and !timedOut) {
+        int64_t target = completed == 0 ? settings.firstPassSamples : 2 * completed;
+        target = std::min(std::max<int64_t>(target, completed + 1), sampler->samplesPerPixel);
+
+        /// Tiles are started in spiral order, so those not started by the
+        /// deadline, which keep the previous pass, are the outermost
+        ParallelForInOrder(int64_t(tiles.size()), [&](int64_t i) {
+            if (timedOut or outOfTime()) {
+                timedOut = true;
+                return;
+            }
+            std::unique_ptr<Sampler> tileSampler = sampler->Clone();
+            RenderTile(camera, *tileSampler, Li, tiles[i], completed, target - completed);
+            Vec2i tileExtent = tiles[i].Diagonal();
+            totalSamples += int64_t(tileExtent.x) * tileExtent.y * (target - completed);
+        });
+        if (timedOut) {
+            break;
+        }
+
+        completed = target;
+        completedSamples = completed;
+        ++stats.passes;
+        if (settings.onPass) {
+            settings.onPass(stats.passes, completed);
+        }
+        if (settings.noiseTarget > 0.0f and film->MeanError(film->pixelBounds) <= settings.noiseTarget) {
+            break;
+        }
+        if (outOfTime()) {
+            timedOut = true;
+        }
+    }
+    stats.totalSamples = totalSamples;
+    stats.timedOut = timedOut;
+    return stats;
+}
+
+std::vector<RGB> ProgressiveRenderer::GetImage() const {
+    if (completedSamples > 0) {
+        return camera.film->GetImage();
+    }
+
+    /// Blocks of the preview until the film has a full pass
+    const Point2i& resolution = camera.film->fullResolution;
+    std::vector<RGB> image(resolution.x * resolution.y);
+    if (previewReady) {
+        int scale = std::max(1, settings.previewScale);
+        for (int y = 0; y < resolution.y; ++y) {
+            for (int x = 0; x < resolution.x; ++x) {
+                image[y * resolution.x + x] = preview[(y / scale) * previewResolution.x + x / scale];
+            }
+        }
+    }
+    return image;
+}
+
+int64_t ProgressiveRenderer::CompletedSamplesPerPixel() const {
+    return completedSamples;
+}
+
+void ProgressiveRenderer::RenderPreview() {
+    /// One ray through the center pixel of every block, rows in parallel
+    const Point2i& resolution = camera.film->fullResolution;
+    int scale = std::max(1, settings.previewScale);
+    ParallelFor(previewResolution.y, [&](int64_t by) {
+        std::unique_ptr<Sampler> rowSampler = sampler->Clone();
+        for (int bx = 0; bx < previewResolution.x; ++bx) {
+            Point2i p(std::min(bx * scale + scale / 2, resolution.x - 1),
+                      std::min(int(by) * scale + scale / 2, resolution.y - 1));
+            rowSampler->StartPixelSample(p, 0);
+            CameraSample cameraSample = rowSampler->GetCameraSample(p);
+            RayDifferential ray;
+            camera.GenerateRayDifferentials(&cameraSample, 1, &ray);
+            rowSampler->StartPixelSample(p, 0, firstIntegratorDimension);
+            preview[by * previewResolution.x + bx] = Li(ray, *rowSampler, nullptr);
+        }
+    });
+    previewReady = true;
+}
+
+HEIMDALL_NAMESPACE_END
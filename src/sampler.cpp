@@ -0,0 +1,301 @@
+#include "heimdall/sampler.h"
+#include "heimdall/lowdiscrepancy.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Sampler parameters
+static const int maxHaltonResolution = 128;     /// Pixels before the Halton pattern repeats
+
+/**
+ * \brief Sampler method definitions
+ */
+
+Sampler::Sampler(int64_t samplesPerPixel)
+    : samplesPerPixel(samplesPerPixel), pixel(0, 0), sampleIndex(0), dimension(0) {}
+
+Sampler::~Sampler() {}
+
+void Sampler::StartPixelSample(const Point2i& p, int64_t index, int dim) {
+    pixel = p;
+    sampleIndex = index;
+    dimension = dim;
+}
+
+CameraSample Sampler::GetCameraSample(const Point2i& pPixel) {
+    CameraSample sample;
+    Point2f u = Get2D();
+    sample.pFilm = Point2f(pPixel.x + u.x, pPixel.y + u.y);
+    sample.time = Get1D();
+    return sample;
+}
+
+void Sampler::Get1DTile(const Bounds2i& tile, int64_t index, int dim, float* samples) {
+    for (Point2i p : tile) {
+        StartPixelSample(p, index, dim);
+        *samples++ = Get1D();
+    }
+}
+
+void Sampler::Get2DTile(const Bounds2i& tile, int64_t index, int dim, Point2f* samples) {
+    for (Point2i p : tile) {
+        StartPixelSample(p, index, dim);
+        *samples++ = Get2D();
+    }
+}
+
+void Sampler::GetCameraSamples(const Bounds2i& tile, int64_t index, CameraSample* samples) {
+    Vec2i extent = tile.Diagonal();
+    if (extent.x <= 0 or extent.y <= 0) {
+        return;
+    }
+    tileScratch.resize(extent.x * extent.y);
+    timeScratch.resize(extent.x * extent.y);
+    Get2DTile(tile, index, 0, tileScratch.data());
+    Get1DTile(tile, index, 2, timeScratch.data());
+
+    int i = 0;
+    for (Point2i p : tile) {
+        samples[i].pFilm = Point2f(p.x + tileScratch[i].x, p.y + tileScratch[i].y);
+        samples[i].time = timeScratch[i];
+        ++i;
+    }
+}
+
+/**
+ * \brief IndependentSampler method definitions
+ */
+
+IndependentSampler::IndependentSampler(int64_t samplesPerPixel, uint64_t seed)
+    : Sampler(samplesPerPixel), seed(seed) {}
+
+std::unique_ptr<Sampler> IndependentSampler::Clone() const {
+    return std::unique_ptr<Sampler>(new IndependentSampler(*this));
+}
+
+void IndependentSampler::StartPixelSample(const Point2i& p, int64_t index, int dim) {
+    Sampler::StartPixelSample(p, index, dim);
+    rng = CounterRNG(p, index, seed);
+}
+
+float IndependentSampler::Get1D() {
+    return rng.UniformFloat(uint64_t(dimension++));
+}
+
+Point2f IndependentSampler::Get2D() {
+    Point2f u(rng.UniformFloat(uint64_t(dimension)), rng.UniformFloat(uint64_t(dimension + 1)));
+    dimension += 2;
+    return u;
+}
+
+void IndependentSampler::Get1DTile(const Bounds2i& tile, int64_t index, int dim, float* samples) {
+    /// One counter per pixel, every pixel is its own lane
+    for (Point2i p : tile) {
+        *samples++ = CounterRNG(p, index, seed).UniformFloat(uint64_t(dim));
+    }
+}
+
+/**
+ * \brief SobolSampler method definitions
+ */
+
+SobolSampler::SobolSampler(int64_t samplesPerPixel, uint64_t seed) : Sampler(samplesPerPixel), seed(seed) {}
+
+std::unique_ptr<Sampler> SobolSampler::Clone() const {
+    return std::unique_ptr<Sampler>(new SobolSampler(*this));
+}
+
+float SobolSampler::Get1D() {
+    uint32_t scramble = uint32_t(HashPixel(pixel, dimension, seed));
+    float u = SobolSample(sampleIndex, dimension, scramble);
+    ++dimension;
+    return u;
+}
+
+Point2f SobolSampler::Get2D() {
+    uint32_t scrambleX = uint32_t(HashPixel(pixel, dimension, seed));
+    uint32_t scrambleY = uint32_t(HashPixel(pixel, dimension + 1, seed));
+    Point2f u(SobolSample(sampleIndex, dimension, scrambleX), SobolSample(sampleIndex, dimension + 1, scrambleY));
+    dimension += 2;
+    return u;
+}
+
+void SobolSampler::Get1DTile(const Bounds2i& tile, int64_t index, int dim, float* samples) {
+    /// The sample is the same for every pixel up to its scramble, so the
+    /// generator matrix is applied once and the loop is straight line
+    uint32_t bits = SobolBits(index, dim);
+    int width = tile.pMax.x - tile.pMin.x;
+    for (int y = tile.pMin.y; y < tile.pMax.y; ++y) {
+        float* row = samples + (y - tile.pMin.y) * width;
+        for (int x = 0; x < width; ++x) {
+            uint32_t scramble = uint32_t(HashPixel(Point2i(tile.pMin.x + x, y), dim, seed));
+            row[x] = BitsToFloat01(OwenScramble(bits, scramble));
+        }
+    }
+}
+
+void SobolSampler::Get2DTile(const Bounds2i& tile, int64_t index, int dim, Point2f* samples) {
+    uint32_t bitsX = SobolBits(index, dim);
+    uint32_t bitsY = SobolBits(index, dim + 1);
+    int width = tile.pMax.x - tile.pMin.x;
+    for (int y = tile.pMin.y; y < tile.pMax.y; ++y) {
+        Point2f* row = samples + (y - tile.pMin.y) * width;
+        for (int x = 0; x < width; ++x) {
+            Point2i p(tile.pMin.x + x, y);
+            uint32_t scrambleX = uint32_t(HashPixel(p, dim, seed));
+            uint32_t scrambleY = uint32_t(HashPixel(p, dim + 1, seed));
+            row[x] = Point2f(BitsToFloat01(OwenScramble(bitsX, scrambleX)),
+                             BitsToFloat01(OwenScramble(bitsY, scrambleY)));
+        }
+    }
+}
+
+/**
+ * \brief HaltonSampler method definitions
+ */
+
+static void ExtendedGCD(int64_t a, int64_t b, int64_t* x, int64_t* y) {
+    if (b == 0) {
+        *x = 1;
+        *y = 0;
+        return;
+    }
+    int64_t xp, yp;
+    ExtendedGCD(b, a % b, &xp, &yp);
+    *x = yp;
+    *y = xp - (a / b) * yp;
+}
+
+static int64_t MultiplicativeInverse(int64_t a, int64_t n) {
+    int64_t x, y;
+    ExtendedGCD(a, n, &x, &y);
+    return ((x % n) + n) % n;
+}
+
+/// Index whose first nDigits base digits, reversed, spell inverse
+static uint64_t InverseRadicalInverse(int base, uint64_t inverse, int nDigits) {
+    uint64_t index = 0;
+    for (int i = 0; i < nDigits; ++i) {
+        uint64_t digit = inverse % base;
+        inverse /= base;
+        index = index * base + digit;
+    }
+    return index;
+}
+
+HaltonSampler::HaltonSampler(int64_t samplesPerPixel, const Bounds2i& sampleBounds)
+    : Sampler(samplesPerPixel), pixelForOffset(std::numeric_limits<int>::max(), std::numeric_limits<int>::max()),
+      offsetForCurrentPixel(0), haltonIndex(0) {
+    /// Scale the first two dimensions, base 2 and 3, to cover the bounds
+    Vec2i extent = sampleBounds.Diagonal();
+    int scales[2], exponents[2];
+    for (int i = 0; i < 2; ++i) {
+        int base = i == 0 ? 2 : 3;
+        int scale = 1, exponent = 0;
+        while (scale < std::min(i == 0 ? extent.x : extent.y, maxHaltonResolution)) {
+            scale *= base;
+            ++exponent;
+        }
+        scales[i] = scale;
+        exponents[i] = exponent;
+    }
+    baseScales = Point2i(scales[0], scales[1]);
+    baseExponents = Point2i(exponents[0], exponents[1]);
+    sampleStride = int64_t(scales[0]) * scales[1];
+
+    /// For mapping a pixel to its sample offset with the Chinese remainder theorem
+    multInverse[0] = MultiplicativeInverse(scales[1], scales[0]);
+    multInverse[1] = MultiplicativeInverse(scales[0], scales[1]);
+}
+
+std::unique_ptr<Sampler> HaltonSampler::Clone() const {
+    return std::unique_ptr<Sampler>(new HaltonSampler(*this));
+}
+
+void HaltonSampler::StartPixelSample(const Point2i& p, int64_t index, int dim) {
+    Sampler::StartPixelSample(p, index, dim);
+
+    /// The global index of the first sample falling into the pixel
+    if (p != pixelForOffset) {
+        offsetForCurrentPixel = 0;
+        if (sampleStride > 1) {
+            int pm[2] = {((p.x % maxHaltonResolution) + maxHaltonResolution) % maxHaltonResolution,
+                         ((p.y % maxHaltonResolution) + maxHaltonResolution) % maxHaltonResolution};
+            int scales[2] = {baseScales.x, baseScales.y};
+            int exponents[2] = {baseExponents.x, baseExponents.y};
+            for (int i = 0; i < 2; ++i) {
+                uint64_t dimOffset = InverseRadicalInverse(i == 0 ? 2 : 3, pm[i], exponents[i]);
+                offsetForCurrentPixel += dimOffset * (sampleStride / scales[i]) * multInverse[i];
+            }
+            offsetForCurrentPixel %= sampleStride;
+        }
+        pixelForOffset = p;
+    }
+    haltonIndex = uint64_t(offsetForCurrentPixel + index * sampleStride);
+}
+
+float HaltonSampler::Get1D() {
+    return SampleDimension(dimension++);
+}
+
+Point2f HaltonSampler::Get2D() {
+    Point2f u(SampleDimension(dimension), SampleDimension(dimension + 1));
+    dimension += 2;
+    return u;
+}
+
+float HaltonSampler::SampleDimension(int dim) const {
+    /// The low digits of the first two dimensions select the pixel, the
+    /// rest is the position inside it
+    if (dim == 0) {
+        return RadicalInverse(0, haltonIndex >> baseExponents.x);
+    }
+    if (dim == 1) {
+        return RadicalInverse(1, haltonIndex / baseScales.y);
+    }
+    if (dim >= nHaltonDimensions) {
+        dim = 2 + (dim - 2) % (nHaltonDimensions - 2);
+    }
+    return ScrambledRadicalInverse(dim, haltonIndex, RadicalInversePermutation(dim));
+}
+
+/**
+ * \brief PMJ02Sampler method definitions
+ */
+
+PMJ02Sampler::PMJ02Sampler(int64_t samplesPerPixel, uint64_t seed) : Sampler(samplesPerPixel), seed(seed) {}
+
+std::unique_ptr<Sampler> PMJ02Sampler::Clone() const {
+    return std::unique_ptr<Sampler>(new PMJ02Sampler(*this));
+}
+
+float PMJ02Sampler::Get1D() {
+    /// Either coordinate of a (0, 2) set is stratified on its own
+    float u = Sample(pixel, sampleIndex, dimension).x;
+    ++dimension;
+    return u;
+}
+
+Point2f PMJ02Sampler::Get2D() {
+    Point2f u = Sample(pixel, sampleIndex, dimension);
+    dimension += 2;
+    return u;
+}
+
+void PMJ02Sampler::Get2DTile(const Bounds2i& tile, int64_t index, int dim, Point2f* samples) {
+    for (Point2i p : tile) {
+        *samples++ = Sample(p, index, dim);
+    }
+}
+
+Point2f PMJ02Sampler::Sample(const Point2i& p, int64_t index, int dim) const {
+    /// Each pixel and dimension picks a set and xors random digits into
+    /// it, which keeps every elementary interval stratified
+    uint64_t hash = HashPixel(p, dim, seed);
+    int set = int((hash % nPMJ02Sets + index / pmj02SetSize) % nPMJ02Sets);
+    uint32_t x, y;
+    PMJ02Bits(set, int(index % pmj02SetSize), &x, &y);
+    uint64_t digits = MixBits(hash);
+    return Point2f(BitsToFloat01(x ^ uint32_t(digits)), BitsToFloat01(y ^ uint32_t(digits >> 32)));
+}
+
+HEIMDALL_NAMESPACE_END
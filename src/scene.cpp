@@ -0,0 +1,152 @@
+#include "heimdall/scene.h"
+#include "heimdall/raysort.h"
+#include "heimdall/parallel.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief Scene method definitions
+ */
+
+Scene::Scene() {}
+
+int Scene::AddGeometry(std::vector<std::shared_ptr<Shape>> shapes) {
+    geometries.push_back(std::move(shapes));
+    return int(geometries.size()) - 1;
+}
+
+int Scene::AddInstance(int geomID, const Transform& InstanceToWorld) {
+    if (geomID < 0 or geomID >= int(geometries.size())) {
+        return -1;
+    }
+    instanceDescs.push_back(std::make_pair(geomID, InstanceToWorld));
+    return int(instanceDescs.size()) - 1;
+}
+
+void Scene::Commit(int maxPrimsInNode, SplitMethod splitMethod) {
+    /// Every geometry gets one BVH, shared by all of its instances
+    std::vector<std::shared_ptr<const BVHAccel>> blas(geometries.size());
+    ParallelFor(int64_t(geometries.size()), [&](int64_t i) {
+        blas[i] = std::make_shared<BVHAccel>(geometries[i], maxPrimsInNode, splitMethod);
+    });
+    std::vector<Instance> instances;
+    instanceGeometry.clear();
+    for (const auto& desc : instanceDescs) {
+        instances.push_back(Instance(blas[desc.first], desc.second));
+        instanceGeometry.push_back(desc.first);
+    }
+    accel.reset(new InstanceAccel(std::move(instances), 1, splitMethod));
+}
+
+bool Scene::Committed() const {
+    return accel != nullptr;
+}
+
+Bounds3f Scene::WorldBound() const {
+    return accel ? accel->WorldBound() : Bounds3f();
+}
+
+int Scene::GeometryOf(int instanceID) const {
+    return instanceGeometry[instanceID];
+}
+
+bool Scene::Intersect1(const Ray& r, HitRecord* hit) const {
+    return accel->Intersect(r, hit);
+}
+
+bool Scene::Occluded1(const Ray& r) const {
+    return accel->IntersectP(r);
+}
+
+template <int N>
+void Scene::IntersectPacket(const int* valid, const Ray* rays, HitRecord* hits) const {
+    /// Gather the active rays so the interleaved traversal stays full
+    Ray active[N];
+    int index[N];
+    int nActive = 0;
+    for (int i = 0; i < N; ++i) {
+        hits[i] = HitRecord();
+        if (valid[i]) {
+            active[nActive] = rays[i];
+            index[nActive++] = i;
+        }
+    }
+    HitRecord activeHits[N];
+    accel->Intersect(active, nActive, activeHits);
+    for (int i = 0; i < nActive; ++i) {
+        hits[index[i]] = activeHits[i];
+        rays[index[i]].tMax = active[i].tMax;
+    }
+}
+
+template <int N>
+void Scene::OccludedPacket(const int* valid, const Ray* rays, bool* occluded) const {
+    for (int i = 0; i < N; ++i) {
+        occluded[i] = valid[i] and accel->IntersectP(rays[i]);
+    }
+}
+
+void Scene::Intersect4(const int* valid, const Ray* rays, HitRecord* hits) const {
+    IntersectPacket<4>(valid, rays, hits);
+}
+
+void Scene::Intersect8(const int* valid, const Ray* rays, HitRecord* hits) const {
+    IntersectPacket<8>(valid, rays, hits);
+}
+
+void Scene::Intersect16(const int* valid, const Ray* rays, HitRecord* hits) const {
+    IntersectPacket<16>(valid, rays, hits);
+}
+
+void Scene::Occluded4(const int* valid, const Ray* rays, bool* occluded) const {
+    OccludedPacket<4>(valid, rays, occluded);
+}
+
+void Scene::Occluded8(const int* valid, const Ray* rays, bool* occluded) const {
+    OccludedPacket<8>(valid, rays, occluded);
+}
+
+void Scene::Occluded16(const int* valid, const Ray* rays, bool* occluded) const {
+    OccludedPacket<16>(valid, rays, occluded);
+}
+
+void Scene::IntersectStream(const Ray* rays, int nRays, HitRecord* hits, StreamFlags flags) const {
+    if (flags == StreamFlags::Coherent) {
+        accel->Intersect(rays, nRays, hits);
+        return;
+    }
+
+    /// Trace a sorted copy, then scatter hits and tMax back
+    std::vector<int> order;
+    SortRays(rays, nRays, WorldBound(), &order);
+    std::vector<Ray> sorted(nRays);
+    for (int i = 0; i < nRays; ++i) {
+        sorted[i] = rays[order[i]];
+    }
+    std::vector<HitRecord> sortedHits(nRays);
+    accel->Intersect(sorted.data(), nRays, sortedHits.data());
+    for (int i = 0; i < nRays; ++i) {
+        hits[order[i]] = sortedHits[i];
+        rays[order[i]].tMax = sorted[i].tMax;
+    }
+}
+
+void Scene::OccludedStream(const Ray* rays, int nRays, bool* occluded, StreamFlags flags) const {
+    if (flags == StreamFlags::Coherent) {
+        for (int i = 0; i < nRays; ++i) {
+            occluded[i] = accel->IntersectP(rays[i]);
+        }
+        return;
+    }
+    std::vector<int> order;
+    SortRays(rays, nRays, WorldBound(), &order);
+    for (int index : order) {
+        occluded[index] = accel->IntersectP(rays[index]);
+    }
+}
+
+void Scene::ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const {
+    accel->ComputeSurfaceInteraction(r, hit, isect);
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,52 @@
+#include "heimdall/shape.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Relative slack on tMax when an interaction is recomputed from a hit
+static const float recomputeSlack = 1e-4f;
+
+/**
+ * \brief Shape method definitions
+ */
+
+Shape::Shape(const Transform* ObjectToWorld, const Transform* WorldToObject, bool reverseOrientation)
+    : ObjectToWorld(ObjectToWorld), WorldToObject(WorldToObject), reverseOrientation(reverseOrientation),
+      transformSwapsHandedness(ObjectToWorld->SwapsHandedness()) {}
+
+Bounds3f Shape::WorldBounds() const {
+    return (*ObjectToWorld)(ObjectBounds());
+}
+
+bool Shape::IntersectHit(const Ray& r, HitRecord* hit, bool testSurfaceAlpha) const {
+    float tHit;
+    SurfaceInteraction isect;
+    if (!Intersect(r, &tHit, &isect, testSurfaceAlpha)) {
+        return false;
+    }
+    hit->t = tHit;
+    hit->uv = isect.uv;
+    return true;
+}
+
+void Shape::ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const {
+    /// Intersect again just past the recorded hit, so nothing behind it
+    /// can be found instead
+    Ray ray = r;
+    ray.tMax = hit.t * (1.0f + recomputeSlack);
+    float tHit;
+    if (Intersect(ray, &tHit, isect)) {
+        return;
+    }
+
+    /// The second test can miss through rounding, fall back on the hit
+    /// point facing the ray, without any surface derivatives
+    *isect = SurfaceInteraction();
+    isect->p = r(hit.t);
+    isect->wo = Normalize(-r.d);
+    isect->n = Normal3f(isect->wo);
+    isect->uv = hit.uv;
+    isect->time = r.time;
+    isect->shape = this;
+}
+
+HEIMDALL_NAMESPACE_END
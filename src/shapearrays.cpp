@@ -0,0 +1,171 @@
+#include "heimdall/shapearrays.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief ShapeArrays method definitions
+ */
+
+void ShapeArrays::AddCompressedMesh(const Transform* ObjectToWorld, const Transform* WorldToObject,
+        bool reverseOrientation, int nTriangles, const int* vertexIndices, int nVertices, const Point3f* P,
+        const Normal3f* N, const Point2f* UV) {
+    compressedMeshes.push_back(CompressedMeshShape(ObjectToWorld, WorldToObject, reverseOrientation,
+        std::make_shared<CompressedTriangleMesh>(*ObjectToWorld, nTriangles, vertexIndices, nVertices, P, N, UV)));
+}
+
+/**
+ * \brief ShapeArrayAccel method definitions
+ */
+
+ShapeArrayAccel::ShapeArrayAccel(ShapeArrays shapes, int maxPrimsInNode, SplitMethod splitMethod)
+    : shapes(std::move(shapes)), triangleOffset(int(this->shapes.spheres.size())),
+      compressedOffset(triangleOffset + int(this->shapes.triangles.size())) {
+    int nCompressed = 0;
+    for (const CompressedMeshShape& mesh : this->shapes.compressedMeshes) {
+        meshOffsets.push_back(nCompressed);
+        nCompressed += mesh.mesh->nTriangles;
+    }
+    nPrimitives = compressedOffset + nCompressed;
+    std::vector<BVHPrimitiveInfo> primitiveInfo(nPrimitives);
+    for (size_t i = 0; i < primitiveInfo.size(); ++i) {
+        primitiveInfo[i] = BVHPrimitiveInfo(i, PrimitiveBounds(int(i)));
+    }
+    bvh = BVH(std::move(primitiveInfo), maxPrimsInNode, splitMethod);
+}
+
+Bounds3f ShapeArrayAccel::WorldBound() const {
+    return bvh.WorldBound();
+}
+
+const Shape* ShapeArrayAccel::GetShape(int primID) const {
+    int index;
+    switch (Tag(primID, &index)) {
+        case ShapeType::Sphere:
+            return &shapes.spheres[index];
+        case ShapeType::Triangle:
+            return &shapes.triangles[index];
+        case ShapeType::CompressedTriangle: {
+            int triNumber;
+            return &CompressedMesh(index, &triNumber);
+        }
+    }
+    return nullptr;
+}
+
+Bounds3f ShapeArrayAccel::PrimitiveBounds(int primID) const {
+    int index;
+    if (Tag(primID, &index) == ShapeType::CompressedTriangle) {
+        int triNumber;
+        return CompressedMesh(index, &triNumber).TriangleBounds(triNumber);
+    }
+    return GetShape(primID)->WorldBounds();
+}
+
+bool ShapeArrayAccel::Intersect(const Ray& r, SurfaceInteraction* isect) const {
+    HitRecord hit;
+    if (!Intersect(r, &hit)) {
+        return false;
+    }
+    ComputeSurfaceInteraction(r, hit, isect);
+    return true;
+}
+
+bool ShapeArrayAccel::Intersect(const Ray& r, HitRecord* hit) const {
+    return bvh.Intersect(r, [&](int primID) {
+        /// All shape classes are final, so these calls bind statically and inline
+        int index;
+        bool found = false;
+        switch (Tag(primID, &index)) {
+            case ShapeType::Sphere:
+                found = shapes.spheres[index].IntersectHit(r, hit);
+                break;
+            case ShapeType::Triangle:
+                found = shapes.triangles[index].IntersectHit(r, hit);
+                break;
+            case ShapeType::CompressedTriangle: {
+                int triNumber;
+                found = CompressedMesh(index, &triNumber).IntersectHit(r, triNumber, hit);
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+        r.tMax = hit->t;
+        hit->primID = primID;
+        return true;
+    });
+}
+
+bool ShapeArrayAccel::IntersectP(const Ray& r) const {
+    return bvh.IntersectP(r, [&](int primID) {
+        return Occludes(r, primID);
+    });
+}
+
+bool ShapeArrayAccel::IntersectP(const Ray& r, OcclusionCache* cache, int light) const {
+    int& last = cache->primID[light];
+    if (last >= 0 and last < nPrimitives and Occludes(r, last)) {
+        return true;
+    }
+    return bvh.IntersectP(r, [&](int primID) {
+        if (primID == last or !Occludes(r, primID)) {
+            return false;
+        }
+        last = primID;
+        return true;
+    });
+}
+
+bool ShapeArrayAccel::Occludes(const Ray& r, int primID) const {
+    int index;
+    HitRecord hit;
+    switch (Tag(primID, &index)) {
+        case ShapeType::Sphere:
+            return shapes.spheres[index].IntersectHit(r, &hit);
+        case ShapeType::Triangle:
+            return shapes.triangles[index].IntersectHit(r, &hit);
+        case ShapeType::CompressedTriangle: {
+            int triNumber;
+            return CompressedMesh(index, &triNumber).IntersectHit(r, triNumber, &hit);
+        }
+    }
+    return false;
+}
+
+void ShapeArrayAccel::ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit,
+        SurfaceInteraction* isect) const {
+    int index;
+    switch (Tag(hit.primID, &index)) {
+        case ShapeType::Sphere:
+            shapes.spheres[index].ComputeSurfaceInteraction(r, hit, isect);
+            break;
+        case ShapeType::Triangle:
+            shapes.triangles[index].ComputeSurfaceInteraction(r, hit, isect);
+            break;
+        case ShapeType::CompressedTriangle: {
+            int triNumber;
+            CompressedMesh(index, &triNumber).ComputeSurfaceInteraction(r, triNumber, hit, isect);
+            break;
+        }
+    }
+}
+
+BVHUpdate ShapeArrayAccel::Update(float rebuildThreshold) {
+    std::vector<Bounds3f> bounds(nPrimitives);
+    for (size_t i = 0; i < bounds.size(); ++i) {
+        bounds[i] = PrimitiveBounds(int(i));
+    }
+    return bvh.Update(bounds, rebuildThreshold);
+}
+
+size_t ShapeArrayAccel::MemoryBytes() const {
+    size_t bytes = shapes.spheres.size() * sizeof(Sphere) + shapes.triangles.size() * sizeof(Triangle) +
+        shapes.compressedMeshes.size() * (sizeof(CompressedMeshShape) + sizeof(int)) + bvh.MemoryBytes();
+    for (const CompressedMeshShape& mesh : shapes.compressedMeshes) {
+        bytes += sizeof(CompressedTriangleMesh) + mesh.mesh->MemoryBytes();
+    }
+    return bytes;
+}
+
+HEIMDALL_NAMESPACE_END
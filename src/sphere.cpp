@@ -0,0 +1,81 @@
+#include "heimdall/sphere.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief Sphere method definitions
+ */
+
+Sphere::Sphere(const Transform* ObjectToWorld, const Transform* WorldToObject, bool reverseOrientation,
+        float radius)
+    : Shape(ObjectToWorld, WorldToObject, reverseOrientation), radius(radius) {}
+
+Bounds3f Sphere::ObjectBounds() const {
+    return Bounds3f(Point3f(-radius, -radius, -radius), Point3f(radius, radius, radius));
+}
+
+bool Sphere::Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool testSurfaceAlpha) const {
+    HitRecord hit;
+    if (!IntersectHit(r, &hit, testSurfaceAlpha)) {
+        return false;
+    }
+    ComputeSurfaceInteraction(r, hit, isect);
+    *tHit = hit.t;
+    return true;
+}
+
+bool Sphere::IntersectTest(const Ray& r, bool) const {
+    float t;
+    return Hit((*WorldToObject)(r), &t);
+}
+
+float Sphere::Area() const {
+    return 4.0f * M_PI * radius * radius;
+}
+
+void Sphere::ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const {
+    /// Refine the hit point onto the surface
+    Ray ray = (*WorldToObject)(r);
+    Point3f pHit = ray(hit.t);
+    pHit = pHit * (radius / Distance(pHit, Point3f(0.0f, 0.0f, 0.0f)));
+    if (pHit.x == 0.0f and pHit.y == 0.0f) {
+        pHit.x = 1e-5f * radius;
+    }
+
+    /// Parameterize by phi around z and theta from the north pole
+    const float phiMax = 2.0f * M_PI;
+    const float thetaRange = -M_PI;
+    float phi = std::atan2(pHit.y, pHit.x);
+    if (phi < 0.0f) {
+        phi += phiMax;
+    }
+    float theta = std::acos(Clamp(pHit.z / radius, -1.0f, 1.0f));
+    Point2f uv(phi / phiMax, 1.0f - theta / M_PI);
+
+    /// Position derivatives
+    float zRadius = std::sqrt(pHit.x * pHit.x + pHit.y * pHit.y);
+    float cosPhi = pHit.x / zRadius;
+    float sinPhi = pHit.y / zRadius;
+    Vec3f dpdu(-phiMax * pHit.y, phiMax * pHit.x, 0.0f);
+    Vec3f dpdv = Vec3f(pHit.z * cosPhi, pHit.z * sinPhi, -radius * std::sin(theta)) * thetaRange;
+
+    /// Normal derivatives from the Weingarten equations
+    Vec3f d2Pduu = Vec3f(pHit.x, pHit.y, 0.0f) * (-phiMax * phiMax);
+    Vec3f d2Pduv = Vec3f(-sinPhi, cosPhi, 0.0f) * (thetaRange * pHit.z * phiMax);
+    Vec3f d2Pdvv = Vec3f(pHit) * (-thetaRange * thetaRange);
+    float E = Dot(dpdu, dpdu);
+    float F = Dot(dpdu, dpdv);
+    float G = Dot(dpdv, dpdv);
+    Vec3f N = Normalize(Cross(dpdu, dpdv));
+    float e = Dot(N, d2Pduu);
+    float f = Dot(N, d2Pduv);
+    float g = Dot(N, d2Pdvv);
+    float invEGF2 = 1.0f / (E * G - F * F);
+    Normal3f dndu(dpdu * ((f * F - e * G) * invEGF2) + dpdv * ((e * F - f * E) * invEGF2));
+    Normal3f dndv(dpdu * ((g * F - f * G) * invEGF2) + dpdv * ((f * F - g * E) * invEGF2));
+
+    *isect = (*ObjectToWorld)(SurfaceInteraction(pHit, Vec3f(), uv, -ray.d, dpdu, dpdv, dndu, dndv,
+        ray.time, this));
+}
+
+HEIMDALL_NAMESPACE_END
@@ -1,4 +1,5 @@
 #include "heimdall/transform.h"
+#include "heimdall/interaction.h"
 
 HEIMDALL_NAMESPACE_BEGIN
 
@@ -60,6 +61,39 @@ Transform Transpose(const Transform& t) {
 	return Transform(Transpose(t.m), Transpose(t.mInv));
 }
 
+SurfaceInteraction Transform::operator()(const SurfaceInteraction& si) const {
+	SurfaceInteraction ret;
+
+	/// Transform geometric terms of the interaction
+	ret.p = (*this)(si.p);
+	ret.error = Abs((*this)(si.error));
+	ret.n = Normalize((*this)(si.n));
+	ret.wo = Normalize((*this)(si.wo));
+	ret.time = si.time;
+	ret.uv = si.uv;
+	ret.shape = si.shape;
+	ret.instanceID = si.instanceID;
+	ret.dpdu = (*this)(si.dpdu);
+	ret.dpdv = (*this)(si.dpdv);
+	ret.dndu = (*this)(si.dndu);
+	ret.dndv = (*this)(si.dndv);
+
+	/// Transform explicit shading geometry, keeping it in the geometric
+	/// hemisphere. Otherwise it is derived from the terms above on first use.
+	ret.hasShadingGeometry = si.hasShadingGeometry;
+	if (si.hasShadingGeometry) {
+		ret.shading.dpdu = (*this)(si.shading.dpdu);
+		ret.shading.dpdv = (*this)(si.shading.dpdv);
+		ret.shading.dndu = (*this)(si.shading.dndu);
+		ret.shading.dndv = (*this)(si.shading.dndv);
+		if (si.shadingValid) {
+			ret.shading.n = Faceforward(Normalize((*this)(si.shading.n)), ret.n);
+			ret.shadingValid = true;
+		}
+	}
+	return ret;
+}
+
 Transform Translate(const Vec3f& delta) {
 	Matrix m(1, 0, 0, delta.x,
 			 0, 1, 0, delta.y,
@@ -172,6 +206,22 @@ Transform LookAt(const Point3f& pos, const Point3f& look, const Vec3f& up) {
     return Transform(Inverse(cameraToWorld), cameraToWorld);
 }
 
+Transform Orthographic(float zNear, float zFar) {
+	return Scale(1.0f, 1.0f, 1.0f / (zFar - zNear)) * Translate(Vec3f(0.0f, 0.0f, -zNear));
+}
+
+Transform Perspective(float fov, float n, float f) {
+	/// Project onto z = 1 and map [n, f] to [0, 1]
+	Matrix persp(1, 0, 0,           0,
+				 0, 1, 0,           0,
+				 0, 0, f / (f - n), -f * n / (f - n),
+				 0, 0, 1,           0);
+
+	/// Scale the field of view to [-1, 1]
+	float invTanAng = 1.0f / std::tan(Radians(fov) / 2.0f);
+	return Scale(invTanAng, invTanAng, 1.0f) * Transform(persp);
+}
+
 /**
  * \breif AnimatedTransform method definitions
  */
@@ -180,8 +230,8 @@ AnimatedTransform::AnimatedTransform(const Transform* startTransform, float star
                       			 	 const Transform* endTransform,   float endTime)
 			: startTransform(startTransform), endTransform(endTransform),
 			  startTime(startTime), endTime(endTime),
-			  actuallyAnimated(*startTransform != *endTransform) {
-	if (!actuallyAnimated) {
+			  actuallyAnimated(*startTransform != *endTransform), hasRotation(false) {
+	if (actuallyAnimated) {
 
 		Decompose(startTransform->m, &T[0], &R[0], &S[0]);
 		Decompose(endTransform->m, &T[1], &R[1], &S[1]);
@@ -217,7 +267,7 @@ void AnimatedTransform::Decompose(const Matrix& mSRT, Vec3f* T, Quaternion* R, M
 	do {
 		/// Compute next matrix in series
 		Matrix mRnext;
-		Matrix mRit = Inverse(Transpose(mRnext));
+		Matrix mRit = Inverse(Transpose(mR));
 		for (int i = 0; i < 4; ++i) {
 			for (int j = 0; j < 4; ++j) {
 				mRnext.m[i][j] = 0.5f * (mR.m[i][j] + mRit.m[i][j]);
@@ -232,6 +282,7 @@ void AnimatedTransform::Decompose(const Matrix& mSRT, Vec3f* T, Quaternion* R, M
 					  std::abs(mR.m[i][2] - mRnext.m[i][2]);
 			norm = std::max(norm, n);
 		}
+		mR = mRnext;
 	} while (++count < 100 and norm > 0.0001f);
 	*R = Quaternion(mR);
 
@@ -270,4 +321,56 @@ void AnimatedTransform::Interpolate(float time, Transform* t) const {
 	*t = Translate(trans) * quat.ToTransform() * Transform(scale);
 }
 
+bool AnimatedTransform::IsAnimated() const {
+	return actuallyAnimated;
+}
+
+Ray AnimatedTransform::operator()(const Ray& r) const {
+	if (!actuallyAnimated or r.time <= startTime) {
+		return (*startTransform)(r);
+	}
+	if (r.time >= endTime) {
+		return (*endTransform)(r);
+	}
+	Transform t;
+	Interpolate(r.time, &t);
+	return t(r);
+}
+
+RayDifferential AnimatedTransform::operator()(const RayDifferential& r) const {
+	if (!actuallyAnimated or r.time <= startTime) {
+		return (*startTransform)(r);
+	}
+	if (r.time >= endTime) {
+		return (*endTransform)(r);
+	}
+	Transform t;
+	Interpolate(r.time, &t);
+	return t(r);
+}
+
+Point3f AnimatedTransform::operator()(float time, const Point3f& p) const {
+	if (!actuallyAnimated or time <= startTime) {
+		return (*startTransform)(p);
+	}
+	if (time >= endTime) {
+		return (*endTransform)(p);
+	}
+	Transform t;
+	Interpolate(time, &t);
+	return t(p);
+}
+
+Vec3f AnimatedTransform::operator()(float time, const Vec3f& v) const {
+	if (!actuallyAnimated or time <= startTime) {
+		return (*startTransform)(v);
+	}
+	if (time >= endTime) {
+		return (*endTransform)(v);
+	}
+	Transform t;
+	Interpolate(time, &t);
+	return t(v);
+}
+
 HEIMDALL_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "heimdall/traversal.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief TraversalIterator method definitions
+ */
+
+TraversalIterator::TraversalIterator(const Bounds2i& bounds, TraversalOrder order, int64_t n)
+    : b(bounds), order(order), n(n), count(Traversal(bounds, order).Count()), p(bounds.pMin),
+      side(1), block(0), blocksAlongX(true), d(0), ring(0), ringSide(3), step(0), stepEnd(1) {
+    if (n >= count) {
+        return;
+    }
+    Vec2i extent = b.Diagonal();
+    switch (order) {
+        case TraversalOrder::RowMajor:
+            p = Point2i(b.pMin.x + int(n % extent.x), b.pMin.y + int(n / extent.x));
+            return;
+        case TraversalOrder::Morton:
+        case TraversalOrder::Hilbert:
+            /// Squares as large as the short side allows, along the long side
+            blocksAlongX = extent.x >= extent.y;
+            while (side < std::min(extent.x, extent.y)) {
+                side *= 2;
+            }
+            p = CurvePoint();
+            break;
+        case TraversalOrder::Spiral:
+            center = Point2i(b.pMin.x + (extent.x - 1) / 2, b.pMin.y + (extent.y - 1) / 2);
+            p = center;
+            break;
+    }
+
+    /// Both curves and the spiral start inside the bounds, walk to the nth point
+    for (int64_t i = 0; i < n; ++i) {
+        Iterate();
+    }
+}
+
+void TraversalIterator::Iterate() {
+    switch (order) {
+        case TraversalOrder::RowMajor:
+            ++p.x;
+            if (p.x == b.pMax.x) {
+                p.x = b.pMin.x;
+                ++p.y;
+            }
+            break;
+        case TraversalOrder::Morton:
+        case TraversalOrder::Hilbert:
+            do {
+                if (++d == uint64_t(side) * side) {
+                    d = 0;
+                    ++block;
+                }
+                p = CurvePoint();
+            } while (!InsideExclusive(p, b));
+            break;
+        case TraversalOrder::Spiral:
+            if (++step == stepEnd) {
+                NextSpiralSide();
+            }
+            p = sideStart + sideDir * step;
+            break;
+    }
+}
+
+Point2i TraversalIterator::CurvePoint() const {
+    Point2i q = order == TraversalOrder::Morton ? DecodeMorton2(d) : DecodeHilbert2(side, d);
+
+    /// Hilbert squares end on the edge the next square starts from
+    if (blocksAlongX) {
+        return Point2i(b.pMin.x + block * side + q.x, b.pMin.y + q.y);
+    }
+    return Point2i(b.pMin.x + q.y, b.pMin.y + block * side + q.x);
+}
+
+void TraversalIterator::NextSpiralSide() {
+    /// Sides of ring r run clockwise, 2r steps each, starting at a corner
+    static const int cornerX[4] = {-1, 1, 1, -1};
+    static const int cornerY[4] = {-1, -1, 1, 1};
+    static const int dirX[4] = {1, 0, -1, 0};
+    static const int dirY[4] = {0, 1, 0, -1};
+
+    while (true) {
+        if (++ringSide == 4) {
+            ringSide = 0;
+            ++ring;
+        }
+        sideStart = Point2i(center.x + cornerX[ringSide] * ring, center.y + cornerY[ringSide] * ring);
+        sideDir = Vec2i(dirX[ringSide], dirY[ringSide]);
+
+        /// Clip the steps to the bounds along the side, the fixed
+        /// coordinate is either inside or the side is skipped entirely
+        bool alongX = sideDir.x != 0;
+        int start = alongX ? sideStart.x : sideStart.y;
+        int dir = alongX ? sideDir.x : sideDir.y;
+        int fixed = alongX ? sideStart.y : sideStart.x;
+        int fixedMin = alongX ? b.pMin.y : b.pMin.x, fixedMax = alongX ? b.pMax.y : b.pMax.x;
+        int stepMin = alongX ? b.pMin.x : b.pMin.y, stepMax = alongX ? b.pMax.x : b.pMax.y;
+        if (fixed < fixedMin or fixed >= fixedMax) {
+            continue;
+        }
+        int lo = dir > 0 ? stepMin - start : start - stepMax + 1;
+        int hi = dir > 0 ? stepMax - start : start - stepMin + 1;
+        step = std::max(lo, 0);
+        stepEnd = std::min(hi, 2 * ring);
+        if (step < stepEnd) {
+            return;
+        }
+    }
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,234 @@
+#include "heimdall/triangle.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief TriangleMesh method definitions
+ */
+
+TriangleMesh::TriangleMesh(const Transform& ObjectToWorld, int nTriangles, const int* vertexIndices,
+        int nVertices, const Point3f* P, const Normal3f* N, const Point2f* UV)
+    : nTriangles(nTriangles), nVertices(nVertices),
+      vertexIndices(vertexIndices, vertexIndices + 3 * nTriangles) {
+
+    /// Transform mesh vertices to world space
+    p.resize(nVertices);
+    for (int i = 0; i < nVertices; ++i) {
+        p[i] = ObjectToWorld(P[i]);
+    }
+    if (N) {
+        n.resize(nVertices);
+        for (int i = 0; i < nVertices; ++i) {
+            n[i] = ObjectToWorld(N[i]);
+        }
+    }
+    if (UV) {
+        uv.assign(UV, UV + nVertices);
+    }
+}
+
+/// Interaction at a hit on the triangle of mesh with vertex indices v
+static void MeshTriangleInteraction(const Shape* shape, const TriangleMesh& mesh, const int* v, const Ray& r,
+        const HitRecord& hit, SurfaceInteraction* isect) {
+    Point3f p[3] = {mesh.p[v[0]], mesh.p[v[1]], mesh.p[v[2]]};
+    Normal3f n[3];
+    Point2f uv[3];
+    for (int i = 0; i < 3; ++i) {
+        if (!mesh.n.empty()) {
+            n[i] = mesh.n[v[i]];
+        }
+        if (!mesh.uv.empty()) {
+            uv[i] = mesh.uv[v[i]];
+        }
+    }
+    TriangleInteraction(shape, r, hit, p, mesh.n.empty() ? nullptr : n, mesh.uv.empty() ? nullptr : uv, isect);
+}
+
+/**
+ * \brief Triangle method definitions
+ */
+
+Triangle::Triangle(const Transform* ObjectToWorld, const Transform* WorldToObject, bool reverseOrientation,
+        const std::shared_ptr<const TriangleMesh>& mesh, int triNumber)
+    : Shape(ObjectToWorld, WorldToObject, reverseOrientation), mesh(mesh),
+      v(&mesh->vertexIndices[3 * triNumber]) {}
+
+Bounds3f Triangle::ObjectBounds() const {
+    return Union(Bounds3f((*WorldToObject)(mesh->p[v[0]]), (*WorldToObject)(mesh->p[v[1]])),
+        (*WorldToObject)(mesh->p[v[2]]));
+}
+
+Bounds3f Triangle::WorldBounds() const {
+    return Union(Bounds3f(mesh->p[v[0]], mesh->p[v[1]]), mesh->p[v[2]]);
+}
+
+bool Triangle::Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool testSurfaceAlpha) const {
+    HitRecord hit;
+    if (!IntersectHit(r, &hit, testSurfaceAlpha)) {
+        return false;
+    }
+    ComputeSurfaceInteraction(r, hit, isect);
+    *tHit = hit.t;
+    return true;
+}
+
+bool Triangle::IntersectTest(const Ray& r, bool testSurfaceAlpha) const {
+    HitRecord hit;
+    return IntersectHit(r, &hit, testSurfaceAlpha);
+}
+
+float Triangle::Area() const {
+    return 0.5f * Cross(mesh->p[v[1]] - mesh->p[v[0]], mesh->p[v[2]] - mesh->p[v[0]]).Length();
+}
+
+void Triangle::ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit, SurfaceInteraction* isect) const {
+    MeshTriangleInteraction(this, *mesh, v, r, hit, isect);
+}
+
+/**
+ * \brief TriangleMeshShape method definitions
+ */
+
+TriangleMeshShape::TriangleMeshShape(const Transform* ObjectToWorld, const Transform* WorldToObject,
+        bool reverseOrientation, std::shared_ptr<const TriangleMesh> mesh)
+    : Shape(ObjectToWorld, WorldToObject, reverseOrientation), mesh(std::move(mesh)) {}
+
+Bounds3f TriangleMeshShape::ObjectBounds() const {
+    return (*WorldToObject)(WorldBounds());
+}
+
+Bounds3f TriangleMeshShape::WorldBounds() const {
+    Bounds3f bounds;
+    for (const Point3f& p : mesh->p) {
+        bounds = Union(bounds, p);
+    }
+    return bounds;
+}
+
+bool TriangleMeshShape::Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool) const {
+    Ray ray = r;
+    HitRecord hit;
+    int closest = -1;
+    for (int i = 0; i < mesh->nTriangles; ++i) {
+        if (IntersectHit(ray, i, &hit)) {
+            ray.tMax = hit.t;
+            closest = i;
+        }
+    }
+    if (closest < 0) {
+        return false;
+    }
+    ComputeSurfaceInteraction(r, closest, hit, isect);
+    *tHit = hit.t;
+    return true;
+}
+
+bool TriangleMeshShape::IntersectTest(const Ray& r, bool) const {
+    HitRecord hit;
+    for (int i = 0; i < mesh->nTriangles; ++i) {
+        if (IntersectHit(r, i, &hit)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+float TriangleMeshShape::Area() const {
+    float area = 0.0f;
+    for (int i = 0; i < mesh->nTriangles; ++i) {
+        const int* v = &mesh->vertexIndices[3 * i];
+        area += 0.5f * Cross(mesh->p[v[1]] - mesh->p[v[0]], mesh->p[v[2]] - mesh->p[v[0]]).Length();
+    }
+    return area;
+}
+
+Bounds3f TriangleMeshShape::TriangleBounds(int triNumber) const {
+    const int* v = &mesh->vertexIndices[3 * triNumber];
+    return Union(Bounds3f(mesh->p[v[0]], mesh->p[v[1]]), mesh->p[v[2]]);
+}
+
+void TriangleMeshShape::ComputeSurfaceInteraction(const Ray& r, int triNumber, const HitRecord& hit,
+        SurfaceInteraction* isect) const {
+    MeshTriangleInteraction(this, *mesh, &mesh->vertexIndices[3 * triNumber], r, hit, isect);
+}
+
+/**
+ * \brief Triangle function definitions
+ */
+
+void TriangleInteraction(const Shape* shape, const Ray& r, const HitRecord& hit, const Point3f p[3],
+        const Normal3f* n, const Point2f* UV, SurfaceInteraction* isect) {
+    const Point3f& p0 = p[0];
+    const Point3f& p1 = p[1];
+    const Point3f& p2 = p[2];
+    Point2f uv[3];
+    if (!UV) {
+        uv[0] = Point2f(0.0f, 0.0f);
+        uv[1] = Point2f(1.0f, 0.0f);
+        uv[2] = Point2f(1.0f, 1.0f);
+    } else {
+        uv[0] = UV[0];
+        uv[1] = UV[1];
+        uv[2] = UV[2];
+    }
+
+    /// Compute partial derivatives from the uv parameterization
+    Vec2f duv02 = uv[0] - uv[2], duv12 = uv[1] - uv[2];
+    Vec3f dp02 = p0 - p2, dp12 = p1 - p2;
+    float determinant = duv02.x * duv12.y - duv02.y * duv12.x;
+    Vec3f dpdu, dpdv;
+    bool degenerateUV = std::abs(determinant) < 1e-8f;
+    if (!degenerateUV) {
+        float invdet = 1.0f / determinant;
+        dpdu = (dp02 * duv12.y - dp12 * duv02.y) * invdet;
+        dpdv = (dp12 * duv02.x - dp02 * duv12.x) * invdet;
+    }
+    if (degenerateUV or Cross(dpdu, dpdv).LengthSquared() == 0.0f) {
+        CoordinateSystem(Normalize(Cross(p2 - p0, p1 - p0)), &dpdu, &dpdv);
+    }
+
+    /// Interpolate hit point and uv from the barycentrics
+    float b1 = hit.uv.x, b2 = hit.uv.y, b0 = 1.0f - b1 - b2;
+    Point3f pHit = p0 * b0 + p1 * b1 + p2 * b2;
+    Point2f uvHit = uv[0] * b0 + uv[1] * b1 + uv[2] * b2;
+    *isect = SurfaceInteraction(pHit, Vec3f(), uvHit, -r.d, dpdu, dpdv, Normal3f(), Normal3f(), r.time, shape);
+
+    /// The geometric normal follows the vertex winding
+    isect->n = Normal3f(Normalize(Cross(dp02, dp12)));
+    if (shape->reverseOrientation ^ shape->transformSwapsHandedness) {
+        isect->n = -isect->n;
+    }
+
+    /// Shading frame from interpolated vertex normals
+    if (n) {
+        Normal3f ns = n[0] * b0 + n[1] * b1 + n[2] * b2;
+        if (ns.LengthSquared() > 0.0f) {
+            ns = Normalize(ns);
+            Vec3f nsv(ns.x, ns.y, ns.z);
+            Vec3f ss = Normalize(isect->dpdu);
+            Vec3f ts = Cross(nsv, ss);
+            if (ts.LengthSquared() > 0.0f) {
+                ts = Normalize(ts);
+                ss = Cross(ts, nsv);
+            } else {
+                CoordinateSystem(nsv, &ss, &ts);
+            }
+            isect->SetShadingGeometry(ss, ts, Normal3f(), Normal3f(), true);
+        }
+    }
+}
+
+std::vector<std::shared_ptr<Shape>> CreateTriangleMesh(const Transform* ObjectToWorld,
+        const Transform* WorldToObject, bool reverseOrientation, int nTriangles, const int* vertexIndices,
+        int nVertices, const Point3f* P, const Normal3f* N, const Point2f* UV) {
+    std::shared_ptr<const TriangleMesh> mesh = std::make_shared<TriangleMesh>(*ObjectToWorld, nTriangles,
+        vertexIndices, nVertices, P, N, UV);
+    std::vector<std::shared_ptr<Shape>> tris;
+    tris.reserve(nTriangles);
+    for (int i = 0; i < nTriangles; ++i) {
+        tris.push_back(std::make_shared<Triangle>(ObjectToWorld, WorldToObject, reverseOrientation, mesh, i));
+    }
+    return tris;
+}
+
+HEIMDALL_NAMESPACE_END
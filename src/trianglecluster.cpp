@@ -0,0 +1,129 @@
+#include "heimdall/trianglecluster.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/**
+ * \brief TriangleCluster method definitions
+ */
+
+TriangleCluster::TriangleCluster() {
+    for (int i = 0; i < clusterWidth; ++i) {
+        p0x[i] = p0y[i] = p0z[i] = 0.0f;
+        e1x[i] = e1y[i] = e1z[i] = 0.0f;
+        e2x[i] = e2y[i] = e2z[i] = 0.0f;
+        primID[i] = -1;
+    }
+}
+
+/**
+ * \brief TriangleClusterAccel method definitions
+ */
+
+TriangleClusterAccel::TriangleClusterAccel(const Transform* ObjectToWorld, const Transform* WorldToObject,
+        bool reverseOrientation, std::shared_ptr<const TriangleMesh> mesh, SplitMethod splitMethod)
+    : shape(ObjectToWorld, WorldToObject, reverseOrientation, std::move(mesh)) {
+    const TriangleMesh& m = *shape.mesh;
+    std::vector<BVHPrimitiveInfo> primitiveInfo(m.nTriangles);
+    for (int i = 0; i < m.nTriangles; ++i) {
+        primitiveInfo[i] = BVHPrimitiveInfo(i, shape.TriangleBounds(i));
+    }
+
+    /// Spatial splits would duplicate triangles across clusters
+    if (splitMethod == SplitMethod::SBVH) {
+        splitMethod = SplitMethod::SAH;
+    }
+    bvh = BVH(std::move(primitiveInfo), TriangleCluster::clusterWidth, splitMethod);
+
+    /// A cluster costs one kernel call however full it is, so pack
+    /// small subtrees into single leaves
+    bvh.CollapseSubtrees(TriangleCluster::clusterWidth);
+
+    /// Gather the triangles of every leaf into consecutive clusters
+    const LinearBVHNode* nodes = bvh.Nodes();
+    const int* indices = bvh.PrimitiveIndices();
+    leafClusters.assign(bvh.PrimitiveIndexCount(), -1);
+    for (int n = 0; n < bvh.NodeCount(); ++n) {
+        const LinearBVHNode& node = nodes[n];
+        if (node.nPrimitives == 0) {
+            continue;
+        }
+        leafClusters[node.primitivesOffset] = int(clusters.size());
+        for (int i = 0; i < node.nPrimitives; ++i) {
+            int lane = i % TriangleCluster::clusterWidth;
+            if (lane == 0) {
+                clusters.push_back(TriangleCluster());
+            }
+            TriangleCluster& cluster = clusters.back();
+            int primID = indices[node.primitivesOffset + i];
+            const int* v = &m.vertexIndices[3 * primID];
+            const Point3f& p0 = m.p[v[0]];
+            Vec3f e1 = m.p[v[1]] - p0;
+            Vec3f e2 = m.p[v[2]] - p0;
+            cluster.p0x[lane] = p0.x;
+            cluster.p0y[lane] = p0.y;
+            cluster.p0z[lane] = p0.z;
+            cluster.e1x[lane] = e1.x;
+            cluster.e1y[lane] = e1.y;
+            cluster.e1z[lane] = e1.z;
+            cluster.e2x[lane] = e2.x;
+            cluster.e2y[lane] = e2.y;
+            cluster.e2z[lane] = e2.z;
+            cluster.primID[lane] = primID;
+        }
+    }
+}
+
+Bounds3f TriangleClusterAccel::WorldBound() const {
+    return bvh.WorldBound();
+}
+
+int TriangleClusterAccel::ClusterCount() const {
+    return int(clusters.size());
+}
+
+bool TriangleClusterAccel::Intersect(const Ray& r, SurfaceInteraction* isect) const {
+    HitRecord hit;
+    if (!Intersect(r, &hit)) {
+        return false;
+    }
+    ComputeSurfaceInteraction(r, hit, isect);
+    return true;
+}
+
+bool TriangleClusterAccel::Intersect(const Ray& r, HitRecord* hit) const {
+    return bvh.IntersectLeaves(r, [&](int primitivesOffset, int nPrimitives) {
+        const TriangleCluster* cluster = &clusters[leafClusters[primitivesOffset]];
+        int nClusters = (nPrimitives + TriangleCluster::clusterWidth - 1) / TriangleCluster::clusterWidth;
+        bool found = false;
+        for (int c = 0; c < nClusters; ++c) {
+            int lane = cluster[c].Intersect(r, hit);
+            if (lane >= 0) {
+                r.tMax = hit->t;
+                hit->primID = cluster[c].primID[lane];
+                found = true;
+            }
+        }
+        return found;
+    });
+}
+
+bool TriangleClusterAccel::IntersectP(const Ray& r) const {
+    return bvh.IntersectPLeaves(r, [&](int primitivesOffset, int nPrimitives) {
+        const TriangleCluster* cluster = &clusters[leafClusters[primitivesOffset]];
+        int nClusters = (nPrimitives + TriangleCluster::clusterWidth - 1) / TriangleCluster::clusterWidth;
+        HitRecord hit;
+        for (int c = 0; c < nClusters; ++c) {
+            if (cluster[c].Intersect(r, &hit) >= 0) {
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+void TriangleClusterAccel::ComputeSurfaceInteraction(const Ray& r, const HitRecord& hit,
+        SurfaceInteraction* isect) const {
+    shape.ComputeSurfaceInteraction(r, hit.primID, hit, isect);
+}
+
+HEIMDALL_NAMESPACE_END
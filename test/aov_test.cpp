@@ -0,0 +1,201 @@
+#include "gtest/gtest.h"
+#include "heimdall/aov.h"
+#include "heimdall/motionbvh.h"
+#include "heimdall/parallel.h"
+#include "heimdall/render.h"
+#include "heimdall/scene.h"
+#include "heimdall/sphere.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+TEST(AOV, Layout) {
+    /// Only enabled AOVs get floats
+    AOVLayout none;
+    EXPECT_EQ(none.nFloats, 0);
+    EXPECT_EQ(none.nChannels, 0);
+    EXPECT_TRUE(none.ChannelNames().empty());
+
+    AOVLayout some(AOVDepth | AOVObjectID, 4);
+    EXPECT_EQ(some.nLights, 0);
+    EXPECT_EQ(some.nChannels, 2);
+    EXPECT_EQ(some.ChannelNames(), std::vector<std::string>({"Z", "objectID"}));
+
+    AOVLayout all(AOVAll, 2);
+    EXPECT_EQ(all.nChannels, 1 + 3 + 3 + 1 + 6);
+    EXPECT_EQ(all.ChannelNames().back(), "light1.B");
+
+    /// Merging keeps the object ID of the samples merged first
+    std::vector<float> a(some.nFloats, 0.0f), b(some.nFloats, 0.0f);
+    AOVSample sample(some);
+    Ray ray(Point3f(0.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f));
+    SurfaceInteraction isect;
+    isect.p = Point3f(0.0f, 0.0f, 2.0f);
+    isect.instanceID = 3;
+    sample.SetHit(ray, isect);
+    some.Accumulate(a.data(), sample);
+    isect.p = Point3f(0.0f, 0.0f, 4.0f);
+    isect.instanceID = 5;
+    sample.SetHit(ray, isect);
+    some.Accumulate(b.data(), sample);
+    sample.Reset();
+    some.Accumulate(b.data(), sample);
+    some.Merge(a.data(), b.data());
+    float values[2];
+    some.Resolve(a.data(), values);
+    EXPECT_FLOAT_EQ(values[0], 3.0f);
+    EXPECT_EQ(values[1], 3.0f);
+
+    /// IDs are exact up to the float mantissa
+    std::vector<float> c(some.nFloats, 0.0f);
+    isect.instanceID = (1 << 24) - 1;
+    sample.SetHit(ray, isect);
+    some.Accumulate(c.data(), sample);
+    some.Resolve(c.data(), values);
+    EXPECT_EQ(values[1], float((1 << 24) - 1));
+}
+
+TEST(AOV, Render) {
+    ParallelInit(4);
+
+    /// Two instances of a sphere in front of an orthographic camera
+    Transform identity;
+    std::vector<std::shared_ptr<Shape>> shapes;
+    shapes.push_back(std::make_shared<Sphere>(&identity, &identity, false, 0.8f));
+    Scene scene;
+    int geomID = scene.AddGeometry(std::move(shapes));
+    scene.AddInstance(geomID, Translate(Vec3f(-1.0f, 0.0f, 5.0f)));
+    scene.AddInstance(geomID, Translate(Vec3f(1.0f, 0.0f, 5.0f)));
+    scene.Commit();
+
+    std::atomic<int> aovRequests(0);
+    auto Li = [&](const RayDifferential& ray, Sampler&, AOVSample* aov) {
+        Ray r = ray;
+        HitRecord hit;
+        if (!scene.Intersect1(r, &hit)) {
+            return RGB();
+        }
+        if (aov) {
+            ++aovRequests;
+            SurfaceInteraction isect;
+            scene.ComputeSurfaceInteraction(ray, hit, &isect);
+            aov->SetHit(ray, isect);
+            aov->albedo = RGB(0.2f, 0.4f, 0.6f);
+            aov->lightContributions[0] += RGB(0.25f, 0.25f, 0.25f);
+            aov->lightContributions[1] += RGB(0.75f, 0.75f, 0.75f);
+        }
+        return RGB(1.0f, 1.0f, 1.0f);
+    };
+
+    Transform cameraToWorld;
+    AnimatedTransform animated(&cameraToWorld, 0.0f, &cameraToWorld, 1.0f);
+    Point2i resolution(32, 16);
+    AdaptiveSettings settings;
+    settings.noiseThreshold = 0.0f;
+
+    /// A beauty only film never asks for AOVs
+    Film beauty(resolution, std::unique_ptr<Filter>(new BoxFilter(Vec2f(0.5f, 0.5f))));
+    OrthographicCamera beautyCamera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, &beauty);
+    RenderAdaptive(beautyCamera, SobolSampler(16), Li, settings);
+    EXPECT_EQ(aovRequests, 0);
+    EXPECT_EQ(beauty.GetChannelNames().size(), size_t(3));
+
+    Film film(resolution, std::unique_ptr<Filter>(new BoxFilter(Vec2f(0.5f, 0.5f))), 16, 0,
+              AOVLayout(AOVAll, 2));
+    OrthographicCamera camera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, &film);
+    RenderAdaptive(camera, SobolSampler(16), Li, settings);
+    ParallelCleanup();
+    EXPECT_GT(aovRequests, 0);
+    ASSERT_EQ(film.aovLayout.nChannels, 14);
+
+    std::vector<float> values(film.aovLayout.nChannels);
+    auto aovsAt = [&](int x, int y) {
+        film.GetAOVRegion(Bounds2i(Point2i(x, y), Point2i(x + 1, y + 1)), values.data());
+        return values;
+    };
+
+    /// Centers of the two spheres, front surface about 4.2 away
+    for (int x : {8, 24}) {
+        std::vector<float> v = aovsAt(x, 8);
+        EXPECT_NEAR(v[0], 5.0f - 0.795f, 0.02f);
+        EXPECT_GT(std::abs(v[3]), 0.95f);
+        EXPECT_NEAR(v[4], 0.2f, 1e-5f);
+        EXPECT_NEAR(v[6], 0.6f, 1e-5f);
+        EXPECT_EQ(v[7], x == 8 ? 0.0f : 1.0f);
+        EXPECT_NEAR(v[8], 0.25f, 1e-5f);
+        EXPECT_NEAR(v[11], 0.75f, 1e-5f);
+    }
+
+    /// Misses keep the defaults, light contributions of a partly covered
+    /// pixel average over every sample
+    std::vector<float> miss = aovsAt(0, 0);
+    EXPECT_EQ(miss[0], 0.0f);
+    EXPECT_EQ(miss[7], -1.0f);
+    EXPECT_EQ(miss[8], 0.0f);
+    for (int x = 0; x < 32; ++x) {
+        float light0 = aovsAt(x, 8)[8];
+        EXPECT_NEAR(light0, 0.25f * film.GetPixel(Point2i(x, 8)).x, 1e-5f);
+    }
+
+    /// All channels interleaved for writing
+    std::vector<float> channels(17);
+    film.GetChannelRegion(Bounds2i(Point2i(24, 8), Point2i(25, 9)), channels.data());
+    EXPECT_EQ(channels[0], 1.0f);
+    EXPECT_EQ(channels[3 + 7], 1.0f);
+    EXPECT_EQ(film.GetChannelNames()[3], "Z");
+}
+
+TEST(AOV, MotionInstances) {
+    ParallelInit(4);
+
+    /// Two instances of a sphere moving sideways during the shutter
+    Transform identity;
+    std::vector<std::shared_ptr<Shape>> shapes;
+    shapes.push_back(std::make_shared<Sphere>(&identity, &identity, false, 0.8f));
+    auto blas = std::make_shared<BVHAccel>(shapes);
+    Transform starts[2] = {Translate(Vec3f(-1.1f, 0.0f, 5.0f)), Translate(Vec3f(0.9f, 0.0f, 5.0f))};
+    Transform ends[2] = {Translate(Vec3f(-0.9f, 0.0f, 5.0f)), Translate(Vec3f(1.1f, 0.0f, 5.0f))};
+    std::vector<AnimatedTransform> transforms;
+    for (int i = 0; i < 2; ++i) {
+        transforms.push_back(AnimatedTransform(&starts[i], 0.0f, &ends[i], 1.0f));
+    }
+    std::vector<MotionInstance> instances;
+    for (int i = 0; i < 2; ++i) {
+        instances.push_back(MotionInstance(blas, &transforms[i]));
+    }
+    MotionInstanceAccel accel(instances, 0.0f, 1.0f);
+
+    auto Li = [&](const RayDifferential& ray, Sampler&, AOVSample* aov) {
+        Ray r = ray;
+        HitRecord hit;
+        if (!accel.Intersect(r, &hit)) {
+            return RGB();
+        }
+        if (aov) {
+            SurfaceInteraction isect;
+            accel.ComputeSurfaceInteraction(ray, hit, &isect);
+            aov->SetHit(ray, isect);
+        }
+        return RGB(1.0f, 1.0f, 1.0f);
+    };
+
+    Transform cameraToWorld;
+    AnimatedTransform animated(&cameraToWorld, 0.0f, &cameraToWorld, 1.0f);
+    Point2i resolution(32, 16);
+    AdaptiveSettings settings;
+    settings.noiseThreshold = 0.0f;
+    Film film(resolution, std::unique_ptr<Filter>(new BoxFilter(Vec2f(0.5f, 0.5f))), 16, 0,
+              AOVLayout(AOVObjectID));
+    OrthographicCamera camera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, &film);
+    RenderAdaptive(camera, SobolSampler(16), Li, settings);
+    ParallelCleanup();
+
+    float objectID;
+    for (int x : {8, 24}) {
+        film.GetAOVRegion(Bounds2i(Point2i(x, 8), Point2i(x + 1, 9)), &objectID);
+        EXPECT_EQ(objectID, x == 8 ? 0.0f : 1.0f);
+    }
+    film.GetAOVRegion(Bounds2i(Point2i(0, 0), Point2i(1, 1)), &objectID);
+    EXPECT_EQ(objectID, -1.0f);
+}
+
+HEIMDALL_NAMESPACE_END
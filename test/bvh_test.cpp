@@ -0,0 +1,758 @@
+#include "gtest/gtest.h"
+#include "heimdall/bvh.h"
+#include "heimdall/bvhcache.h"
+#include "heimdall/instance.h"
+#include "heimdall/motionbvh.h"
+#include "heimdall/shapearrays.h"
+#include "heimdall/trianglecluster.h"
+#include "heimdall/interaction.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Minimal sphere centered at the object space origin
+class TestSphere: public Shape {
+  public:
+    TestSphere(const Transform* ObjectToWorld, const Transform* WorldToObject, float radius)
+        : Shape(ObjectToWorld, WorldToObject, false), radius(radius) {}
+
+    Bounds3f ObjectBounds() const {
+        return Bounds3f(Point3f(-radius, -radius, -radius), Point3f(radius, radius, radius));
+    }
+
+    bool Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool = true) const {
+        Ray ray = (*WorldToObject)(r);
+        float t;
+        if (!Hit(ray, &t)) {
+            return false;
+        }
+        Point3f p = ray(t);
+        Vec3f n = Normalize(Vec3f(p));
+        Vec3f dpdu, dpdv;
+        CoordinateSystem(n, &dpdu, &dpdv);
+        *isect = (*ObjectToWorld)(SurfaceInteraction(p, Vec3f(), Point2f(), -ray.d, dpdu, dpdv,
+            Normal3f(), Normal3f(), ray.time, this));
+        *tHit = t;
+        return true;
+    }
+
+    bool IntersectTest(const Ray& r, bool = true) const {
+        float t;
+        return Hit((*WorldToObject)(r), &t);
+    }
+
+    float Area() const {
+        return 4.0f * M_PI * radius * radius;
+    }
+
+  private:
+    float radius;
+
+    bool Hit(const Ray& ray, float* t) const {
+        Vec3f o(ray.o);
+        float a = Dot(ray.d, ray.d);
+        float b = 2.0f * Dot(ray.d, o);
+        float c = Dot(o, o) - radius * radius;
+        float disc = b * b - 4.0f * a * c;
+        if (disc < 0.0f) {
+            return false;
+        }
+        float root = std::sqrt(disc);
+        float t0 = (-b - root) / (2.0f * a);
+        float t1 = (-b + root) / (2.0f * a);
+        *t = t0 > 0.0f ? t0 : t1;
+        return *t > 0.0f and *t < ray.tMax;
+    }
+};
+
+/// Row of unit spheres along x at the given spacing
+class SphereRow {
+  public:
+    std::vector<Transform> toWorld, toObject;
+    std::vector<std::shared_ptr<Shape>> shapes;
+
+    SphereRow(int n, float spacing) : toWorld(n), toObject(n) {
+        for (int i = 0; i < n; ++i) {
+            toWorld[i] = Translate(Vec3f(i * spacing, 0.0f, 0.0f));
+            toObject[i] = Inverse(toWorld[i]);
+        }
+        for (int i = 0; i < n; ++i) {
+            shapes.push_back(std::make_shared<TestSphere>(&toWorld[i], &toObject[i], 1.0f));
+        }
+    }
+};
+
+/// Reference closest hit by testing every shape
+const Shape* BruteForceHit(const std::vector<std::shared_ptr<Shape>>& shapes, const Ray& r) {
+    Ray ray = r;
+    const Shape* closest = nullptr;
+    for (const auto& shape : shapes) {
+        float tHit;
+        SurfaceInteraction isect;
+        if (shape->Intersect(ray, &tHit, &isect)) {
+            ray.tMax = tHit;
+            closest = shape.get();
+        }
+    }
+    return closest;
+}
+
+void ExpectMatchesBruteForce(const BVHAccel& accel, const std::vector<std::shared_ptr<Shape>>& shapes) {
+    SurfaceInteraction isect;
+    for (int i = 0; i < 200; ++i) {
+        Ray r(Point3f(i * 7.7f, 10.0f, 0.5f), Vec3f(0.0f, -1.0f, 0.1f));
+        const Shape* expected = BruteForceHit(shapes, r);
+        ASSERT_EQ(accel.Intersect(r, &isect), expected != nullptr);
+        if (expected) {
+            EXPECT_EQ(isect.shape, expected);
+        }
+    }
+}
+
+TEST(BVHAccel, ClosestHit) {
+    SphereRow row(64, 3.0f);
+    BVHAccel accel(row.shapes, 2);
+
+    /// Ray travelling along -x hits the last sphere first
+    Ray ray(Point3f(500.0f, 0.0f, 0.0f), Vec3f(-1.0f, 0.0f, 0.0f));
+    SurfaceInteraction isect;
+    ASSERT_TRUE(accel.Intersect(ray, &isect));
+    EXPECT_EQ(isect.shape, row.shapes[63].get());
+    EXPECT_NEAR(isect.p.x, 63 * 3.0f + 1.0f, 1e-3f);
+    EXPECT_NEAR(ray.tMax, 500.0f - 190.0f, 1e-3f);
+
+    /// Rays from above hit each sphere individually
+    for (int i = 0; i < 64; ++i) {
+        Ray down(Point3f(i * 3.0f, 10.0f, 0.0f), Vec3f(0.0f, -1.0f, 0.0f));
+        ASSERT_TRUE(accel.Intersect(down, &isect));
+        EXPECT_EQ(isect.shape, row.shapes[i].get());
+        EXPECT_NEAR(down.tMax, 9.0f, 1e-3f);
+    }
+
+    Ray miss(Point3f(1.5f, 10.0f, 0.0f), Vec3f(0.0f, -1.0f, 0.0f));
+    EXPECT_FALSE(accel.Intersect(miss, &isect));
+    EXPECT_FALSE(accel.IntersectP(miss));
+}
+
+TEST(BVHAccel, SplitMethodsAgree) {
+    SphereRow row(33, 2.5f);
+    BVHAccel sah(row.shapes, 1, SplitMethod::SAH);
+    BVHAccel middle(row.shapes, 1, SplitMethod::Middle);
+    BVHAccel equal(row.shapes, 4, SplitMethod::EqualCounts);
+
+    for (int i = 0; i < 100; ++i) {
+        Point3f o(i * 0.9f - 5.0f, 5.0f, 0.3f);
+        Vec3f d(0.1f, -1.0f, 0.05f);
+        Ray r0(o, d), r1(o, d), r2(o, d);
+        SurfaceInteraction i0, i1, i2;
+        bool h0 = sah.Intersect(r0, &i0);
+        ASSERT_EQ(h0, middle.Intersect(r1, &i1));
+        ASSERT_EQ(h0, equal.Intersect(r2, &i2));
+        ASSERT_EQ(h0, sah.IntersectP(Ray(o, d)));
+        if (h0) {
+            EXPECT_EQ(i0.shape, i1.shape);
+            EXPECT_EQ(i0.shape, i2.shape);
+        }
+    }
+}
+
+TEST(BVHAccel, InterleavedMatchesSingleRay) {
+    SphereRow row(200, 2.5f);
+    BVHAccel accel(row.shapes, 2);
+
+    /// More rays than lanes, with a mix of hits, misses and directions
+    std::vector<Ray> rays;
+    for (int i = 0; i < 301; ++i) {
+        Vec3f d(0.3f * float(i % 7) - 0.9f, (i % 3 == 0) ? 1.0f : -1.0f, 0.02f * float(i % 5));
+        rays.push_back(Ray(Point3f(i * 1.7f, (i % 3 == 0) ? -8.0f : 8.0f, 0.1f), d));
+    }
+    std::vector<HitRecord> hits(rays.size());
+    accel.Intersect(rays.data(), int(rays.size()), hits.data());
+    int nHits = 0;
+    for (size_t i = 0; i < rays.size(); ++i) {
+        Ray ray = rays[i];
+        ray.tMax = INFINITY;
+        HitRecord expected;
+        bool found = accel.Intersect(ray, &expected);
+        ASSERT_EQ(hits[i].primID, expected.primID);
+        if (found) {
+            EXPECT_FLOAT_EQ(hits[i].t, expected.t);
+            EXPECT_FLOAT_EQ(rays[i].tMax, expected.t);
+            ++nHits;
+        }
+    }
+    EXPECT_GT(nHits, 100);
+    EXPECT_LT(nHits, 301);
+}
+
+TEST(BVHAccel, RefitRigidMotion) {
+    SphereRow row(3000, 3.0f);
+    BVHAccel accel(row.shapes, 2);
+
+    /// Translating everything keeps the tree quality, a refit is enough
+    for (size_t i = 0; i < row.toWorld.size(); ++i) {
+        row.toWorld[i] = Translate(Vec3f(0.0f, 5.0f, 0.0f)) * row.toWorld[i];
+        row.toObject[i] = Inverse(row.toWorld[i]);
+    }
+    EXPECT_EQ(accel.Update(), BVHUpdate::Refit);
+    EXPECT_NEAR(accel.WorldBound().pMax.y, 6.0f, 1e-3f);
+
+    SurfaceInteraction isect;
+    for (int i = 0; i < 3000; i += 37) {
+        Ray down(Point3f(i * 3.0f, 20.0f, 0.0f), Vec3f(0.0f, -1.0f, 0.0f));
+        ASSERT_TRUE(accel.Intersect(down, &isect));
+        EXPECT_EQ(isect.shape, row.shapes[i].get());
+        EXPECT_NEAR(down.tMax, 14.0f, 1e-3f);
+    }
+}
+
+TEST(BVHAccel, RebuildWhenDegraded) {
+    SphereRow row(512, 3.0f);
+    BVHAccel accel(row.shapes, 2);
+
+    /// Reverse the order of one half, which makes its subtrees overlap badly
+    for (int i = 0; i < 256; ++i) {
+        float x = (i % 2 == 0) ? i * 3.0f : (255 - i) * 3.0f;
+        row.toWorld[i] = Translate(Vec3f(x, 0.0f, float(i % 7)));
+        row.toObject[i] = Inverse(row.toWorld[i]);
+    }
+    EXPECT_EQ(accel.Update(1.1f), BVHUpdate::PartialRebuild);
+    ExpectMatchesBruteForce(accel, row.shapes);
+
+    /// Scramble everything, which can only be fixed by a full rebuild
+    for (int i = 0; i < 512; ++i) {
+        row.toWorld[i] = Translate(Vec3f(float((i * 193) % 512) * 3.0f, 0.0f, float(i % 5)));
+        row.toObject[i] = Inverse(row.toWorld[i]);
+    }
+    EXPECT_EQ(accel.Update(1.1f), BVHUpdate::FullRebuild);
+    ExpectMatchesBruteForce(accel, row.shapes);
+}
+
+TEST(BVH, SpatialSplitsCoverPrimitives) {
+    /// Long diagonal segments, the worst case for object partitioning
+    std::vector<Point3f> p0, p1;
+    for (int i = 0; i < 200; ++i) {
+        float offset = float(i % 20);
+        float z = float(i / 20);
+        p0.push_back(Point3f(offset, 0.0f, z));
+        p1.push_back(Point3f(offset + 40.0f, 40.0f, z + 0.5f));
+    }
+
+    /// Exact clipping of a segment against a box
+    auto clip = [&](size_t prim, const Bounds3f& box) {
+        float t0 = 0.0f, t1 = 1.0f;
+        Vec3f d = p1[prim] - p0[prim];
+        for (int axis = 0; axis < 3; ++axis) {
+            if (d[axis] == 0.0f) {
+                continue;
+            }
+            float tNear = (box.pMin[axis] - p0[prim][axis]) / d[axis];
+            float tFar = (box.pMax[axis] - p0[prim][axis]) / d[axis];
+            if (tNear > tFar) {
+                std::swap(tNear, tFar);
+            }
+            t0 = std::max(t0, tNear);
+            t1 = std::min(t1, tFar);
+        }
+        return Bounds3f(p0[prim] + d * t0, p0[prim] + d * t1);
+    };
+
+    std::vector<BVHPrimitiveInfo> info;
+    for (size_t i = 0; i < p0.size(); ++i) {
+        info.push_back(BVHPrimitiveInfo(i, Bounds3f(p0[i], p1[i])));
+    }
+    BVH sah(info, 1, SplitMethod::SAH);
+    BVH sbvh(info, 1, SplitMethod::SBVH, clip);
+
+    /// Duplication happened but stayed within budget, and paid off
+    EXPECT_GT(sbvh.PrimitiveIndexCount(), int(p0.size()));
+    EXPECT_LE(sbvh.PrimitiveIndexCount(), int(1.3f * p0.size()) + 1);
+    EXPECT_LT(sbvh.SAHCost(), sah.SAHCost());
+
+    /// Every point of every segment lies in some leaf referencing it
+    const LinearBVHNode* nodes = sbvh.Nodes();
+    const int* indices = sbvh.PrimitiveIndices();
+    for (size_t prim = 0; prim < p0.size(); ++prim) {
+        for (int k = 0; k <= 16; ++k) {
+            Point3f p = Lerp(k / 16.0f, p0[prim], p1[prim]);
+            bool covered = false;
+            for (int n = 0; n < sbvh.NodeCount(); ++n) {
+                const LinearBVHNode& node = nodes[n];
+                if (node.nPrimitives == 0 or !Inside(p, Expand(node.bounds, 1e-3f))) {
+                    continue;
+                }
+                for (int j = 0; j < node.nPrimitives; ++j) {
+                    covered |= (indices[node.primitivesOffset + j] == int(prim));
+                }
+            }
+            ASSERT_TRUE(covered);
+        }
+    }
+}
+
+TEST(BVH, CoincidentCentroids) {
+    /// More primitives at one point than a leaf can count must still split
+    std::vector<BVHPrimitiveInfo> info;
+    for (size_t i = 0; i < 70000; ++i) {
+        info.push_back(BVHPrimitiveInfo(i, Bounds3f(Point3f(-1.0f, -1.0f, -1.0f), Point3f(1.0f, 1.0f, 1.0f))));
+    }
+    for (SplitMethod method : {SplitMethod::Middle, SplitMethod::EqualCounts, SplitMethod::SAH,
+                               SplitMethod::SBVH}) {
+        BVH bvh(info, 4, method);
+        std::vector<bool> seen(info.size(), false);
+        const LinearBVHNode* nodes = bvh.Nodes();
+        for (int n = 0; n < bvh.NodeCount(); ++n) {
+            for (int j = 0; j < nodes[n].nPrimitives; ++j) {
+                seen[bvh.PrimitiveIndices()[nodes[n].primitivesOffset + j]] = true;
+            }
+        }
+        EXPECT_GT(bvh.NodeCount(), 1);
+        EXPECT_EQ(std::count(seen.begin(), seen.end(), true), 70000);
+    }
+}
+
+TEST(BVHAccel, SpatialSplitClosestHit) {
+    /// Large overlapping spheres threaded through a row of small ones
+    std::vector<Transform> toWorld, toObject;
+    for (int i = 0; i < 300; ++i) {
+        toWorld.push_back(Translate(Vec3f(float(i % 50) * 2.0f, float(i % 3), float(i / 50) * 2.0f)));
+        toObject.push_back(Inverse(toWorld.back()));
+    }
+    std::vector<std::shared_ptr<Shape>> shapes;
+    for (int i = 0; i < 300; ++i) {
+        float radius = (i % 10 == 0) ? 12.0f : 0.7f;
+        shapes.push_back(std::make_shared<TestSphere>(&toWorld[i], &toObject[i], radius));
+    }
+    BVHAccel accel(shapes, 1, SplitMethod::SBVH);
+
+    SurfaceInteraction isect;
+    for (int i = 0; i < 400; ++i) {
+        Ray r(Point3f(i * 0.3f - 10.0f, 30.0f, float(i % 13)), Vec3f(0.05f, -1.0f, 0.02f));
+        const Shape* expected = BruteForceHit(shapes, r);
+        ASSERT_EQ(accel.Intersect(r, &isect), expected != nullptr);
+        if (expected) {
+            EXPECT_EQ(isect.shape, expected);
+        }
+    }
+}
+
+TEST(ShapeArrayAccel, MatchesVirtualDispatch) {
+    /// Spheres floating over a triangulated ground grid
+    Transform identity;
+    std::vector<Transform> toWorld, toObject;
+    for (int i = 0; i < 40; ++i) {
+        toWorld.push_back(Translate(Vec3f(float(i % 8) * 2.5f, 1.5f, float(i / 8) * 2.5f)));
+        toObject.push_back(Inverse(toWorld.back()));
+    }
+    std::vector<Point3f> P;
+    std::vector<int> indices;
+    for (int z = 0; z <= 8; ++z) {
+        for (int x = 0; x <= 8; ++x) {
+            P.push_back(Point3f(x * 2.5f - 1.0f, float((x + z) % 2) * 0.3f, z * 2.5f - 1.0f));
+        }
+    }
+    for (int z = 0; z < 8; ++z) {
+        for (int x = 0; x < 8; ++x) {
+            int v = z * 9 + x;
+            int quad[6] = {v, v + 1, v + 10, v, v + 10, v + 9};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    int nTriangles = int(indices.size() / 3);
+    auto mesh = std::make_shared<TriangleMesh>(identity, nTriangles, indices.data(), int(P.size()), P.data(),
+        nullptr, nullptr);
+
+    ShapeArrays arrays;
+    std::vector<std::shared_ptr<Shape>> shapes;
+    for (int i = 0; i < 40; ++i) {
+        float radius = 0.5f + 0.1f * (i % 5);
+        arrays.spheres.push_back(Sphere(&toWorld[i], &toObject[i], false, radius));
+        shapes.push_back(std::make_shared<Sphere>(&toWorld[i], &toObject[i], false, radius));
+    }
+    for (int i = 0; i < nTriangles; ++i) {
+        arrays.triangles.push_back(Triangle(&identity, &identity, false, mesh, i));
+        shapes.push_back(std::make_shared<Triangle>(&identity, &identity, false, mesh, i));
+    }
+    ShapeArrayAccel typed(std::move(arrays), 4);
+    BVHAccel accel(shapes, 4);
+
+    for (int i = 0; i < 400; ++i) {
+        Point3f o(float(i % 20), 6.0f, float(i / 20));
+        Vec3f d(0.1f * float(i % 7) - 0.3f, -1.0f, 0.05f * float(i % 3));
+        Ray r0(o, d), r1(o, d);
+        HitRecord hit;
+        SurfaceInteraction expected, isect;
+        bool found = accel.Intersect(r0, &expected);
+        ASSERT_EQ(typed.Intersect(r1, &hit), found);
+        EXPECT_EQ(typed.IntersectP(Ray(o, d)), found);
+        if (found) {
+            EXPECT_NEAR(r1.tMax, r0.tMax, 1e-4f);
+            typed.ComputeSurfaceInteraction(r1, hit, &isect);
+            EXPECT_EQ(isect.shape, typed.GetShape(hit.primID));
+            EXPECT_NEAR(Distance(isect.p, expected.p), 0.0f, 1e-3f);
+            EXPECT_NEAR(Dot(isect.n, expected.n), 1.0f, 1e-3f);
+        }
+    }
+}
+
+TEST(ShapeArrayAccel, CompressedMeshes) {
+    /// Wavy grid stored once at full precision and once compressed, the
+    /// compressed copy split in two meshes
+    const int res = 48;
+    std::vector<Point3f> P;
+    std::vector<int> indices;
+    for (int z = 0; z <= res; ++z) {
+        for (int x = 0; x <= res; ++x) {
+            P.push_back(Point3f(float(x), std::sin(0.4f * x) * std::cos(0.3f * z), float(z)));
+        }
+    }
+    for (int z = 0; z < res; ++z) {
+        for (int x = 0; x < res; ++x) {
+            int v = z * (res + 1) + x;
+            int quad[6] = {v, v + 1, v + res + 2, v, v + res + 2, v + res + 1};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    Transform identity;
+    int nTriangles = int(indices.size() / 3), nFirst = nTriangles / 3;
+    auto mesh = std::make_shared<TriangleMesh>(identity, nTriangles, indices.data(), int(P.size()), P.data(),
+        nullptr, nullptr);
+    ShapeArrays full, compressed;
+    for (int i = 0; i < nTriangles; ++i) {
+        full.triangles.push_back(Triangle(&identity, &identity, false, mesh, i));
+    }
+    compressed.AddCompressedMesh(&identity, &identity, false, nFirst, indices.data(), int(P.size()), P.data());
+    compressed.AddCompressedMesh(&identity, &identity, false, nTriangles - nFirst, indices.data() + 3 * nFirst,
+        int(P.size()), P.data());
+    ASSERT_EQ(compressed.size(), size_t(nTriangles));
+    ShapeArrayAccel fullAccel(std::move(full), 4);
+    ShapeArrayAccel compressedAccel(std::move(compressed), 4);
+
+    for (int i = 0; i < 300; ++i) {
+        Point3f o(0.37f + float(i % 17) * 2.8f, 4.0f, 0.61f + float(i / 17) * 2.7f);
+        Vec3f d(0.05f * float(i % 5) - 0.1f, -1.0f, 0.03f * float(i % 3));
+        Ray r0(o, d), r1(o, d);
+        HitRecord hit0, hit1;
+        bool found = fullAccel.Intersect(r0, &hit0);
+        ASSERT_EQ(compressedAccel.Intersect(r1, &hit1), found);
+        if (found) {
+            EXPECT_NEAR(hit1.t, hit0.t, 1e-3f);
+            SurfaceInteraction isect0, isect1;
+            fullAccel.ComputeSurfaceInteraction(r0, hit0, &isect0);
+            compressedAccel.ComputeSurfaceInteraction(r1, hit1, &isect1);
+            EXPECT_NEAR(Distance(isect0.p, isect1.p), 0.0f, 1e-3f);
+            EXPECT_EQ(isect1.shape, compressedAccel.GetShape(hit1.primID));
+        }
+    }
+
+    /// Whole footprint per triangle, with the full precision mesh buffers
+    /// the Triangle shapes point at. The trees are alike, so the saving is
+    /// the Triangle object and the smaller buffers.
+    size_t meshBytes = mesh->vertexIndices.size() * sizeof(int) + mesh->p.size() * sizeof(Point3f);
+    float fullPerTriangle = float(fullAccel.MemoryBytes() + meshBytes) / nTriangles;
+    float compressedPerTriangle = float(compressedAccel.MemoryBytes()) / nTriangles;
+    EXPECT_GT(fullPerTriangle - compressedPerTriangle, float(sizeof(Triangle)));
+}
+
+TEST(TriangleClusterAccel, MatchesBVHAccel) {
+    /// Bumpy terrain, enough triangles for many full and partial clusters
+    const int res = 40;
+    std::vector<Point3f> P;
+    std::vector<int> indices;
+    for (int z = 0; z <= res; ++z) {
+        for (int x = 0; x <= res; ++x) {
+            P.push_back(Point3f(float(x), std::sin(0.4f * x) * std::cos(0.3f * z), float(z)));
+        }
+    }
+    for (int z = 0; z < res; ++z) {
+        for (int x = 0; x < res; ++x) {
+            int v = z * (res + 1) + x;
+            int quad[6] = {v, v + 1, v + res + 2, v, v + res + 2, v + res + 1};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    Transform identity;
+    int nTriangles = int(indices.size() / 3);
+    auto mesh = std::make_shared<TriangleMesh>(identity, nTriangles, indices.data(), int(P.size()), P.data(),
+        nullptr, nullptr);
+    std::vector<std::shared_ptr<Shape>> shapes;
+    for (int i = 0; i < nTriangles; ++i) {
+        shapes.push_back(std::make_shared<Triangle>(&identity, &identity, false, mesh, i));
+    }
+    BVHAccel accel(shapes, 4);
+    TriangleClusterAccel clustered(&identity, &identity, false, mesh);
+    TriangleClusterAccel reversed(&identity, &identity, true, mesh);
+    EXPECT_GE(clustered.ClusterCount(), nTriangles / TriangleCluster::clusterWidth);
+    EXPECT_LT(clustered.ClusterCount(), nTriangles / 2);
+
+    for (int i = 0; i < 500; ++i) {
+        Point3f o(0.5f + float(i % 25) * 1.6f, 3.0f, 0.5f + float(i / 25) * 1.9f);
+        Vec3f d(0.2f * float(i % 5) - 0.4f, -1.0f, 0.1f * float(i % 7) - 0.3f);
+        if (i % 9 == 0) {
+            d = Vec3f(1.0f, 0.1f, 0.2f);
+        }
+        Ray r0(o, d), r1(o, d);
+        HitRecord expected, hit;
+        bool found = accel.Intersect(r0, &expected);
+        ASSERT_EQ(clustered.Intersect(r1, &hit), found);
+        EXPECT_EQ(clustered.IntersectP(Ray(o, d)), found);
+        if (found) {
+            EXPECT_FLOAT_EQ(r1.tMax, r0.tMax);
+            SurfaceInteraction isect, reference;
+            clustered.ComputeSurfaceInteraction(r1, hit, &isect);
+            accel.ComputeSurfaceInteraction(r0, expected, &reference);
+            EXPECT_NEAR(Distance(isect.p, reference.p), 0.0f, 1e-4f);
+            EXPECT_NEAR(Dot(isect.n, reference.n), 1.0f, 1e-4f);
+
+            /// Shading goes through the mesh with the orientation of the accel
+            reversed.ComputeSurfaceInteraction(r1, hit, &isect);
+            EXPECT_NEAR(Dot(isect.n, reference.n), -1.0f, 1e-4f);
+        }
+    }
+}
+
+TEST(BVH, CacheRoundTrip) {
+    SphereRow row(300, 2.5f);
+    std::vector<BVHPrimitiveInfo> info;
+    for (size_t i = 0; i < row.shapes.size(); ++i) {
+        info.push_back(BVHPrimitiveInfo(i, row.shapes[i]->WorldBounds()));
+    }
+    uint64_t key = BVHCacheKey(info, 2, SplitMethod::SAH);
+    BVH built(info, 2, SplitMethod::SAH);
+    std::string filename = ::testing::TempDir() + "heimdall_bvh_cache_test.bvh";
+    ASSERT_TRUE(WriteBVHCache(filename, built, key));
+
+    /// Mismatched keys are rejected, matching ones map the identical tree
+    BVH mapped;
+    EXPECT_FALSE(LoadBVHCache(filename, key + 1, &mapped));
+    EXPECT_TRUE(mapped.Empty());
+    ASSERT_TRUE(LoadBVHCache(filename, key, &mapped));
+    ASSERT_EQ(mapped.NodeCount(), built.NodeCount());
+    ASSERT_EQ(mapped.PrimitiveIndexCount(), built.PrimitiveIndexCount());
+    EXPECT_EQ(std::memcmp(mapped.Nodes(), built.Nodes(), built.NodeCount() * sizeof(LinearBVHNode)), 0);
+    EXPECT_EQ(std::memcmp(mapped.PrimitiveIndices(), built.PrimitiveIndices(),
+        built.PrimitiveIndexCount() * sizeof(int)), 0);
+    EXPECT_FLOAT_EQ(mapped.SAHCost(), built.SAHCost());
+
+    /// Accels built through the cache agree with brute force, and a mapped
+    /// tree can still be updated in place
+    std::string accelFilename = ::testing::TempDir() + "heimdall_bvhaccel_cache_test.bvh";
+    std::remove(accelFilename.c_str());
+    BVHAccel first(row.shapes, 2, SplitMethod::SAH, accelFilename);
+    BVHAccel second(row.shapes, 2, SplitMethod::SAH, accelFilename);
+    ExpectMatchesBruteForce(first, row.shapes);
+    ExpectMatchesBruteForce(second, row.shapes);
+    for (int i = 0; i < 300; ++i) {
+        row.toWorld[i] = Translate(Vec3f(i * 2.5f, 1.0f, 0.0f));
+        row.toObject[i] = Inverse(row.toWorld[i]);
+    }
+    EXPECT_EQ(second.Update(), BVHUpdate::Refit);
+    ExpectMatchesBruteForce(second, row.shapes);
+
+    std::remove(filename.c_str());
+    std::remove(accelFilename.c_str());
+}
+
+TEST(InstanceAccel, SharedBLAS) {
+    SphereRow row(4, 3.0f);
+    auto blas = std::make_shared<BVHAccel>(row.shapes);
+
+    std::vector<Instance> instances;
+    for (int i = 0; i < 16; ++i) {
+        instances.push_back(Instance(blas, Translate(Vec3f(0.0f, 0.0f, i * 10.0f))));
+    }
+    InstanceAccel tlas(std::move(instances));
+
+    EXPECT_NEAR(tlas.WorldBound().pMax.z, 151.0f, 1e-3f);
+    EXPECT_EQ(blas.use_count(), 17);
+
+    /// Hit point and normal come back in world space
+    Ray ray(Point3f(3.0f, 10.0f, 70.0f), Vec3f(0.0f, -1.0f, 0.0f));
+    SurfaceInteraction isect;
+    ASSERT_TRUE(tlas.Intersect(ray, &isect));
+    EXPECT_EQ(isect.shape, row.shapes[1].get());
+    EXPECT_NEAR(isect.p.y, 1.0f, 1e-3f);
+    EXPECT_NEAR(isect.p.z, 70.0f, 1e-3f);
+    EXPECT_NEAR(ray.tMax, 9.0f, 1e-3f);
+    EXPECT_GT(isect.n.y, 0.99f);
+
+    EXPECT_TRUE(tlas.IntersectP(Ray(Point3f(3.0f, 10.0f, 70.0f), Vec3f(0.0f, -1.0f, 0.0f))));
+    EXPECT_FALSE(tlas.IntersectP(Ray(Point3f(3.0f, 10.0f, 75.0f), Vec3f(0.0f, -1.0f, 0.0f))));
+
+    /// Compact hits identify the instance and shape, the deferred
+    /// interaction matches the eager one
+    Ray compact(Point3f(3.0f, 10.0f, 70.0f), Vec3f(0.0f, -1.0f, 0.0f));
+    HitRecord hit;
+    ASSERT_TRUE(tlas.Intersect(compact, &hit));
+    EXPECT_EQ(hit.instanceID, 7);
+    EXPECT_EQ(hit.primID, 1);
+    EXPECT_NEAR(hit.t, 9.0f, 1e-3f);
+    SurfaceInteraction deferred;
+    tlas.ComputeSurfaceInteraction(compact, hit, &deferred);
+    EXPECT_EQ(deferred.shape, isect.shape);
+    EXPECT_NEAR(Distance(deferred.p, isect.p), 0.0f, 1e-4f);
+}
+
+TEST(InstanceAccel, OcclusionCache) {
+    SphereRow row(8, 3.0f);
+    auto blas = std::make_shared<BVHAccel>(row.shapes);
+    std::vector<Instance> instances;
+    for (int i = 0; i < 8; ++i) {
+        instances.push_back(Instance(blas, Translate(Vec3f(0.0f, 0.0f, i * 10.0f))));
+    }
+    InstanceAccel tlas(std::move(instances));
+
+    /// Shadow rays from below towards a light above, two lights share the cache
+    OcclusionCache cache(2);
+    for (int i = 0; i < 200; ++i) {
+        Point3f o(float(i % 50) * 0.5f - 1.0f, -10.0f, float(i / 50) * 20.0f + 0.2f);
+        Ray shadow(o, Vec3f(0.0f, 1.0f, 0.0f), 20.0f);
+        bool expected = tlas.IntersectP(shadow);
+        EXPECT_EQ(tlas.IntersectP(shadow, &cache, i % 2), expected);
+        if (expected) {
+            /// The cache now names an instance and sphere blocking this ray
+            int light = i % 2;
+            ASSERT_GE(cache.instanceID[light], 0);
+            ASSERT_GE(cache.primID[light], 0);
+            EXPECT_NEAR(cache.instanceID[light] * 10.0f, o.z, 1.0f);
+            EXPECT_NEAR(cache.primID[light] * 3.0f, o.x, 1.0f);
+        }
+    }
+
+    /// Rays that stop short of the geometry are never occluded
+    EXPECT_FALSE(tlas.IntersectP(Ray(Point3f(0.0f, -10.0f, 0.0f), Vec3f(0.0f, 1.0f, 0.0f), 5.0f), &cache, 0));
+}
+
+TEST(InstanceAccel, RefitTransforms) {
+    SphereRow row(4, 3.0f);
+    auto blas = std::make_shared<BVHAccel>(row.shapes);
+
+    std::vector<Instance> instances;
+    for (int i = 0; i < 16; ++i) {
+        instances.push_back(Instance(blas, Translate(Vec3f(0.0f, 0.0f, i * 10.0f))));
+    }
+    InstanceAccel tlas(std::move(instances));
+
+    /// Lift the instance at z = 70, the rest of the hierarchy is untouched
+    tlas.SetTransform(7, Translate(Vec3f(0.0f, 50.0f, 70.0f)));
+    tlas.Update();
+    EXPECT_NEAR(tlas.WorldBound().pMax.y, 51.0f, 1e-3f);
+
+    Ray low(Point3f(3.0f, 10.0f, 70.0f), Vec3f(0.0f, -1.0f, 0.0f));
+    SurfaceInteraction isect;
+    EXPECT_FALSE(tlas.Intersect(low, &isect));
+
+    Ray high(Point3f(3.0f, 60.0f, 70.0f), Vec3f(0.0f, -1.0f, 0.0f));
+    ASSERT_TRUE(tlas.Intersect(high, &isect));
+    EXPECT_NEAR(isect.p.y, 51.0f, 1e-3f);
+}
+
+TEST(AnimatedTransform, Interpolate) {
+    Transform start;
+    Transform end = Translate(Vec3f(10.0f, 0.0f, 0.0f)) * RotateY(90.0f) * Scale(2.0f, 2.0f, 2.0f);
+    AnimatedTransform transform(&start, 0.0f, &end, 1.0f);
+
+    /// Halfway: translated by 5, rotated by 45 degrees and scaled by 1.5
+    Point3f p = transform(0.5f, Point3f(1.0f, 0.0f, 0.0f));
+    EXPECT_NEAR(p.x, 5.0f + 1.5f * INV_SQRT_TWO, 1e-3f);
+    EXPECT_NEAR(p.y, 0.0f, 1e-3f);
+    EXPECT_NEAR(p.z, -1.5f * INV_SQRT_TWO, 1e-3f);
+
+    Ray r = transform(Ray(Point3f(), Vec3f(1.0f, 0.0f, 0.0f), INFINITY, 1.0f));
+    EXPECT_NEAR(r.o.x, 10.0f, 1e-3f);
+    EXPECT_NEAR(r.d.z, -2.0f, 1e-3f);
+}
+
+/// Reference closest hit by testing every motion instance
+const Shape* BruteForceHit(const std::vector<MotionInstance>& instances, const Ray& r) {
+    Ray ray = r;
+    const Shape* closest = nullptr;
+    SurfaceInteraction isect;
+    for (const MotionInstance& instance : instances) {
+        if (instance.Intersect(ray, &isect)) {
+            closest = isect.shape;
+        }
+    }
+    return closest;
+}
+
+TEST(MotionInstanceAccel, LinearMotion) {
+    SphereRow row(1, 0.0f);
+    auto blas = std::make_shared<BVHAccel>(row.shapes);
+
+    /// Each instance rises by 10 over the shutter
+    std::vector<Transform> starts, ends;
+    for (int i = 0; i < 32; ++i) {
+        starts.push_back(Translate(Vec3f(i * 3.0f, 0.0f, 0.0f)));
+        ends.push_back(Translate(Vec3f(i * 3.0f, 10.0f, 0.0f)));
+    }
+    std::vector<AnimatedTransform> transforms;
+    for (int i = 0; i < 32; ++i) {
+        transforms.push_back(AnimatedTransform(&starts[i], 0.0f, &ends[i], 1.0f));
+    }
+    std::vector<MotionInstance> instances;
+    for (int i = 0; i < 32; ++i) {
+        instances.push_back(MotionInstance(blas, &transforms[i]));
+    }
+    MotionInstanceAccel accel(instances, 0.0f, 1.0f);
+    EXPECT_NEAR(accel.WorldBound().pMax.y, 11.0f, 1e-3f);
+
+    /// The sphere is found where it is at the ray time
+    for (float time : {0.0f, 0.25f, 0.5f, 1.0f}) {
+        Ray ray(Point3f(30.0f, 20.0f, 0.0f), Vec3f(0.0f, -1.0f, 0.0f), INFINITY, time);
+        SurfaceInteraction isect;
+        ASSERT_TRUE(accel.Intersect(ray, &isect));
+        EXPECT_NEAR(isect.p.y, 1.0f + 10.0f * time, 1e-3f);
+        EXPECT_NEAR(isect.p.x, 30.0f, 1e-3f);
+    }
+
+    /// Between the spheres nothing is hit at any time
+    Ray miss(Point3f(31.5f, 20.0f, 0.0f), Vec3f(0.0f, -1.0f, 0.0f), INFINITY, 0.5f);
+    EXPECT_FALSE(accel.IntersectP(miss));
+
+    /// Sideways rays only see the spheres at their current height
+    Ray side(Point3f(-10.0f, 2.5f, 0.0f), Vec3f(1.0f, 0.0f, 0.0f), INFINITY, 0.0f);
+    EXPECT_FALSE(accel.IntersectP(side));
+    side.time = 0.25f;
+    EXPECT_TRUE(accel.IntersectP(side));
+}
+
+TEST(MotionInstanceAccel, TemporalSplits) {
+    /// Long rods spinning half a turn around y over the shutter
+    SphereRow row(10, 2.0f);
+    auto blas = std::make_shared<BVHAccel>(row.shapes);
+    std::vector<Transform> starts, ends;
+    for (int i = 0; i < 8; ++i) {
+        starts.push_back(Translate(Vec3f(0.0f, i * 3.0f, 0.0f)));
+        ends.push_back(Translate(Vec3f(0.0f, i * 3.0f, 0.0f)) * RotateY(179.0f));
+    }
+    std::vector<AnimatedTransform> transforms;
+    for (int i = 0; i < 8; ++i) {
+        transforms.push_back(AnimatedTransform(&starts[i], 0.0f, &ends[i], 1.0f));
+    }
+    std::vector<MotionInstance> instances;
+    for (int i = 0; i < 8; ++i) {
+        instances.push_back(MotionInstance(blas, &transforms[i]));
+    }
+    MotionBVH bvh(instances.size(), 0.0f, 1.0f, [&](size_t index, float time0, float time1) {
+        return instances[index].WorldBound(time0, time1);
+    });
+    bool temporal = false;
+    for (const MotionBVHNode& node : bvh.Nodes()) {
+        temporal |= node.temporalSplit != 0;
+    }
+    EXPECT_TRUE(temporal);
+
+    MotionInstanceAccel accel(instances, 0.0f, 1.0f);
+    SurfaceInteraction isect;
+    for (int i = 0; i < 500; ++i) {
+        float time = (i % 97) / 96.0f;
+        Ray r(Point3f((i % 41) - 20.0f, 30.0f, (i % 23) - 11.0f), Vec3f(0.01f, -1.0f, 0.02f), INFINITY, time);
+        const Shape* expected = BruteForceHit(instances, r);
+        ASSERT_EQ(accel.Intersect(r, &isect), expected != nullptr);
+        if (expected) {
+            EXPECT_EQ(isect.shape, expected);
+        }
+    }
+}
+
+HEIMDALL_NAMESPACE_END
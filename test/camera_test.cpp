@@ -0,0 +1,106 @@
+#include "gtest/gtest.h"
+#include "heimdall/camera.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+static void ExpectNear(const Vec3f& a, const Vec3f& b, float eps) {
+    EXPECT_NEAR(a.x, b.x, eps);
+    EXPECT_NEAR(a.y, b.y, eps);
+    EXPECT_NEAR(a.z, b.z, eps);
+}
+
+/// Samples spread over the film, including its corners
+static std::vector<CameraSample> FilmSamples(const Point2i& resolution) {
+    std::vector<CameraSample> samples;
+    for (int i = 0; i <= 8; ++i) {
+        for (int j = 0; j <= 8; ++j) {
+            CameraSample sample;
+            sample.pFilm = Point2f(resolution.x * i / 8.0f, resolution.y * j / 8.0f);
+            sample.time = (i + j) / 17.0f;
+            samples.push_back(sample);
+        }
+    }
+    return samples;
+}
+
+TEST(Camera, Perspective) {
+    Point2i resolution(64, 48);
+    Film film(resolution, std::unique_ptr<Filter>(new BoxFilter(Vec2f(0.5f, 0.5f))), 16, 1);
+    Point3f pos(1.0f, 2.0f, -5.0f), look(0.0f, 0.5f, 0.0f);
+    Transform cameraToWorld = Inverse(LookAt(pos, look, Vec3f(0.0f, 1.0f, 0.0f)));
+    AnimatedTransform animated(&cameraToWorld, 0.0f, &cameraToWorld, 1.0f);
+    PerspectiveCamera camera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, 45.0f, &film);
+
+    std::vector<CameraSample> samples = FilmSamples(resolution);
+    std::vector<RayDifferential> rays(samples.size());
+    camera.GenerateRayDifferentials(samples.data(), int(samples.size()), rays.data());
+
+    /// The film center looks straight at the target
+    RayDifferential center;
+    CameraSample centerSample;
+    centerSample.pFilm = Point2f(32.0f, 24.0f);
+    centerSample.time = 0.5f;
+    camera.GenerateRayDifferential(centerSample, &center);
+    ExpectNear(center.d, Normalize(look - pos), 1e-5f);
+    EXPECT_FLOAT_EQ(center.time, 0.5f);
+
+    /// Tabulated rays match the full transform chain
+    Transform screenToRaster = Scale(64.0f, 48.0f, 1.0f) * Scale(1.0f / (2.0f * 64.0f / 48.0f), -0.5f, 1.0f) *
+                               Translate(Vec3f(64.0f / 48.0f, -1.0f, 0.0f));
+    Transform rasterToCamera = Inverse(Perspective(45.0f, 1e-2f, 1000.0f)) * Inverse(screenToRaster);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const Point2f& p = samples[i].pFilm;
+        Vec3f dir = Normalize(Vec3f(rasterToCamera(Point3f(p.x, p.y, 0.0f))));
+        Vec3f dx = Normalize(Vec3f(rasterToCamera(Point3f(p.x + 1.0f, p.y, 0.0f))));
+        Vec3f dy = Normalize(Vec3f(rasterToCamera(Point3f(p.x, p.y + 1.0f, 0.0f))));
+        ExpectNear(Vec3f(rays[i].o), Vec3f(pos), 1e-5f);
+        ExpectNear(rays[i].d, cameraToWorld(dir), 1e-5f);
+        ExpectNear(rays[i].rxDirection, cameraToWorld(dx), 1e-5f);
+        ExpectNear(rays[i].ryDirection, cameraToWorld(dy), 1e-5f);
+        EXPECT_TRUE(rays[i].hasDifferentials);
+        EXPECT_FLOAT_EQ(rays[i].time, samples[i].time);
+    }
+}
+
+TEST(Camera, Orthographic) {
+    Point2i resolution(32, 32);
+    Film film(resolution, std::unique_ptr<Filter>(new BoxFilter(Vec2f(0.5f, 0.5f))), 16, 1);
+    Transform cameraToWorld = Translate(Vec3f(0.0f, 0.0f, -10.0f));
+    AnimatedTransform animated(&cameraToWorld, 0.0f, &cameraToWorld, 1.0f);
+    OrthographicCamera camera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, &film);
+
+    std::vector<CameraSample> samples = FilmSamples(resolution);
+    std::vector<RayDifferential> rays(samples.size());
+    camera.GenerateRayDifferentials(samples.data(), int(samples.size()), rays.data());
+
+    /// Parallel rays from the screen window, raster y points down
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const Point2f& p = samples[i].pFilm;
+        ExpectNear(Vec3f(rays[i].o), Vec3f(p.x / 16.0f - 1.0f, 1.0f - p.y / 16.0f, -10.0f), 1e-5f);
+        ExpectNear(rays[i].d, Vec3f(0.0f, 0.0f, 1.0f), 1e-6f);
+        ExpectNear(rays[i].rxOrigin - rays[i].o, Vec3f(1.0f / 16.0f, 0.0f, 0.0f), 1e-5f);
+        ExpectNear(rays[i].ryOrigin - rays[i].o, Vec3f(0.0f, -1.0f / 16.0f, 0.0f), 1e-5f);
+    }
+}
+
+TEST(Camera, MotionBlur) {
+    Point2i resolution(16, 16);
+    Film film(resolution, std::unique_ptr<Filter>(new BoxFilter(Vec2f(0.5f, 0.5f))), 16, 1);
+    Transform start = Inverse(LookAt(Point3f(0.0f, 0.0f, -5.0f), Point3f(0.0f, 0.0f, 0.0f), Vec3f(0.0f, 1.0f, 0.0f)));
+    Transform end = Inverse(LookAt(Point3f(2.0f, 0.0f, -5.0f), Point3f(2.0f, 0.0f, 0.0f), Vec3f(0.0f, 1.0f, 0.0f)));
+    AnimatedTransform animated(&start, 0.0f, &end, 1.0f);
+    PerspectiveCamera camera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, 60.0f, &film);
+
+    /// The origin moves along with the camera over the shutter interval
+    for (float u : {0.0f, 0.25f, 1.0f}) {
+        CameraSample sample;
+        sample.pFilm = Point2f(3.0f, 11.0f);
+        sample.time = u;
+        RayDifferential ray;
+        camera.GenerateRayDifferential(sample, &ray);
+        ExpectNear(Vec3f(ray.o), Vec3f(2.0f * u, 0.0f, -5.0f), 1e-4f);
+        EXPECT_FLOAT_EQ(ray.time, u);
+    }
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+#include "heimdall/film.h"
+#include "heimdall/parallel.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Radiance of a smooth test image at continuous film position p
+static RGB TestRadiance(const Point2f& p) {
+    return RGB(0.5f + 0.5f * std::sin(0.3f * p.x), 0.5f + 0.5f * std::cos(0.2f * p.y), 0.25f);
+}
+
+/// Four stratified samples per pixel of every tile of the sample bounds
+static void RenderTestImage(Film& film, int tileSize, bool constant) {
+    ParallelFor2D(film.GetSampleBounds(), tileSize, [&](const Bounds2i& tileBounds) {
+        FilmTile* tile = film.GetFilmTile(tileBounds);
+        for (Point2i p : tileBounds) {
+            for (int s = 0; s < 4; ++s) {
+                Point2f pFilm(p.x + 0.25f + 0.5f * (s % 2), p.y + 0.25f + 0.5f * (s / 2));
+                tile->AddSample(pFilm, constant ? RGB(1.0f, 2.0f, 3.0f) : TestRadiance(pFilm));
+            }
+        }
+        film.MergeFilmTile(tile);
+    });
+}
+
+TEST(Film, TileBounds) {
+    Film film(Point2i(40, 30), std::unique_ptr<Filter>(new BoxFilter(Vec2f(1.5f, 1.5f))), 8, 1);
+
+    /// Samples up to a radius outside the image still reach edge pixels
+    Bounds2i sampleBounds = film.GetSampleBounds();
+    EXPECT_EQ(sampleBounds.pMin, Point2i(-1, -1));
+    EXPECT_EQ(sampleBounds.pMax, Point2i(41, 31));
+
+    /// Interior tiles are padded by the radius, edge tiles are clipped
+    FilmTile* tile = film.GetFilmTile(Bounds2i(Point2i(8, 8), Point2i(16, 16)));
+    EXPECT_EQ(tile->GetPixelBounds().pMin, Point2i(6, 6));
+    EXPECT_EQ(tile->GetPixelBounds().pMax, Point2i(18, 18));
+    film.MergeFilmTile(tile);
+
+    tile = film.GetFilmTile(Bounds2i(Point2i(-1, -1), Point2i(7, 7)));
+    EXPECT_EQ(tile->GetPixelBounds().pMin, Point2i(0, 0));
+    EXPECT_EQ(tile->GetPixelBounds().pMax, Point2i(9, 9));
+    film.MergeFilmTile(tile);
+
+    /// Merged tiles go back to the pool
+    EXPECT_EQ(film.PooledTileCount(), 1);
+}
+
+TEST(Film, WideFilter) {
+    /// A sample reaches every pixel within a radius wider than 32 pixels
+    Film film(Point2i(100, 4), std::unique_ptr<Filter>(new BoxFilter(Vec2f(40.0f, 1.0f))), 8, 1);
+    FilmTile* tile = film.GetFilmTile(Bounds2i(Point2i(48, 0), Point2i(56, 4)));
+    tile->AddSample(Point2f(50.5f, 1.5f), RGB(1.0f, 2.0f, 3.0f));
+    film.MergeFilmTile(tile);
+    EXPECT_EQ(film.GetPixel(Point2i(11, 1)), RGB(1.0f, 2.0f, 3.0f));
+    EXPECT_EQ(film.GetPixel(Point2i(89, 1)), RGB(1.0f, 2.0f, 3.0f));
+    EXPECT_EQ(film.GetPixel(Point2i(91, 1)), RGB());
+}
+
+TEST(Film, ParallelMerge) {
+    ParallelInit(4);
+
+    /// A box filtered constant image is constant, edges and tile seams included
+    Film box(Point2i(67, 45), std::unique_ptr<Filter>(new BoxFilter(Vec2f(1.0f, 1.0f))), 8);
+    RenderTestImage(box, 8, true);
+    for (const RGB& rgb : box.GetImage()) {
+        EXPECT_NEAR(rgb.x, 1.0f, 1e-5f);
+        EXPECT_NEAR(rgb.y, 2.0f, 1e-5f);
+        EXPECT_NEAR(rgb.z, 3.0f, 1e-5f);
+    }
+
+    /// Tiles are recycled, the pool stays at a couple per thread
+    EXPECT_LE(box.PooledTileCount(), 2 * MaxThreadIndex());
+
+    /// Merging tiles on many threads matches merging them on one
+    Film parallel(Point2i(67, 45), std::unique_ptr<Filter>(new GaussianFilter(Vec2f(2.0f, 2.0f), 2.0f)), 8);
+    RenderTestImage(parallel, 8, false);
+    std::vector<RGB> parallelImage = parallel.GetImage();
+
+    ParallelInit(1);
+    Film serial(Point2i(67, 45), std::unique_ptr<Filter>(new GaussianFilter(Vec2f(2.0f, 2.0f), 2.0f)), 8);
+    RenderTestImage(serial, 8, false);
+    std::vector<RGB> serialImage = serial.GetImage();
+    ParallelCleanup();
+
+    ASSERT_EQ(parallelImage.size(), serialImage.size());
+    for (size_t i = 0; i < serialImage.size(); ++i) {
+        EXPECT_NEAR(parallelImage[i].x, serialImage[i].x, 1e-4f);
+        EXPECT_NEAR(parallelImage[i].y, serialImage[i].y, 1e-4f);
+        EXPECT_NEAR(parallelImage[i].z, serialImage[i].z, 1e-4f);
+    }
+
+    /// Cleared film is black
+    serial.Clear();
+    EXPECT_EQ(serial.GetPixel(Point2i(10, 10)), RGB());
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,264 @@
+#include "gtest/gtest.h"
+#include "heimdall/imageio.h"
+#include "heimdall/parallel.h"
+#include "heimdall/render.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+HEIMDALL_NAMESPACE_BEGIN
+
+static std::vector<char> ReadFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static uint32_t LoadUInt32(const char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) {
+        v |= uint32_t(uint8_t(p[i])) << (8 * i);
+    }
+    return v;
+}
+
+static float LoadFloat(const char* p) {
+    uint32_t bits = LoadUInt32(p);
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/// Reads back an uncompressed tiled float EXR into interleaved pixels,
+/// channels sorted by name
+static std::vector<float> ReadExr(const std::vector<char>& file, Point2i* resolution, std::vector<std::string>* names,
+                                  int* tileSize) {
+    EXPECT_EQ(LoadUInt32(&file[0]), 20000630u);
+    EXPECT_EQ(LoadUInt32(&file[4]), 0x202u);
+    const char* p = &file[8];
+    while (*p) {
+        std::string name(p);
+        p += name.size() + 1;
+        std::string type(p);
+        p += type.size() + 1;
+        uint32_t size = LoadUInt32(p);
+        p += 4;
+        if (name == "channels") {
+            for (const char* c = p; *c; c += std::strlen(c) + 1 + 16) {
+                names->push_back(c);
+                EXPECT_EQ(LoadUInt32(c + std::strlen(c) + 1), 2u);
+            }
+        } else if (name == "dataWindow") {
+            *resolution = Point2i(int(LoadUInt32(p + 8)) + 1, int(LoadUInt32(p + 12)) + 1);
+        } else if (name == "tiles") {
+            *tileSize = int(LoadUInt32(p));
+        } else if (name == "compression") {
+            EXPECT_EQ(*p, 0);
+        }
+        p += size;
+    }
+    ++p;
+
+    int nc = int(names->size());
+    int nx = (resolution->x + *tileSize - 1) / *tileSize, ny = (resolution->y + *tileSize - 1) / *tileSize;
+    std::vector<float> image(resolution->x * resolution->y * nc, -1.0f);
+    for (int i = 0; i < nx * ny; ++i) {
+        uint64_t offset = LoadUInt32(p + 8 * i) | uint64_t(LoadUInt32(p + 8 * i + 4)) << 32;
+        const char* tile = &file[offset];
+        int tx = int(LoadUInt32(tile)), ty = int(LoadUInt32(tile + 4));
+        int x0 = tx * *tileSize, y0 = ty * *tileSize;
+        int w = std::min(*tileSize, resolution->x - x0), h = std::min(*tileSize, resolution->y - y0);
+        EXPECT_EQ(LoadUInt32(tile + 16), uint32_t(w * h * nc * 4));
+        const char* data = tile + 20;
+        for (int y = 0; y < h; ++y) {
+            for (int c = 0; c < nc; ++c) {
+                for (int x = 0; x < w; ++x, data += 4) {
+                    image[((y0 + y) * resolution->x + x0 + x) * nc + c] = LoadFloat(data);
+                }
+            }
+        }
+    }
+    return image;
+}
+
+/// Reads back a little endian PFM with rows flipped to top to bottom
+static std::vector<float> ReadPfm(const std::vector<char>& file, Point2i* resolution, int* nChannels) {
+    std::string text(file.begin(), file.begin() + std::min<size_t>(file.size(), 64));
+    char kind;
+    float scale;
+    int headerSize;
+    EXPECT_EQ(std::sscanf(text.c_str(), "P%c %d %d %f%n", &kind, &resolution->x, &resolution->y, &scale,
+                          &headerSize), 4);
+    EXPECT_EQ(scale, -1.0f);
+    *nChannels = kind == 'F' ? 3 : 1;
+    const float* data = reinterpret_cast<const float*>(&file[headerSize + 1]);
+    int rowSize = resolution->x * *nChannels;
+    EXPECT_EQ(file.size(), size_t(headerSize + 1 + 4 * rowSize * resolution->y));
+    std::vector<float> image;
+    for (int y = resolution->y - 1; y >= 0; --y) {
+        image.insert(image.end(), data + y * rowSize, data + (y + 1) * rowSize);
+    }
+    return image;
+}
+
+static float TestValue(int x, int y, int c) {
+    return x + 0.001f * y + 100.0f * c;
+}
+
+/// Writes the test image in blocks of blockSize, from several threads
+/// and bottom right first, through a queue of queueBytes
+static bool WriteTestImage(const std::string& filename, const Point2i& resolution,
+                           const std::vector<std::string>& names, int blockSize, size_t queueBytes) {
+    std::unique_ptr<TiledImageWriter> writer = TiledImageWriter::Create(filename, resolution, names, 8, queueBytes);
+    if (!writer) {
+        return false;
+    }
+    int nc = int(names.size());
+    int nx = (resolution.x + blockSize - 1) / blockSize, ny = (resolution.y + blockSize - 1) / blockSize;
+    ParallelFor(nx * ny, [&](int64_t i) {
+        int block = nx * ny - 1 - int(i);
+        Bounds2i region(Point2i((block % nx) * blockSize, (block / nx) * blockSize),
+                        Point2i((block % nx + 1) * blockSize, (block / nx + 1) * blockSize));
+        std::vector<float> pixels;
+        for (int y = region.pMin.y; y < region.pMax.y; ++y) {
+            for (int x = region.pMin.x; x < region.pMax.x; ++x) {
+                for (int c = 0; c < nc; ++c) {
+                    pixels.push_back(TestValue(x, y, c));
+                }
+            }
+        }
+        writer->WriteRegion(region, pixels.data());
+    });
+    return writer->Close();
+}
+
+TEST(ImageIO, TiledExr) {
+    ParallelInit(4);
+    std::string filename = ::testing::TempDir() + "heimdall_imageio_test.exr";
+    Point2i resolution(37, 21);
+
+    /// Blocks straddle tiles and the image edge, the tiny queue keeps the
+    /// writers waiting on the I/O thread
+    ASSERT_TRUE(WriteTestImage(filename, resolution, {"R", "G", "B", "A"}, 5, 256));
+    ParallelCleanup();
+    Point2i fileResolution;
+    std::vector<std::string> names;
+    int tileSize = 0;
+    std::vector<float> image = ReadExr(ReadFile(filename), &fileResolution, &names, &tileSize);
+    EXPECT_EQ(fileResolution, resolution);
+    EXPECT_EQ(names, std::vector<std::string>({"A", "B", "G", "R"}));
+    EXPECT_EQ(tileSize, 8);
+    int sortedToInput[4] = {3, 2, 1, 0};
+    for (int y = 0; y < resolution.y; ++y) {
+        for (int x = 0; x < resolution.x; ++x) {
+            for (int c = 0; c < 4; ++c) {
+                EXPECT_EQ(image[(y * resolution.x + x) * 4 + c], TestValue(x, y, sortedToInput[c]));
+            }
+        }
+    }
+
+    /// Pixels never written come out black
+    {
+        std::unique_ptr<TiledImageWriter> writer = TiledImageWriter::Create(filename, resolution, {"Y"}, 8);
+        float one = 1.0f;
+        writer->WriteRegion(Bounds2i(Point2i(3, 4), Point2i(4, 5)), &one);
+        EXPECT_EQ(writer->PendingBytes(), size_t(20 + 8 * 8 * 4));
+
+        /// A region aligned to the tiles holds nothing back
+        std::vector<float> ones(8 * 8, 1.0f);
+        writer->WriteRegion(Bounds2i(Point2i(8, 8), Point2i(16, 16)), ones.data());
+        EXPECT_EQ(writer->PendingBytes(), size_t(20 + 8 * 8 * 4));
+    }
+    names.clear();
+    image = ReadExr(ReadFile(filename), &fileResolution, &names, &tileSize);
+    EXPECT_EQ(image[4 * resolution.x + 3], 1.0f);
+    EXPECT_EQ(image[4 * resolution.x + 4], 0.0f);
+    EXPECT_EQ(image[15 * resolution.x + 15], 1.0f);
+    EXPECT_EQ(image.back(), 0.0f);
+    std::remove(filename.c_str());
+}
+
+TEST(ImageIO, ScanlinePfm) {
+    ParallelInit(4);
+    std::string filename = ::testing::TempDir() + "heimdall_imageio_test.pfm";
+    Point2i resolution(19, 13);
+    ASSERT_TRUE(WriteTestImage(filename, resolution, {"R", "G", "B"}, 4, 1 << 20));
+    Point2i fileResolution;
+    int nChannels;
+    std::vector<float> image = ReadPfm(ReadFile(filename), &fileResolution, &nChannels);
+    EXPECT_EQ(fileResolution, resolution);
+    EXPECT_EQ(nChannels, 3);
+    for (int y = 0; y < resolution.y; ++y) {
+        for (int x = 0; x < resolution.x; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                EXPECT_EQ(image[(y * resolution.x + x) * 3 + c], TestValue(x, y, c));
+            }
+        }
+    }
+
+    ASSERT_TRUE(WriteTestImage(filename, resolution, {"Y"}, 6, 64));
+    image = ReadPfm(ReadFile(filename), &fileResolution, &nChannels);
+    EXPECT_EQ(nChannels, 1);
+    EXPECT_EQ(image[7 * resolution.x + 11], TestValue(11, 7, 0));
+
+    /// PFM has no room for other channel counts
+    EXPECT_FALSE(TiledImageWriter::Create(filename, resolution, {"R", "G"}));
+    ParallelCleanup();
+    std::remove(filename.c_str());
+}
+
+TEST(ImageIO, StreamedRender) {
+    ParallelInit(4);
+    Transform cameraToWorld;
+    AnimatedTransform animated(&cameraToWorld, 0.0f, &cameraToWorld, 1.0f);
+    Point2i resolution(96, 40);
+    std::unique_ptr<TiledImageWriter> writer;
+    std::atomic<size_t> maxPendingBytes(0);
+    auto Li = [&](const RayDifferential& ray, Sampler& sampler, AOVSample*) {
+        size_t pending = writer->PendingBytes();
+        if (pending > maxPendingBytes) {
+            maxPendingBytes = pending;
+        }
+        float u = ray.o.x < 0.0f ? 0.5f : 2.0f * sampler.Get1D();
+        return RGB(u, 0.5f * u, ray.o.y);
+    };
+
+    /// Tiles streamed during the adaptive render match the final film,
+    /// with a filter wide enough to reach into neighbouring tiles. The
+    /// flat left half is streamed while the right half still renders,
+    /// in whole tiles of the writer although the render tiles are offset
+    /// by the filter radius.
+    std::string filename = ::testing::TempDir() + "heimdall_imageio_render.exr";
+    Film film(resolution, std::unique_ptr<Filter>(new TriangleFilter(Vec2f(2.0f, 2.0f))));
+    OrthographicCamera camera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, &film);
+    writer = TiledImageWriter::Create(filename, resolution, {"R", "G", "B"}, 16);
+    AdaptiveSettings settings;
+    settings.output = writer.get();
+    RenderAdaptive(camera, SobolSampler(64), Li, settings);
+    ParallelCleanup();
+    EXPECT_EQ(maxPendingBytes, size_t(0));
+    ASSERT_TRUE(writer->Close());
+
+    Point2i fileResolution;
+    std::vector<std::string> names;
+    int tileSize;
+    std::vector<float> image = ReadExr(ReadFile(filename), &fileResolution, &names, &tileSize);
+    std::vector<RGB> expected = film.GetImage();
+    for (int i = 0; i < resolution.x * resolution.y; ++i) {
+        EXPECT_EQ(image[3 * i + 0], expected[i].z);
+        EXPECT_EQ(image[3 * i + 1], expected[i].y);
+        EXPECT_EQ(image[3 * i + 2], expected[i].x);
+    }
+
+    /// Writing a finished film in one go gives the same file
+    std::string pfmFilename = ::testing::TempDir() + "heimdall_imageio_render.pfm";
+    ASSERT_TRUE(WriteImage(film, pfmFilename));
+    int nChannels;
+    image = ReadPfm(ReadFile(pfmFilename), &fileResolution, &nChannels);
+    EXPECT_EQ(image[3 * 100 + 1], expected[100].y);
+    std::remove(filename.c_str());
+    std::remove(pfmFilename.c_str());
+}
+
+HEIMDALL_NAMESPACE_END
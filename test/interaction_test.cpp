@@ -0,0 +1,40 @@
+#include "gtest/gtest.h"
+#include "heimdall/interaction.h"
+#include "heimdall/transform.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+TEST(SurfaceInteraction, ShadingDefaultsToGeometry) {
+    SurfaceInteraction si(Point3f(1.0f, 2.0f, 3.0f), Vec3f(), Point2f(), Vec3f(0.0f, 0.0f, 1.0f),
+        Vec3f(1.0f, 0.0f, 0.0f), Vec3f(0.0f, 1.0f, 0.0f), Normal3f(), Normal3f(), 0.0f, nullptr);
+    EXPECT_EQ(si.n, Normal3f(0.0f, 0.0f, 1.0f));
+    EXPECT_EQ(si.Shading().n, si.n);
+    EXPECT_EQ(si.Shading().dpdu, si.dpdu);
+    EXPECT_EQ(si.Shading().dpdv, si.dpdv);
+}
+
+TEST(SurfaceInteraction, LazyShadingGeometry) {
+    SurfaceInteraction si(Point3f(), Vec3f(), Point2f(), Vec3f(0.0f, 0.0f, 1.0f),
+        Vec3f(1.0f, 0.0f, 0.0f), Vec3f(0.0f, 1.0f, 0.0f), Normal3f(), Normal3f(), 0.0f, nullptr);
+
+    /// Shading frame tilted about y, flipped tangents still face the geometric side
+    Vec3f dpdus = Normalize(Vec3f(1.0f, 0.0f, 1.0f));
+    si.SetShadingGeometry(-dpdus, Vec3f(0.0f, 1.0f, 0.0f), Normal3f(), Normal3f(), false);
+    EXPECT_EQ(si.n, Normal3f(0.0f, 0.0f, 1.0f));
+    EXPECT_EQ(si.Shading().dpdu, -dpdus);
+    EXPECT_GT(Dot(si.Shading().n, si.n), 0.0f);
+    EXPECT_NEAR(si.Shading().n.x, -INV_SQRT_TWO, 1e-5f);
+
+    /// Transforming before and after the shading terms were evaluated agrees
+    SurfaceInteraction pending(Point3f(), Vec3f(), Point2f(), Vec3f(0.0f, 0.0f, 1.0f),
+        Vec3f(1.0f, 0.0f, 0.0f), Vec3f(0.0f, 1.0f, 0.0f), Normal3f(), Normal3f(), 0.0f, nullptr);
+    pending.SetShadingGeometry(-dpdus, Vec3f(0.0f, 1.0f, 0.0f), Normal3f(), Normal3f(), false);
+    Transform rotate = RotateX(30.0f);
+    SurfaceInteraction a = rotate(si);
+    SurfaceInteraction b = rotate(pending);
+    EXPECT_NEAR(a.Shading().n.x, b.Shading().n.x, 1e-5f);
+    EXPECT_NEAR(a.Shading().n.y, b.Shading().n.y, 1e-5f);
+    EXPECT_NEAR(a.Shading().n.z, b.Shading().n.z, 1e-5f);
+}
+
+HEIMDALL_NAMESPACE_END
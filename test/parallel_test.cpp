@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+#include "heimdall/parallel.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+static int Fibonacci(int n) {
+    if (n < 12) {
+        return n < 2 ? n : Fibonacci(n - 1) + Fibonacci(n - 2);
+    }
+    int a, b;
+    TaskGroup group;
+    group.Run([&]() {
+        a = Fibonacci(n - 1);
+    });
+    b = Fibonacci(n - 2);
+    group.Wait();
+    return a + b;
+}
+
+TEST(Parallel, ParallelFor) {
+    ParallelInit(4);
+    EXPECT_EQ(MaxThreadIndex(), 4);
+
+    /// Every index exactly once, for any chunk size
+    for (int64_t chunkSize : {1, 7, 1000}) {
+        std::vector<int> visits(20000, 0);
+        std::atomic<int64_t> sum(0);
+        ParallelFor(int64_t(visits.size()), [&](int64_t i) {
+            ++visits[i];
+            sum += i;
+            EXPECT_LT(ThreadIndex(), MaxThreadIndex());
+        }, chunkSize);
+        EXPECT_EQ(sum, int64_t(visits.size()) * (int64_t(visits.size()) - 1) / 2);
+        EXPECT_EQ(std::count(visits.begin(), visits.end(), 1), int64_t(visits.size()));
+    }
+
+    /// Tiles cover every pixel exactly once, edge tiles are clipped
+    Bounds2i bounds(Point2i(3, 5), Point2i(70, 41));
+    std::vector<int> covered(70 * 41, 0);
+    std::atomic<int> nTiles(0);
+    ParallelFor2D(bounds, 16, [&](const Bounds2i& tile) {
+        ++nTiles;
+        EXPECT_LE(tile.pMax.x - tile.pMin.x, 16);
+        for (Point2i p : tile) {
+            ++covered[p.y * 70 + p.x];
+        }
+    });
+    EXPECT_EQ(nTiles, 5 * 3);
+    for (int y = 0; y < 41; ++y) {
+        for (int x = 0; x < 70; ++x) {
+            EXPECT_EQ(covered[y * 70 + x], Inside(Point2i(x, y), bounds) ? 1 : 0);
+        }
+    }
+    ParallelCleanup();
+}
+
+TEST(Parallel, TaskGroups) {
+    /// Nested fork/join on the global pool
+    ParallelInit(4);
+    EXPECT_EQ(Fibonacci(24), 46368);
+    ParallelCleanup();
+
+    /// A private pool with pinned workers
+    ThreadPool pool(3, true);
+    EXPECT_EQ(pool.Size(), 3);
+    std::atomic<int> count(0);
+    {
+        TaskGroup group(&pool);
+        for (int i = 0; i < 1000; ++i) {
+            group.Run([&]() {
+                ++count;
+            });
+        }
+        group.Wait();
+        EXPECT_EQ(count, 1000);
+        group.Run([&]() {
+            ++count;
+        });
+    }
+    EXPECT_EQ(count, 1001);
+}
+
+HEIMDALL_NAMESPACE_END
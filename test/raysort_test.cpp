@@ -0,0 +1,73 @@
+#include "gtest/gtest.h"
+#include "heimdall/raysort.h"
+#include "heimdall/bvh.h"
+#include "heimdall/sphere.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+TEST(RaySort, KeysGroupOctantsAndOrigins) {
+    Bounds3f bounds(Point3f(0.0f, 0.0f, 0.0f), Point3f(10.0f, 10.0f, 10.0f));
+    Vec3f up(0.1f, 1.0f, 0.2f), down(0.1f, -1.0f, 0.2f);
+
+    /// Direction octant dominates, nearby origins get nearby keys
+    EXPECT_LT(RaySortKey(Ray(Point3f(9.0f, 9.0f, 9.0f), up), bounds),
+              RaySortKey(Ray(Point3f(0.0f, 0.0f, 0.0f), down), bounds));
+    EXPECT_LT(RaySortKey(Ray(Point3f(1.0f, 1.0f, 1.0f), up), bounds),
+              RaySortKey(Ray(Point3f(9.0f, 9.0f, 9.0f), up), bounds));
+    EXPECT_EQ(RaySortKey(Ray(Point3f(-5.0f, 0.0f, 0.0f), up), bounds),
+              RaySortKey(Ray(Point3f(0.0f, 0.0f, 0.0f), up), bounds));
+
+    /// Sorting yields a permutation with nondecreasing keys
+    std::vector<Ray> rays;
+    for (int i = 0; i < 1000; ++i) {
+        Point3f o(float((i * 37) % 100) * 0.1f, float((i * 11) % 100) * 0.1f, float((i * 53) % 100) * 0.1f);
+        Vec3f d(float(i % 3) - 1.0f, float((i / 3) % 2) * 2.0f - 1.0f, 0.5f - float(i % 2));
+        rays.push_back(Ray(o, d));
+    }
+    std::vector<int> order;
+    SortRays(rays.data(), int(rays.size()), bounds, &order);
+    ASSERT_EQ(order.size(), rays.size());
+    std::vector<bool> seen(rays.size(), false);
+    for (size_t i = 0; i < order.size(); ++i) {
+        ASSERT_FALSE(seen[order[i]]);
+        seen[order[i]] = true;
+        if (i > 0) {
+            EXPECT_LE(RaySortKey(rays[order[i - 1]], bounds), RaySortKey(rays[order[i]], bounds));
+        }
+    }
+}
+
+TEST(RaySort, IntersectSortedMatchesUnsorted) {
+    std::vector<Transform> toWorld, toObject;
+    for (int i = 0; i < 64; ++i) {
+        toWorld.push_back(Translate(Vec3f(float(i % 8) * 3.0f, float(i / 8) * 3.0f, 0.0f)));
+        toObject.push_back(Inverse(toWorld.back()));
+    }
+    std::vector<std::shared_ptr<Shape>> shapes;
+    for (int i = 0; i < 64; ++i) {
+        shapes.push_back(std::make_shared<Sphere>(&toWorld[i], &toObject[i], false, 1.0f));
+    }
+    BVHAccel accel(shapes);
+
+    std::vector<Ray> rays;
+    for (int i = 0; i < 500; ++i) {
+        Point3f o(float((i * 7) % 24), float((i * 13) % 24), 5.0f * ((i % 2) ? 1.0f : -1.0f));
+        rays.push_back(Ray(o, Vec3f(0.05f * float(i % 5), 0.0f, (i % 2) ? -1.0f : 1.0f)));
+    }
+    std::vector<HitRecord> hits;
+    IntersectSorted(accel, rays, &hits);
+    ASSERT_EQ(hits.size(), rays.size());
+    for (size_t i = 0; i < rays.size(); ++i) {
+        Ray ray = rays[i];
+        ray.tMax = INFINITY;
+        HitRecord expected;
+        bool found = accel.Intersect(ray, &expected);
+        EXPECT_EQ(hits[i].primID >= 0, found);
+        EXPECT_EQ(hits[i].primID, expected.primID);
+        if (found) {
+            EXPECT_FLOAT_EQ(hits[i].t, expected.t);
+        }
+    }
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,173 @@
+#include "gtest/gtest.h"
+#include "heimdall/render.h"
+#include "heimdall/parallel.h"
+
+#include <chrono>
+#include <thread>
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Flat gray on the left half of the screen, noise with mean one on the right
+static RGB HalfNoisy(const RayDifferential& ray, Sampler& sampler, AOVSample*) {
+    if (ray.o.x < 0.0f) {
+        return RGB(0.5f, 0.5f, 0.5f);
+    }
+    float u = 2.0f * sampler.Get1D();
+    return RGB(u, u, u);
+}
+
+TEST(Render, VarianceEstimator) {
+    /// Merging partial statistics matches adding every sample to one
+    VarianceEstimator all, left, right;
+    for (int i = 0; i < 100; ++i) {
+        float x = std::sin(0.37f * i) * 3.0f + 1.0f;
+        all.Add(x);
+        (i < 40 ? left : right).Add(x);
+    }
+    left.Merge(right);
+    EXPECT_EQ(left.count, 100);
+    EXPECT_NEAR(left.mean, all.mean, 1e-5f);
+    EXPECT_NEAR(left.Variance(), all.Variance(), 1e-3f);
+    EXPECT_EQ(VarianceEstimator().RelativeError(0.01f), INFINITY);
+}
+
+TEST(Render, Adaptive) {
+    ParallelInit(4);
+    Transform cameraToWorld;
+    AnimatedTransform animated(&cameraToWorld, 0.0f, &cameraToWorld, 1.0f);
+    Point2i resolution(64, 64);
+
+    /// Converged tiles stop after the minimum, noisy ones keep going
+    Film film(resolution, std::unique_ptr<Filter>(new BoxFilter(Vec2f(0.5f, 0.5f))));
+    OrthographicCamera camera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, &film);
+    AdaptiveSettings settings;
+    settings.noiseThreshold = 0.02f;
+    RenderStats stats = RenderAdaptive(camera, SobolSampler(256), HalfNoisy, settings);
+    EXPECT_EQ(stats.tiles, 16);
+    EXPECT_GE(stats.convergedTiles, 8);
+    EXPECT_LT(stats.totalSamples, 64 * 64 * 256 * 3 / 4);
+    EXPECT_GT(stats.totalSamples, 64 * 64 * 16);
+    EXPECT_EQ(film.GetPixelVariance(Point2i(5, 5)).count, 16);
+    EXPECT_GT(film.GetPixelVariance(Point2i(50, 5)).count, 16);
+    for (int y = 0; y < 64; ++y) {
+        EXPECT_NEAR(film.GetPixel(Point2i(10, y)).x, 0.5f, 1e-5f);
+        EXPECT_NEAR(film.GetPixel(Point2i(50, y)).x, 1.0f, 0.25f);
+    }
+
+    /// The budget caps the samples taken
+    Film budgetFilm(resolution, std::unique_ptr<Filter>(new BoxFilter(Vec2f(0.5f, 0.5f))));
+    OrthographicCamera budgetCamera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, &budgetFilm);
+    settings.sampleBudget = 64 * 64 * 40;
+    settings.noiseThreshold = 0.0f;
+    stats = RenderAdaptive(budgetCamera, SobolSampler(256), HalfNoisy, settings);
+    ParallelCleanup();
+    EXPECT_LE(stats.totalSamples, settings.sampleBudget);
+    EXPECT_GT(stats.totalSamples, settings.sampleBudget * 3 / 4);
+
+    /// Only the flat tiles, which have no error at all, stop early
+    EXPECT_EQ(stats.convergedTiles, 8);
+}
+
+TEST(Render, Progressive) {
+    ParallelInit(4);
+    Transform cameraToWorld;
+    AnimatedTransform animated(&cameraToWorld, 0.0f, &cameraToWorld, 1.0f);
+    Point2i resolution(40, 24);
+    auto gray = [](const RayDifferential&, Sampler&, AOVSample*) {
+        return RGB(0.25f, 0.5f, 0.75f);
+    };
+
+    /// Passes double the samples per pixel up to the sampler's count,
+    /// while another thread keeps taking snapshots
+    Film film(resolution, std::unique_ptr<Filter>(new BoxFilter(Vec2f(0.5f, 0.5f))));
+    OrthographicCamera camera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, &film);
+    ProgressiveSettings settings;
+    std::vector<int64_t> passSamples;
+    settings.onPass = [&](int, int64_t spp) {
+        passSamples.push_back(spp);
+    };
+    ProgressiveRenderer renderer(camera, SobolSampler(16), HalfNoisy, settings);
+    EXPECT_EQ(renderer.GetImage()[0], RGB());
+    std::atomic<bool> done(false);
+    std::thread viewer([&]() {
+        while (!done) {
+            EXPECT_EQ(renderer.GetImage().size(), size_t(40 * 24));
+        }
+    });
+    RenderStats stats = renderer.Render();
+    done = true;
+    viewer.join();
+    EXPECT_EQ(passSamples, std::vector<int64_t>({1, 2, 4, 8, 16}));
+    EXPECT_EQ(stats.passes, 5);
+    EXPECT_EQ(stats.totalSamples, 40 * 24 * 16);
+    EXPECT_FALSE(stats.timedOut);
+    EXPECT_EQ(renderer.CompletedSamplesPerPixel(), 16);
+    EXPECT_EQ(film.GetPixelVariance(Point2i(39, 23)).count, 16);
+
+    /// A noise target stops as soon as the mean error meets it
+    Film flatFilm(resolution, std::unique_ptr<Filter>(new BoxFilter(Vec2f(0.5f, 0.5f))));
+    OrthographicCamera flatCamera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, &flatFilm);
+    settings.onPass = nullptr;
+    settings.noiseTarget = 0.01f;
+    ProgressiveRenderer flat(flatCamera, SobolSampler(1024), gray, settings);
+    stats = flat.Render();
+    EXPECT_EQ(stats.passes, 2);
+    EXPECT_EQ(flat.CompletedSamplesPerPixel(), 2);
+    EXPECT_EQ(flat.GetImage()[100], RGB(0.25f, 0.5f, 0.75f));
+
+    /// Past the deadline the preview is still a complete image
+    Film lateFilm(resolution, std::unique_ptr<Filter>(new BoxFilter(Vec2f(0.5f, 0.5f))));
+    OrthographicCamera lateCamera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, &lateFilm);
+    settings.noiseTarget = 0.0f;
+    settings.timeLimit = 1e-9;
+    ProgressiveRenderer late(lateCamera, SobolSampler(1024), gray, settings);
+    stats = late.Render();
+    ParallelCleanup();
+    EXPECT_TRUE(stats.timedOut);
+    EXPECT_EQ(stats.passes, 0);
+    for (const RGB& rgb : late.GetImage()) {
+        EXPECT_EQ(rgb, RGB(0.25f, 0.5f, 0.75f));
+    }
+}
+
+TEST(Render, ProgressiveDeadline) {
+    ParallelInit(4);
+    Transform cameraToWorld;
+    AnimatedTransform animated(&cameraToWorld, 0.0f, &cameraToWorld, 1.0f);
+    Point2i resolution(128, 128);
+    auto slow = [](const RayDifferential&, Sampler&, AOVSample*) {
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+        return RGB(1.0f, 1.0f, 1.0f);
+    };
+
+    /// The first pass takes far longer than the limit, so it is cut short
+    Film film(resolution, std::unique_ptr<Filter>(new BoxFilter(Vec2f(0.5f, 0.5f))));
+    OrthographicCamera camera(animated, DefaultScreenWindow(resolution), 0.0f, 1.0f, &film);
+    ProgressiveSettings settings;
+    settings.timeLimit = 0.1;
+    ProgressiveRenderer renderer(camera, SobolSampler(4), slow, settings);
+    RenderStats stats = renderer.Render();
+    ParallelCleanup();
+    EXPECT_TRUE(stats.timedOut);
+    EXPECT_EQ(stats.passes, 0);
+
+    /// Finished tiles are the start of the spiral, up to the tiles the
+    /// other threads had taken when time ran out
+    Bounds2i tileGrid(Point2i(0, 0), Point2i(8, 8));
+    int nFinished = 0, lastFinished = -1, index = 0;
+    for (Point2i t : Traversal(tileGrid, TraversalOrder::Spiral)) {
+        if (film.GetPixelVariance(Point2i(t.x * 16, t.y * 16)).count > 0) {
+            ++nFinished;
+            lastFinished = index;
+        }
+        ++index;
+    }
+    EXPECT_GT(nFinished, 0);
+    EXPECT_LT(nFinished, 64);
+    EXPECT_LT(lastFinished, nFinished + 4);
+    for (Point2i center : {Point2i(63, 63), Point2i(64, 64)}) {
+        EXPECT_GT(film.GetPixelVariance(center).count, 0);
+    }
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,78 @@
+#include "gtest/gtest.h"
+#include "heimdall/rng.h"
+#include "heimdall/parallel.h"
+#include "heimdall/sampler.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+TEST(RNG, Streams) {
+    /// Skipping ahead and back matches stepping
+    RNG stepped(17), skipped(17);
+    for (int i = 0; i < 1000; ++i) {
+        stepped.UniformUInt32();
+    }
+    skipped.Advance(1000);
+    EXPECT_EQ(stepped.UniformUInt32(), skipped.UniformUInt32());
+    skipped.Advance(-1001);
+    EXPECT_EQ(skipped.UniformUInt32(), RNG(17).UniformUInt32());
+
+    /// Pixel sample streams can start at any dimension
+    RNG first, later;
+    first.SetPixelSample(Point2i(3, 9), 12, 0);
+    later.SetPixelSample(Point2i(3, 9), 12, 3);
+    first.Advance(3);
+    EXPECT_EQ(first.UniformFloat(), later.UniformFloat());
+
+    /// Distinct streams and bounded values
+    RNG other;
+    other.SetPixelSample(Point2i(4, 9), 12, 0);
+    first.SetPixelSample(Point2i(3, 9), 12, 0);
+    EXPECT_NE(first.UniformUInt32(), other.UniformUInt32());
+    float sum = 0.0f;
+    for (int i = 0; i < 10000; ++i) {
+        EXPECT_LT(first.UniformUInt32(7), 7u);
+        float u = first.UniformFloat();
+        EXPECT_GE(u, 0.0f);
+        EXPECT_LT(u, 1.0f);
+        sum += u;
+    }
+    EXPECT_NEAR(sum / 10000.0f, 0.5f, 0.02f);
+
+    /// Lane fills match drawing value by value
+    CounterRNG counter(Point2i(3, 9), 12, 5);
+    float lanes[37];
+    counter.FillUniform(100, 37, lanes);
+    for (int i = 0; i < 37; ++i) {
+        EXPECT_EQ(lanes[i], counter.UniformFloat(100 + i));
+    }
+    EXPECT_NE(counter.UniformFloat(0), CounterRNG(Point2i(3, 9), 13, 5).UniformFloat(0));
+}
+
+TEST(RNG, DeterministicAcrossThreads) {
+    /// Per pixel sums of random values come out bit identical however
+    /// the tiles are spread over threads
+    Bounds2i bounds(Point2i(0, 0), Point2i(61, 47));
+    auto render = [&](int nThreads) {
+        ParallelInit(nThreads);
+        std::vector<float> image(61 * 47, 0.0f);
+        ParallelFor2D(bounds, 8, [&](const Bounds2i& tile) {
+            IndependentSampler sampler(16, 42);
+            for (Point2i p : tile) {
+                RNG rng;
+                for (int64_t s = 0; s < 16; ++s) {
+                    sampler.StartPixelSample(p, s);
+                    rng.SetPixelSample(p, s, 0, 42);
+                    Point2f u = sampler.Get2D();
+                    image[p.y * 61 + p.x] += u.x * u.y + rng.UniformFloat();
+                }
+            }
+        }, TraversalOrder::Hilbert);
+        ParallelCleanup();
+        return image;
+    };
+    std::vector<float> serial = render(1);
+    std::vector<float> parallel = render(4);
+    EXPECT_TRUE(serial == parallel);
+}
+
+HEIMDALL_NAMESPACE_END
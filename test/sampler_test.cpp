@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+#include "heimdall/sampler.h"
+#include "heimdall/lowdiscrepancy.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// True if 2^m points have one point in every elementary interval of
+/// area 2^-m, the (0, m, 2)-net property
+static bool IsZeroNet(const std::vector<Point2f>& points, int m) {
+    for (int xBits = 0; xBits <= m; ++xBits) {
+        int nx = 1 << xBits, ny = 1 << (m - xBits);
+        std::vector<int> counts(nx * ny, 0);
+        for (const Point2f& p : points) {
+            ++counts[int(p.y * ny) * nx + int(p.x * nx)];
+        }
+        if (std::count(counts.begin(), counts.end(), 1) != int(counts.size())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(Sampler, LowDiscrepancyTables) {
+    /// Every Sobol dimension is a (0, 1)-sequence on its own
+    for (int dim = 0; dim < nSobolDimensions; ++dim) {
+        std::vector<int> counts(256, 0);
+        for (uint64_t i = 0; i < 256; ++i) {
+            ++counts[SobolBits(i, dim) >> 24];
+        }
+        EXPECT_EQ(std::count(counts.begin(), counts.end(), 1), 256) << "dimension " << dim;
+    }
+
+    /// The first two dimensions are a (0, 2)-sequence, scrambled or not
+    std::vector<Point2f> sobol, scrambled;
+    for (uint64_t i = 0; i < 1024; ++i) {
+        sobol.push_back(Point2f(BitsToFloat01(SobolBits(i, 0)), BitsToFloat01(SobolBits(i, 1))));
+        scrambled.push_back(Point2f(SobolSample(i, 0, 0x1234567), SobolSample(i, 1, 0xabcdef)));
+    }
+    EXPECT_TRUE(IsZeroNet(sobol, 10));
+    EXPECT_TRUE(IsZeroNet(scrambled, 10));
+
+    /// Halton digit permutations permute every digit of their base
+    for (int i = 0; i < nHaltonDimensions; ++i) {
+        int base = Prime(i);
+        std::vector<uint16_t> perm(RadicalInversePermutation(i), RadicalInversePermutation(i) + base);
+        std::sort(perm.begin(), perm.end());
+        for (int j = 0; j < base; ++j) {
+            ASSERT_EQ(perm[j], j);
+        }
+    }
+    EXPECT_EQ(Prime(0), 2);
+    EXPECT_EQ(Prime(nHaltonDimensions - 1), 311);
+    EXPECT_FLOAT_EQ(RadicalInverse(0, 6), 0.375f);
+    EXPECT_FLOAT_EQ(RadicalInverse(1, 5), 7.0f / 9.0f);
+}
+
+TEST(Sampler, PixelSequences) {
+    /// Progressive: every power of four prefix of a pixel is a (0, 2)-net
+    SobolSampler sobol(1024, 7);
+    PMJ02Sampler pmj(1024, 7);
+    for (Sampler* sampler : {(Sampler*)&sobol, (Sampler*)&pmj}) {
+        for (int m : {4, 8}) {
+            std::vector<Point2f> points;
+            for (int i = 0; i < (1 << m); ++i) {
+                sampler->StartPixelSample(Point2i(13, -4), i);
+                points.push_back(sampler->Get2D());
+            }
+            EXPECT_TRUE(IsZeroNet(points, m));
+        }
+    }
+
+    /// Halton pixels own the global points that land inside them
+    Bounds2i sampleBounds(Point2i(0, 0), Point2i(40, 30));
+    HaltonSampler halton(16, sampleBounds);
+    Point2i pixel(5, 7);
+    std::vector<Point2f> expected;
+    for (uint64_t j = 0; expected.size() < 4; ++j) {
+        float x = RadicalInverse(0, j) * 64.0f, y = RadicalInverse(1, j) * 81.0f;
+        if (int(x) == pixel.x and int(y) == pixel.y) {
+            expected.push_back(Point2f(x - pixel.x, y - pixel.y));
+        }
+    }
+    for (int i = 0; i < 4; ++i) {
+        halton.StartPixelSample(pixel, i);
+        Point2f u = halton.Get2D();
+        EXPECT_NEAR(u.x, expected[i].x, 1e-4f);
+        EXPECT_NEAR(u.y, expected[i].y, 1e-4f);
+    }
+}
+
+TEST(Sampler, TileBatches) {
+    Bounds2i tile(Point2i(-2, 3), Point2i(9, 10));
+    SobolSampler sobol(64, 3);
+    HaltonSampler halton(64, Bounds2i(Point2i(-2, 0), Point2i(100, 100)));
+    PMJ02Sampler pmj(64, 3);
+    for (Sampler* sampler : {(Sampler*)&sobol, (Sampler*)&halton, (Sampler*)&pmj}) {
+        std::unique_ptr<Sampler> clone = sampler->Clone();
+        std::vector<Point2f> batch2D(77);
+        std::vector<float> batch1D(77);
+        std::vector<CameraSample> cameraSamples(77);
+        for (int64_t index : {0, 5, 63}) {
+            sampler->Get2DTile(tile, index, 4, batch2D.data());
+            sampler->Get1DTile(tile, index, 6, batch1D.data());
+            sampler->GetCameraSamples(tile, index, cameraSamples.data());
+
+            /// Batches match drawing pixel by pixel on another copy
+            int i = 0;
+            for (Point2i p : tile) {
+                clone->StartPixelSample(p, index, 4);
+                Point2f u = clone->Get2D();
+                EXPECT_EQ(u, batch2D[i]);
+                EXPECT_EQ(clone->Get1D(), batch1D[i]);
+
+                clone->StartPixelSample(p, index);
+                CameraSample sample = clone->GetCameraSample(p);
+                EXPECT_EQ(sample.pFilm, cameraSamples[i].pFilm);
+                EXPECT_EQ(sample.time, cameraSamples[i].time);
+                EXPECT_GE(sample.pFilm.x, p.x);
+                EXPECT_LT(sample.pFilm.x, p.x + 1);
+                EXPECT_GE(sample.time, 0.0f);
+                EXPECT_LT(sample.time, 1.0f);
+                ++i;
+            }
+        }
+    }
+}
+
+HEIMDALL_NAMESPACE_END
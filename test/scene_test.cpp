@@ -0,0 +1,134 @@
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "heimdall/scene.h"
+#include "heimdall/sphere.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Grid of spheres instanced three times along z
+class SphereScene {
+  public:
+    std::vector<Transform> toWorld, toObject;
+    Scene scene;
+
+    SphereScene() : toWorld(25), toObject(25) {
+        std::vector<std::shared_ptr<Shape>> shapes;
+        for (int i = 0; i < 25; ++i) {
+            toWorld[i] = Translate(Vec3f(float(i % 5) * 3.0f, float(i / 5) * 3.0f, 0.0f));
+            toObject[i] = Inverse(toWorld[i]);
+            shapes.push_back(std::make_shared<Sphere>(&toWorld[i], &toObject[i], false, 1.0f));
+        }
+        int geomID = scene.AddGeometry(std::move(shapes));
+        for (int i = 0; i < 3; ++i) {
+            scene.AddInstance(geomID, Translate(Vec3f(0.0f, 0.0f, i * 10.0f)));
+        }
+        EXPECT_EQ(scene.AddInstance(geomID + 1), -1);
+        scene.Commit();
+    }
+};
+
+/// Rays through the grid from both sides along x, hitting and missing
+std::vector<Ray> GridRays(int n) {
+    std::vector<Ray> rays;
+    for (int i = 0; i < n; ++i) {
+        float sign = (i % 2) ? 1.0f : -1.0f;
+        Point3f o(-10.0f * sign + 6.0f, float(i % 15), float((i * 7) % 25) - 1.0f);
+        rays.push_back(Ray(o, Vec3f(sign, 0.01f * float(i % 3), 0.0f)));
+    }
+    return rays;
+}
+
+TEST(Scene, QueriesAgree) {
+    SphereScene s;
+    ASSERT_TRUE(s.scene.Committed());
+    std::vector<Ray> rays = GridRays(160);
+
+    /// Reference single ray results
+    std::vector<HitRecord> expected(rays.size());
+    std::vector<bool> blocked(rays.size());
+    int nHits = 0;
+    for (size_t i = 0; i < rays.size(); ++i) {
+        Ray ray = rays[i];
+        nHits += s.scene.Intersect1(ray, &expected[i]);
+        blocked[i] = s.scene.Occluded1(rays[i]);
+        EXPECT_EQ(blocked[i], expected[i].primID >= 0);
+    }
+    EXPECT_GT(nHits, 20);
+    EXPECT_LT(nHits, 160);
+
+    /// Packets with every other lane masked off
+    int valid[16];
+    for (int i = 0; i < 16; ++i) {
+        valid[i] = i % 2;
+    }
+    for (size_t base = 0; base + 16 <= rays.size(); base += 16) {
+        std::vector<Ray> packet(rays.begin() + base, rays.begin() + base + 16);
+        HitRecord hits[16];
+        bool occluded[16];
+        s.scene.Occluded8(valid, packet.data(), occluded);
+        s.scene.Intersect16(valid, packet.data(), hits);
+        for (int i = 0; i < 16; ++i) {
+            EXPECT_EQ(hits[i].primID, valid[i] ? expected[base + i].primID : -1);
+            EXPECT_EQ(hits[i].instanceID, valid[i] ? expected[base + i].instanceID : -1);
+            if (i < 8) {
+                EXPECT_EQ(occluded[i], valid[i] and blocked[base + i]);
+            }
+        }
+        packet.assign(rays.begin() + base, rays.begin() + base + 16);
+        s.scene.Intersect4(valid, packet.data(), hits);
+        EXPECT_EQ(hits[1].primID, expected[base + 1].primID);
+        EXPECT_EQ(hits[2].primID, -1);
+    }
+
+    /// Streams in both modes
+    for (StreamFlags flags : {StreamFlags::Coherent, StreamFlags::Incoherent}) {
+        std::vector<Ray> stream = rays;
+        std::vector<HitRecord> hits(rays.size());
+        std::unique_ptr<bool[]> occluded(new bool[rays.size()]);
+        s.scene.IntersectStream(stream.data(), int(stream.size()), hits.data(), flags);
+        s.scene.OccludedStream(rays.data(), int(rays.size()), occluded.get(), flags);
+        for (size_t i = 0; i < rays.size(); ++i) {
+            EXPECT_EQ(hits[i].primID, expected[i].primID);
+            EXPECT_EQ(hits[i].instanceID, expected[i].instanceID);
+            EXPECT_EQ(occluded[i], blocked[i]);
+            if (hits[i].primID >= 0) {
+                EXPECT_FLOAT_EQ(stream[i].tMax, expected[i].t);
+                EXPECT_EQ(s.scene.GeometryOf(hits[i].instanceID), 0);
+            }
+        }
+    }
+}
+
+TEST(Scene, ConcurrentQueries) {
+    SphereScene s;
+    std::vector<Ray> rays = GridRays(500);
+    std::vector<HitRecord> expected(rays.size());
+    for (size_t i = 0; i < rays.size(); ++i) {
+        Ray ray = rays[i];
+        s.scene.Intersect1(ray, &expected[i]);
+    }
+
+    std::vector<int> mismatches(4, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.push_back(std::thread([&, t]() {
+            for (int pass = 0; pass < 10; ++pass) {
+                std::vector<Ray> stream = rays;
+                std::vector<HitRecord> hits(rays.size());
+                s.scene.IntersectStream(stream.data(), int(stream.size()), hits.data());
+                for (size_t i = 0; i < rays.size(); ++i) {
+                    mismatches[t] += hits[i].primID != expected[i].primID;
+                }
+            }
+        }));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (int t = 0; t < 4; ++t) {
+        EXPECT_EQ(mismatches[t], 0);
+    }
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,288 @@
+#include "gtest/gtest.h"
+#include "heimdall/sphere.h"
+#include "heimdall/triangle.h"
+#include "heimdall/shapearrays.h"
+#include "heimdall/curve.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+/// Plane z = 1 that only implements the full intersection, so it uses
+/// the default interaction recomputation
+class UnitPlane : public Shape {
+  public:
+    UnitPlane(const Transform* identity) : Shape(identity, identity, false) {}
+    Bounds3f ObjectBounds() const {
+        return Bounds3f(Point3f(-1e3f, -1e3f, 1.0f), Point3f(1e3f, 1e3f, 1.0f));
+    }
+    bool Intersect(const Ray& r, float* tHit, SurfaceInteraction* isect, bool) const {
+        float t = (1.0f - r.o.z) / r.d.z;
+        if (!(t > 0.0f and t < r.tMax)) {
+            return false;
+        }
+        *tHit = t;
+        Point3f p = r(t);
+        *isect = SurfaceInteraction(p, Vec3f(), Point2f(p.x, p.y), -r.d, Vec3f(1.0f, 0.0f, 0.0f),
+                                    Vec3f(0.0f, 1.0f, 0.0f), Normal3f(), Normal3f(), r.time, this);
+        return true;
+    }
+    bool IntersectTest(const Ray& r, bool testSurfaceAlpha) const {
+        float tHit;
+        SurfaceInteraction isect;
+        return Intersect(r, &tHit, &isect, testSurfaceAlpha);
+    }
+    float Area() const {
+        return INFINITY;
+    }
+};
+
+TEST(Shape, DefaultSurfaceInteraction) {
+    Transform identity;
+    UnitPlane plane(&identity);
+    Ray ray(Point3f(0.5f, 0.25f, 0.0f), Vec3f(0.0f, 0.0f, 2.0f));
+    HitRecord hit;
+    ASSERT_TRUE(plane.IntersectHit(ray, &hit));
+    EXPECT_FLOAT_EQ(hit.t, 0.5f);
+    SurfaceInteraction isect;
+    plane.ComputeSurfaceInteraction(ray, hit, &isect);
+    EXPECT_FLOAT_EQ(isect.p.z, 1.0f);
+    EXPECT_FLOAT_EQ(isect.uv.x, 0.5f);
+
+    /// A hit the shape cannot find again still gives a valid interaction
+    hit.t = 0.25f;
+    plane.ComputeSurfaceInteraction(ray, hit, &isect);
+    EXPECT_FLOAT_EQ(isect.p.z, 0.5f);
+    EXPECT_FLOAT_EQ(isect.n.z, -1.0f);
+    EXPECT_EQ(isect.shape, &plane);
+}
+
+TEST(Sphere, Intersect) {
+    Transform toWorld = Translate(Vec3f(0.0f, 0.0f, 5.0f));
+    Transform toObject = Inverse(toWorld);
+    Sphere sphere(&toWorld, &toObject, false, 2.0f);
+
+    Ray ray(Point3f(0.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f));
+    float tHit;
+    SurfaceInteraction isect;
+    ASSERT_TRUE(sphere.Intersect(ray, &tHit, &isect));
+    EXPECT_NEAR(tHit, 3.0f, 1e-5f);
+    EXPECT_NEAR(isect.p.z, 3.0f, 1e-5f);
+    EXPECT_NEAR(isect.n.z, -1.0f, 1e-5f);
+    EXPECT_EQ(isect.shape, &sphere);
+
+    /// Rays starting inside hit the far side, rays past tMax miss
+    EXPECT_TRUE(sphere.Intersect(Ray(Point3f(0.0f, 0.0f, 5.0f), Vec3f(1.0f, 0.0f, 0.0f)), &tHit, &isect));
+    EXPECT_NEAR(tHit, 2.0f, 1e-5f);
+    EXPECT_FALSE(sphere.IntersectTest(Ray(Point3f(0.0f, 0.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f), 2.5f)));
+    EXPECT_FALSE(sphere.IntersectTest(Ray(Point3f(0.0f, 3.0f, 0.0f), Vec3f(0.0f, 0.0f, 1.0f))));
+    EXPECT_NEAR(sphere.Area(), 16.0f * M_PI, 1e-3f);
+}
+
+TEST(Triangle, Intersect) {
+    /// Unit quad in the xy plane at z = 1, shading normals tilted towards +x
+    Transform toWorld = Translate(Vec3f(0.0f, 0.0f, 1.0f));
+    Transform toObject = Inverse(toWorld);
+    int indices[6] = {0, 1, 2, 0, 2, 3};
+    Point3f P[4] = {Point3f(0, 0, 0), Point3f(1, 0, 0), Point3f(1, 1, 0), Point3f(0, 1, 0)};
+    Normal3f N[4];
+    for (int i = 0; i < 4; ++i) {
+        N[i] = Normalize(Normal3f(1.0f, 0.0f, 1.0f));
+    }
+    std::vector<std::shared_ptr<Shape>> tris = CreateTriangleMesh(&toWorld, &toObject, false, 2, indices,
+        4, P, N);
+    ASSERT_EQ(tris.size(), size_t(2));
+    EXPECT_NEAR(tris[0]->Area() + tris[1]->Area(), 1.0f, 1e-5f);
+    EXPECT_NEAR(tris[0]->WorldBounds().pMin.z, 1.0f, 1e-5f);
+
+    Ray ray(Point3f(0.75f, 0.25f, 3.0f), Vec3f(0.0f, 0.0f, -1.0f));
+    HitRecord hit;
+    ASSERT_TRUE(tris[0]->IntersectHit(ray, &hit));
+    EXPECT_FALSE(tris[1]->IntersectTest(ray));
+    EXPECT_NEAR(hit.t, 2.0f, 1e-5f);
+
+    SurfaceInteraction isect;
+    tris[0]->ComputeSurfaceInteraction(ray, hit, &isect);
+    EXPECT_NEAR(isect.p.x, 0.75f, 1e-5f);
+    EXPECT_NEAR(isect.p.y, 0.25f, 1e-5f);
+    EXPECT_NEAR(isect.p.z, 1.0f, 1e-5f);
+    EXPECT_NEAR(std::abs(isect.n.z), 1.0f, 1e-5f);
+    EXPECT_GT(Dot(isect.n, isect.Shading().n), 0.0f);
+    EXPECT_NEAR(isect.Shading().n.x, INV_SQRT_TWO, 1e-4f);
+
+    /// The shading frame keeps the orientation of the geometric one
+    EXPECT_GT(Dot(isect.Shading().dpdu, isect.dpdu), 0.0f);
+    EXPECT_GT(Dot(isect.Shading().dpdv, isect.dpdv), 0.0f);
+}
+
+TEST(CompressedMeshShape, MatchesFullPrecision) {
+    /// Encodings round trip within their precision
+    EXPECT_EQ(HalfToFloat(FloatToHalf(0.375f)), 0.375f);
+    EXPECT_EQ(HalfToFloat(FloatToHalf(-2048.0f)), -2048.0f);
+    EXPECT_NEAR(HalfToFloat(FloatToHalf(0.1f)), 0.1f, 1e-4f);
+    EXPECT_EQ(HalfToFloat(FloatToHalf(1e-8f)), 0.0f);
+    EXPECT_TRUE(std::isinf(HalfToFloat(FloatToHalf(1e6f))));
+    Normal3f normals[3] = {Normal3f(0, 0, -1), Normalize(Normal3f(1, -2, 3)), Normalize(Normal3f(-3, 1, -2))};
+    for (const Normal3f& n : normals) {
+        EXPECT_NEAR(Dot(DecodeOctahedral(EncodeOctahedral(n)), n), 1.0f, 1e-6f);
+    }
+
+    /// Wavy grid with normals and uvs, plus one triangle spanning the
+    /// whole vertex range so its index block cannot use 16 bit offsets
+    const int res = 64;
+    std::vector<Point3f> P;
+    std::vector<Normal3f> N;
+    std::vector<Point2f> UV;
+    for (int y = 0; y <= res; ++y) {
+        for (int x = 0; x <= res; ++x) {
+            P.push_back(Point3f(float(x), float(y), 0.5f * std::sin(0.3f * x) * std::cos(0.2f * y)));
+            N.push_back(Normalize(Normal3f(0.1f * std::sin(0.5f * x), 0.1f, 1.0f)));
+            UV.push_back(Point2f(float(x) / res, float(y) / res));
+        }
+    }
+    std::vector<int> indices;
+    for (int y = 0; y < res; ++y) {
+        for (int x = 0; x < res; ++x) {
+            int v = y * (res + 1) + x;
+            int quad[6] = {v, v + 1, v + res + 2, v, v + res + 2, v + res + 1};
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    }
+    for (int i = 0; i < 70000; ++i) {
+        P.push_back(Point3f(float(i % 7), -5.0f, 0.0f));
+        N.push_back(Normal3f(0, 0, 1));
+        UV.push_back(Point2f(0, 0));
+    }
+    int far[3] = {0, 1, int(P.size()) - 1};
+    indices.insert(indices.end(), far, far + 3);
+
+    Transform identity;
+    int nTriangles = int(indices.size() / 3);
+    auto full = std::make_shared<TriangleMesh>(identity, nTriangles, indices.data(), int(P.size()), P.data(),
+        N.data(), UV.data());
+    ShapeArrays arrays;
+    arrays.AddCompressedMesh(&identity, &identity, false, nTriangles, indices.data(), int(P.size()), P.data(),
+        N.data(), UV.data());
+    const CompressedMeshShape& b = arrays.compressedMeshes[0];
+    std::shared_ptr<const CompressedTriangleMesh> compressed = b.mesh;
+    EXPECT_FALSE(compressed->wideIndices.empty());
+    size_t fullBytes = full->vertexIndices.size() * sizeof(int) + full->p.size() * sizeof(Point3f) +
+        full->n.size() * sizeof(Normal3f) + full->uv.size() * sizeof(Point2f);
+    EXPECT_LT(compressed->MemoryBytes() * 2, fullBytes);
+
+    for (int tri = 0; tri < nTriangles; tri += 97) {
+        Triangle a(&identity, &identity, false, full, tri);
+        EXPECT_NEAR(Distance(a.WorldBounds().pMin, b.TriangleBounds(tri).pMin), 0.0f, 1e-2f);
+        EXPECT_NEAR(Distance(a.WorldBounds().pMax, b.TriangleBounds(tri).pMax), 0.0f, 1e-2f);
+    }
+
+    for (int i = 0; i < 200; ++i) {
+        /// Rays through the interior of either triangle of a grid cell
+        int x = (i * 7) % res, y = (i * 13) % res, upper = i % 2;
+        Point3f o(x + (upper ? 0.3f : 0.7f), y + (upper ? 0.7f : 0.2f), 5.0f);
+        Ray r(o, Vec3f(0.0f, 0.0f, -1.0f));
+        int tri = 2 * (y * res + x) + upper;
+        Triangle a(&identity, &identity, false, full, tri);
+        HitRecord hitA, hitB;
+        ASSERT_TRUE(a.IntersectHit(r, &hitA));
+        ASSERT_TRUE(b.IntersectHit(r, tri, &hitB));
+        EXPECT_NEAR(hitA.t, hitB.t, 1e-3f);
+
+        SurfaceInteraction isectA, isectB;
+        a.ComputeSurfaceInteraction(r, hitA, &isectA);
+        b.ComputeSurfaceInteraction(r, tri, hitB, &isectB);
+        EXPECT_EQ(isectB.shape, &b);
+        EXPECT_NEAR(Distance(isectA.p, isectB.p), 0.0f, 1e-3f);
+        EXPECT_NEAR(Dot(isectA.n, isectB.n), 1.0f, 1e-3f);
+        EXPECT_NEAR(Dot(isectA.Shading().n, isectB.Shading().n), 1.0f, 1e-4f);
+        EXPECT_NEAR(isectA.uv.x, isectB.uv.x, 1e-3f);
+        EXPECT_NEAR(isectA.uv.y, isectB.uv.y, 1e-3f);
+
+        /// The whole mesh as a shape finds the same triangle
+        if (i % 50 == 0) {
+            float tHit;
+            SurfaceInteraction isect;
+            ASSERT_TRUE(b.Intersect(r, &tHit, &isect));
+            EXPECT_EQ(tHit, hitB.t);
+            EXPECT_NEAR(Distance(isect.p, isectB.p), 0.0f, 1e-5f);
+        }
+    }
+}
+
+TEST(Curve, Intersect) {
+    /// Straight strand along x, seen from above
+    Transform identity;
+    Point3f line[4] = {Point3f(-1, 0, 0), Point3f(-0.3f, 0, 0), Point3f(0.3f, 0, 0), Point3f(1, 0, 0)};
+    auto flat = CreateCurve(&identity, &identity, false, line, 0.2f, 0.2f, CurveType::Flat);
+    ASSERT_EQ(flat.size(), size_t(1));
+    HitRecord hit;
+    ASSERT_TRUE(flat[0]->IntersectHit(Ray(Point3f(0.0f, 0.0f, 5.0f), Vec3f(0.0f, 0.0f, -1.0f)), &hit));
+    EXPECT_NEAR(hit.t, 5.0f, 1e-3f);
+    EXPECT_NEAR(hit.uv.x, 0.5f, 1e-2f);
+    EXPECT_NEAR(hit.uv.y, 0.5f, 1e-2f);
+    ASSERT_TRUE(flat[0]->IntersectHit(Ray(Point3f(0.5f, 0.05f, 5.0f), Vec3f(0.0f, 0.0f, -1.0f)), &hit));
+    EXPECT_NEAR(std::abs(hit.uv.y - 0.5f), 0.25f, 1e-2f);
+    EXPECT_FALSE(flat[0]->IntersectTest(Ray(Point3f(0.0f, 0.15f, 5.0f), Vec3f(0.0f, 0.0f, -1.0f))));
+    EXPECT_FALSE(flat[0]->IntersectTest(Ray(Point3f(0.0f, 0.0f, 5.0f), Vec3f(0.0f, 0.0f, -1.0f), 4.0f)));
+
+    /// Ribbons only show their face, cylinders bend the normal across the width
+    Normal3f up[2] = {Normal3f(0, 1, 0), Normal3f(0, 1, 0)};
+    auto ribbon = CreateCurve(&identity, &identity, false, line, 0.2f, 0.2f, CurveType::Ribbon, up);
+    EXPECT_FALSE(ribbon[0]->IntersectTest(Ray(Point3f(0.0f, 0.0f, 5.0f), Vec3f(0.0f, 0.0f, -1.0f))));
+    EXPECT_TRUE(ribbon[0]->IntersectTest(Ray(Point3f(0.0f, 5.0f, 0.05f), Vec3f(0.0f, -1.0f, 0.0f))));
+    auto tube = CreateCurve(&identity, &identity, false, line, 0.2f, 0.2f, CurveType::Cylinder);
+    SurfaceInteraction center, side;
+    float tHit;
+    ASSERT_TRUE(tube[0]->Intersect(Ray(Point3f(0.0f, 0.0f, 5.0f), Vec3f(0.0f, 0.0f, -1.0f)), &tHit, &center));
+    ASSERT_TRUE(tube[0]->Intersect(Ray(Point3f(0.0f, 0.09f, 5.0f), Vec3f(0.0f, 0.0f, -1.0f)), &tHit, &side));
+    EXPECT_NEAR(std::abs(center.n.z), 1.0f, 1e-3f);
+    EXPECT_GT(std::abs(side.n.y), 0.5f);
+    EXPECT_NEAR(Dot(center.dpdu, Vec3f(1, 0, 0)), 1.95f, 1e-2f);
+
+    /// A hooked strand crossing the ray twice reports the nearer crossing
+    Point3f hook[4] = {Point3f(-1, 0, 1), Point3f(2, 0, 1), Point3f(2, 0, -1), Point3f(-1, 0, -1)};
+    auto hooked = CreateCurve(&identity, &identity, false, hook, 0.05f, 0.05f, CurveType::Flat);
+    ASSERT_TRUE(hooked[0]->IntersectHit(Ray(Point3f(0.0f, 0.0f, 5.0f), Vec3f(0.0f, 0.0f, -1.0f)), &hit));
+    EXPECT_NEAR(hit.t, 4.09f, 0.05f);
+
+    /// Segments bound only their own part of the curve
+    auto segments = CreateCurve(&identity, &identity, false, hook, 0.05f, 0.05f, CurveType::Flat, nullptr, 4);
+    ASSERT_EQ(segments.size(), size_t(4));
+    Bounds3f whole = hooked[0]->ObjectBounds(), covered;
+    for (const auto& segment : segments) {
+        EXPECT_LT(segment->ObjectBounds().Volume(), whole.Volume());
+        covered = Union(covered, segment->ObjectBounds());
+    }
+    EXPECT_LE(covered.Volume(), whole.Volume() + 1e-4f);
+
+    /// Oriented boxes reject rays early without changing any result
+    Transform toWorld = Rotate(30.0f, Vec3f(1, 1, 0));
+    Transform toObject = Inverse(toWorld);
+    Point3f diagonal[4] = {Point3f(0, 0, 0), Point3f(1, 1, 1), Point3f(2, 2, 2), Point3f(3, 3, 3)};
+    auto plain = CreateCurve(&toWorld, &toObject, false, diagonal, 0.1f, 0.05f, CurveType::Cylinder);
+    auto oriented = CreateCurve(&toWorld, &toObject, false, diagonal, 0.1f, 0.05f, CurveType::Cylinder,
+        nullptr, 1, true);
+    EXPECT_LT(plain[0]->WorldBounds().Volume(), toWorld(plain[0]->ObjectBounds()).Volume());
+    int nHits = 0;
+    for (int i = 0; i < 400; ++i) {
+        Point3f o(float(i % 20) * 0.2f - 0.5f, float(i / 20) * 0.2f - 0.5f, -5.0f);
+        Ray r(toWorld(o), toWorld(Vec3f(0.05f, 0.02f, 1.0f)));
+        HitRecord a, b;
+        bool found = plain[0]->IntersectHit(r, &a);
+        ASSERT_EQ(oriented[0]->IntersectHit(r, &b), found);
+        if (found) {
+            ++nHits;
+            EXPECT_EQ(a.t, b.t);
+        }
+    }
+    EXPECT_GT(nHits, 0);
+
+    /// Curves without width and ribbons without normals are rejected, and
+    /// a curve without width made directly is simply missed
+    EXPECT_TRUE(CreateCurve(&identity, &identity, false, hook, 0.0f, 0.0f, CurveType::Flat).empty());
+    EXPECT_TRUE(CreateCurve(&identity, &identity, false, hook, -0.1f, 0.2f, CurveType::Flat).empty());
+    EXPECT_TRUE(CreateCurve(&identity, &identity, false, hook, 0.05f, 0.05f, CurveType::Ribbon).empty());
+    auto common = std::make_shared<CurveCommon>(hook, 0.0f, 0.0f, CurveType::Flat, nullptr, false);
+    Curve thin(&identity, &identity, false, common, 0.0f, 1.0f);
+    EXPECT_FALSE(thin.IntersectHit(Ray(Point3f(0.0f, 0.0f, 5.0f), Vec3f(0.0f, 0.0f, -1.0f)), &hit));
+}
+
+HEIMDALL_NAMESPACE_END
@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include "heimdall/traversal.h"
+#include "heimdall/parallel.h"
+
+HEIMDALL_NAMESPACE_BEGIN
+
+static const TraversalOrder allOrders[] = {TraversalOrder::RowMajor, TraversalOrder::Morton,
+                                           TraversalOrder::Hilbert, TraversalOrder::Spiral};
+
+TEST(Traversal, VisitsEveryPointOnce) {
+    /// Squares, odd sizes, offsets, thin strips along either axis
+    Bounds2i boundsList[] = {
+        Bounds2i(Point2i(0, 0), Point2i(16, 16)),
+        Bounds2i(Point2i(-3, 5), Point2i(14, 12)),
+        Bounds2i(Point2i(2, 2), Point2i(3, 40)),
+        Bounds2i(Point2i(0, 7), Point2i(100, 9)),
+        Bounds2i(Point2i(4, 4), Point2i(5, 5))
+    };
+    for (const Bounds2i& bounds : boundsList) {
+        Vec2i extent = bounds.Diagonal();
+        for (TraversalOrder order : allOrders) {
+            std::vector<int> visits(extent.x * extent.y, 0);
+            int64_t n = 0;
+            for (Point2i p : Traversal(bounds, order)) {
+                ASSERT_TRUE(InsideExclusive(p, bounds));
+                ++visits[(p.y - bounds.pMin.y) * extent.x + (p.x - bounds.pMin.x)];
+                ++n;
+            }
+            EXPECT_EQ(n, int64_t(visits.size()));
+            EXPECT_EQ(std::count(visits.begin(), visits.end(), 1), int64_t(visits.size()));
+        }
+    }
+
+    /// Degenerate bounds are empty in every order
+    Bounds2i empty;
+    empty.pMin = Point2i(3, 3);
+    empty.pMax = Point2i(3, 8);
+    for (TraversalOrder order : allOrders) {
+        Traversal traversal(empty, order);
+        EXPECT_TRUE(traversal.begin() == traversal.end());
+    }
+}
+
+TEST(Traversal, Locality) {
+    /// Row major matches Bounds2iIterator
+    Bounds2i bounds(Point2i(1, 2), Point2i(6, 5));
+    std::vector<Point2i> rowMajor;
+    for (Point2i p : Traversal(bounds, TraversalOrder::RowMajor)) {
+        rowMajor.push_back(p);
+    }
+    EXPECT_TRUE(std::equal(rowMajor.begin(), rowMajor.end(), begin(bounds)));
+
+    /// Morton visits 2x2 quads in Z order
+    std::vector<Point2i> morton;
+    for (Point2i p : Traversal(Bounds2i(Point2i(0, 0), Point2i(4, 4)), TraversalOrder::Morton)) {
+        morton.push_back(p);
+    }
+    EXPECT_EQ(morton[0], Point2i(0, 0));
+    EXPECT_EQ(morton[1], Point2i(1, 0));
+    EXPECT_EQ(morton[2], Point2i(0, 1));
+    EXPECT_EQ(morton[3], Point2i(1, 1));
+    EXPECT_EQ(morton[4], Point2i(2, 0));
+
+    /// Hilbert steps are always to a neighbor, across squares too
+    for (const Bounds2i& b : {Bounds2i(Point2i(0, 0), Point2i(32, 32)), Bounds2i(Point2i(0, 0), Point2i(64, 8)),
+                              Bounds2i(Point2i(0, 0), Point2i(4, 20))}) {
+        Point2i prev = b.pMin;
+        for (Point2i p : Traversal(b, TraversalOrder::Hilbert)) {
+            EXPECT_LE(std::abs(p.x - prev.x) + std::abs(p.y - prev.y), 1);
+            prev = p;
+        }
+    }
+
+    /// Spiral starts at the center and never moves inwards
+    int prevRing = 0;
+    bool first = true;
+    for (Point2i p : Traversal(Bounds2i(Point2i(0, 0), Point2i(9, 5)), TraversalOrder::Spiral)) {
+        if (first) {
+            EXPECT_EQ(p, Point2i(4, 2));
+            first = false;
+        }
+        int ring = std::max(std::abs(p.x - 4), std::abs(p.y - 2));
+        EXPECT_GE(ring, prevRing);
+        prevRing = ring;
+    }
+}
+
+TEST(Traversal, ParallelTiles) {
+    /// Tiles in spiral order still cover every pixel exactly once
+    ParallelInit(4);
+    Bounds2i bounds(Point2i(0, 0), Point2i(50, 37));
+    std::vector<std::atomic<int>> covered(50 * 37);
+    for (std::atomic<int>& c : covered) {
+        c = 0;
+    }
+    ParallelFor2D(bounds, 8, [&](const Bounds2i& tile) {
+        for (Point2i p : Traversal(tile, TraversalOrder::Hilbert)) {
+            ++covered[p.y * 50 + p.x];
+        }
+    }, TraversalOrder::Spiral);
+    ParallelCleanup();
+    for (const std::atomic<int>& c : covered) {
+        EXPECT_EQ(c, 1);
+    }
+}
+
+HEIMDALL_NAMESPACE_END